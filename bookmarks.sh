@@ -19,13 +19,57 @@ readonly CYAN='\033[0;36m'
 readonly NC='\033[0m' # No Color
 
 # Valid bookmark types - focused on shell commands and common file types
-readonly VALID_TYPES=("url" "pdf" "script" "ssh" "app" "cmd" "note" "folder" "file" "edit" "custom")
+readonly VALID_TYPES=("url" "pdf" "script" "ssh" "app" "cmd" "note" "folder" "file" "edit" "workflow" "custom")
 
 # Configuration defaults
 readonly DEFAULT_BACKUP_RETENTION=5
+readonly DEFAULT_HOOK_TIMEOUT=30          # seconds before a queued hook run is killed
+readonly DEFAULT_HOOK_COALESCE_DELAY=0.5  # seconds the hook worker waits for a burst to settle
+readonly DEFAULT_CHANGE_LOG_MAX_ENTRIES=10000  # change log lines kept for `changes --since`
+readonly DEFAULT_CHANGES_POLL_INTERVAL=1       # seconds between polls for `changes --follow` without inotify
+readonly DEFAULT_JOURNAL_MAX_ENTRIES=5000      # journal entries kept for `undo` and `restore --at`
+readonly DEFAULT_LOG_MAX_BYTES=65536           # size at which `maintain` rotates a log file
+readonly DEFAULT_MAINTAIN_OBSOLETE_AFTER_DAYS=365  # unused days before `maintain` marks a bookmark obsolete
+readonly DEFAULT_MAINTAIN_ARCHIVE_AFTER_DAYS=30    # unused days before `maintain` archives an obsolete bookmark
+readonly DEFAULT_RANKING_MODE="frecency"        # "time" also weights by time-of-week usage
+readonly DEFAULT_FRECENCY_MAX_RANK=9000         # total access count above which all counts are aged (as in z.sh)
+readonly DEFAULT_HISTORY_RETENTION_DAYS=365     # days of access history kept for `history`
+readonly DEFAULT_OUTPUT_CACHE_MAX_BYTES=10485760  # size of the cached outputs of cache_ttl bookmarks
+readonly DEFAULT_RUN_JOBS=4                      # bookmarks `run` executes at the same time
+readonly DEFAULT_OPEN_BATCH_SIZE=10              # url, folder and file bookmarks passed to one opener invocation
+readonly DEFAULT_HOST_JOBS=8                     # hosts a host_group bookmark runs on at the same time
+readonly DEFAULT_HOST_TIMEOUT=60                 # seconds before a command on one host is killed (0 waits forever)
+readonly DEFAULT_SSH_CONTROL_PERSIST=600         # seconds an idle ssh master connection stays open (0 disables pooling)
+readonly DEFAULT_SSH_PREWARM=0                   # most frecent ssh bookmarks connected when the picker opens
+readonly DEFAULT_BACKGROUND_MAINTENANCE_INTERVAL=3600  # seconds between background rescore/compaction runs (0 disables)
 
 # Global flags
 NON_INTERACTIVE=false
+SYNC_HOOKS=false
+
+# Last mutation made by this invocation (operation, affected IDs, records)
+# Filled in by record_mutation and passed to hooks as a JSON event
+MUTATION_OP=""
+MUTATION_IDS="[]"
+MUTATION_BEFORE="[]"
+MUTATION_AFTER="[]"
+
+# Generation written by this invocation (empty until commit_bookmarks_json runs)
+STORE_GENERATION=""
+
+# Set while this invocation holds the store lock (see with_store_lock)
+STORE_LOCK_HELD=false
+
+# Extra fields merged into the next journal entry (e.g. which generations an undo reverts)
+JOURNAL_EXTRA="{}"
+
+# File with the {"before","after"} records of the next journal entry, when the
+# caller already has them; saves reading the old and new store again
+JOURNAL_RECORDS_FILE=""
+
+# Set when the input of the next commit is already in the record-per-line
+# layout (see STORE_LINES_JQ_DEFS); only its header is stamped then
+STORE_LINES_INPUT=false
 
 # Check if BOOKMARKS_DIR is set
 if [ -z "$BOOKMARKS_DIR" ]; then
@@ -44,8 +88,134 @@ fi
 # Path to the bookmarks file
 BOOKMARKS_FILE="$BOOKMARKS_DIR/bookmarks.json"
 
+# Change log: one "generation<TAB>op<TAB>id<TAB>epoch" line per changed bookmark
+CHANGE_LOG_FILE="$BOOKMARKS_DIR/changes.log"
+
+# Mutation journal: one JSON line per generation with the records before and after
+JOURNAL_FILE="$BOOKMARKS_DIR/journal.jsonl"
+
+# Errors from background frecency recalculation
+FRECENCY_ERROR_LOG="$BOOKMARKS_DIR/frecency_errors.log"
+
+# Touched whenever a background maintenance run is scheduled
+BACKGROUND_MAINTENANCE_STAMP="$BOOKMARKS_DIR/.background_maintenance"
+
+#=============================================================================
+# CAPABILITY CACHE
+#=============================================================================
+# Probing for openers, viewers and editors costs several PATH lookups per run,
+# and none of the answers change unless $PATH does. The results are cached in
+# $BOOKMARKS_DIR/.capabilities, keyed on the $PATH they were probed with, and
+# read at start-up.
+
+CAPABILITIES_FILE="$BOOKMARKS_DIR/.capabilities"
+
+# Directory for pluggable type handlers (<type>.sh or native <type> executables)
+TYPES_DIR="$BOOKMARKS_DIR/types"
+
+# Tools recorded in the cache, grouped by role
+readonly CAPABILITY_OPENERS=("xdg-open" "open" "start")
+readonly CAPABILITY_VIEWERS=("zathura" "less")
+readonly CAPABILITY_EDITORS=("nvim" "vim" "vi" "nano" "emacs" "emacsclient")
+readonly CAPABILITY_HELPERS=("jq" "fzf" "flock" "timeout" "inotifywait" "zstd" "git" "sha256sum")
+
+declare -A CAPABILITIES=()
+
+# Hash a string with shell arithmetic (djb2, 32-bit)
+# Args: $1 - string to hash
+# Returns: hash as a decimal number
+hash_string() {
+    local str="$1"
+    local hash=5381
+    local i char_code
+    for ((i = 0; i < ${#str}; i++)); do
+        printf -v char_code '%d' "'${str:i:1}"
+        hash=$(( ((hash << 5) + hash + char_code) & 0xFFFFFFFF ))
+    done
+    echo "$hash"
+}
+
+# Probe the system and rewrite the capability cache
+# Each tool is stored as "cap_<name>=<path>" (empty path if missing)
+probe_capabilities() {
+    CAPABILITIES=([path]="$PATH" [opener]="")
+
+    local tool tool_path
+    for tool in "${CAPABILITY_OPENERS[@]}" "${CAPABILITY_VIEWERS[@]}" "${CAPABILITY_EDITORS[@]}" "${CAPABILITY_HELPERS[@]}"; do
+        tool_path=$(command -v "$tool" 2>/dev/null || true)
+        CAPABILITIES["cap_$tool"]="$tool_path"
+    done
+
+    # Preferred system opener (first available in priority order)
+    for tool in "${CAPABILITY_OPENERS[@]}"; do
+        if [[ -n "${CAPABILITIES["cap_$tool"]}" ]]; then
+            CAPABILITIES[opener]="$tool"
+            break
+        fi
+    done
+
+    discover_type_handlers
+
+    # Write atomically so concurrent invocations never read a partial cache
+    local tmp_file="$CAPABILITIES_FILE.$$"
+    {
+        echo "path=$PATH"
+        local key
+        for key in "${!CAPABILITIES[@]}"; do
+            [[ "$key" == "path" ]] && continue
+            echo "$key=${CAPABILITIES[$key]}"
+        done
+    } > "$tmp_file" 2>/dev/null && mv -f "$tmp_file" "$CAPABILITIES_FILE" 2>/dev/null || rm -f "$tmp_file"
+}
+
+# Scan the type handler directory and record handlers as "type_<name>=<kind>"
+# Kind is "sh" for sourced <type>.sh scripts or "exe" for native executables
+discover_type_handlers() {
+    [[ -d "$TYPES_DIR" ]] || return 0
+
+    local handler name
+    for handler in "$TYPES_DIR"/*; do
+        [[ -f "$handler" ]] || continue
+        name=$(basename "$handler")
+        if [[ "$name" == *.sh ]]; then
+            CAPABILITIES["type_${name%.sh}"]="sh"
+        elif [[ -x "$handler" ]] && [[ "$name" != *.* ]]; then
+            # A sourced handler wins over a native one of the same name
+            [[ -n "${CAPABILITIES["type_$name"]:-}" ]] || CAPABILITIES["type_$name"]="exe"
+        fi
+    done
+}
+
+# Load the capability cache, re-probing if it is missing or $PATH changed
+# Both checks are string comparisons and builtin tests, so a warm start forks
+# nothing. Adding or removing a type handler updates the directory mtime,
+# which also invalidates the cache
+load_capabilities() {
+    CAPABILITIES=()
+
+    if [[ -f "$CAPABILITIES_FILE" ]]; then
+        local key value
+        while IFS='=' read -r key value; do
+            [[ -n "$key" ]] && CAPABILITIES["$key"]="$value"
+        done < "$CAPABILITIES_FILE"
+    fi
+
+    if [[ "${CAPABILITIES[path]-}" != "$PATH" ]] || [[ "$TYPES_DIR" -nt "$CAPABILITIES_FILE" ]]; then
+        probe_capabilities
+    fi
+}
+
+# Check whether a tool was found by the capability probe
+# Args: $1 - tool name
+# Returns: 0 if available, 1 if not
+has_capability() {
+    [[ -n "${CAPABILITIES["cap_$1"]:-}" ]]
+}
+
+load_capabilities
+
 # Check if jq is installed (needed for JSON parsing)
-if ! command -v jq &> /dev/null; then
+if ! has_capability jq; then
     echo -e "${RED}Error: jq is not installed. Please install it to use this script.${NC}"
     echo "jq is required for JSON processing."
     echo "Installation: sudo apt install jq (Debian/Ubuntu) or brew install jq (macOS)"
@@ -53,7 +223,7 @@ if ! command -v jq &> /dev/null; then
 fi
 
 # Check if fzf is installed
-if ! command -v fzf &> /dev/null; then
+if ! has_capability fzf; then
     echo -e "${RED}Error: fzf is not installed. Please install it to use this script.${NC}"
     echo "Visit https://github.com/junegunn/fzf for installation instructions."
     exit 1
@@ -67,6 +237,238 @@ fi
 
 # Note: migrate_bookmarks_schema is called within format_bookmarks_for_display to ensure schema is migrated before use
 
+#=============================================================================
+# LAYERED STORES
+#=============================================================================
+
+# BOOKMARKS_PATH lists shared, read-only stores (directories holding a
+# bookmarks.json, or bookmarks files) separated by ':'; earlier entries take
+# precedence. The shared layers are merged once into cache/shared.json and
+# combined with the personal store into cache/view.json, which every read path
+# uses. Personal edits and access statistics for shared bookmarks are kept as
+# overlay records in the personal store. Without BOOKMARKS_PATH the view is
+# simply the personal store.
+LAYER_CACHE_DIR="$BOOKMARKS_DIR/cache"
+SHARED_LAYER_CACHE="$LAYER_CACHE_DIR/shared.json"
+BOOKMARKS_VIEW_FILE="$BOOKMARKS_FILE"
+BOOKMARK_LAYERS=()
+
+# Rebuild the merged cache of all shared layers
+# Records carry a "layer" field naming the store they came from
+build_shared_layer_cache() {
+    mkdir -p "$LAYER_CACHE_DIR"
+    local tmp_file="$SHARED_LAYER_CACHE.tmp.$$"
+    
+    if ! jq -n '
+        reduce (inputs | input_filename as $layer | .bookmarks[]? | . + {layer: $layer}) as $rec ({};
+            if has($rec.id) then . else .[$rec.id] = ($rec + {
+                status: ($rec.status // "active"),
+                access_count: ($rec.access_count // 0),
+                last_accessed: ($rec.last_accessed // null),
+                frecency_score: ($rec.frecency_score // 0)
+            }) end)
+        | {bookmarks: [.[]]}
+    ' "${BOOKMARK_LAYERS[@]}" > "$tmp_file"; then
+        rm -f "$tmp_file"
+        echo -e "${RED}Error: Could not read shared bookmark layers in BOOKMARKS_PATH${NC}" >&2
+        return 1
+    fi
+    
+    mv "$tmp_file" "$SHARED_LAYER_CACHE"
+    printf '%s\n' "${BOOKMARK_LAYERS[@]}" > "$SHARED_LAYER_CACHE.layers"
+}
+
+# Rebuild the merged view of the personal store over the shared layers
+# Overlay records that only carry access statistics pick up the current
+# shared content; edited overlays replace the shared record entirely
+build_bookmarks_view() {
+    local view_file="$LAYER_CACHE_DIR/view.json"
+    local tmp_file="$view_file.tmp.$$"
+    
+    jq -n --slurpfile personal "$BOOKMARKS_FILE" --slurpfile shared "$SHARED_LAYER_CACHE" '
+        (reduce $shared[0].bookmarks[] as $rec ({}; .[$rec.id] = $rec)) as $by_id
+        | (reduce $personal[0].bookmarks[] as $rec ({}; .[$rec.id] = true)) as $personal_ids
+        | {bookmarks: (
+            [$personal[0].bookmarks[]
+                | if .overlay == "stats" and $by_id[.id] != null
+                  then $by_id[.id] + {access_count, last_accessed, frecency_score, usage, runs, overlay, layer: $by_id[.id].layer}
+                  else . end]
+            + [$shared[0].bookmarks[] | select($personal_ids[.id] | not)]
+          )}
+    ' > "$tmp_file" && mv "$tmp_file" "$view_file"
+}
+
+# Resolve BOOKMARKS_PATH and refresh the caches that are out of date
+# Per invocation this costs a few file timestamp checks unless a layer or the
+# personal store changed
+load_bookmark_layers() {
+    [[ -n "${BOOKMARKS_PATH:-}" ]] || return 0
+    
+    local entry layer_file
+    local -a entries=()
+    IFS=':' read -ra entries <<< "$BOOKMARKS_PATH"
+    for entry in "${entries[@]}"; do
+        [[ -n "$entry" ]] || continue
+        layer_file="$entry"
+        [[ -d "$entry" ]] && layer_file="$entry/bookmarks.json"
+        if [[ ! -f "$layer_file" ]]; then
+            echo -e "${YELLOW}Warning: Skipping missing bookmark layer: $entry${NC}" >&2
+            continue
+        fi
+        [[ "$layer_file" -ef "$BOOKMARKS_FILE" ]] && continue
+        BOOKMARK_LAYERS+=("$layer_file")
+    done
+    
+    [[ ${#BOOKMARK_LAYERS[@]} -gt 0 ]] || return 0
+    
+    local stale=false
+    if [[ ! -f "$SHARED_LAYER_CACHE" || ! -f "$SHARED_LAYER_CACHE.layers" ]] \
+        || [[ "$(< "$SHARED_LAYER_CACHE.layers")" != "$(printf '%s\n' "${BOOKMARK_LAYERS[@]}")" ]]; then
+        stale=true
+    else
+        for layer_file in "${BOOKMARK_LAYERS[@]}"; do
+            if [[ "$layer_file" -nt "$SHARED_LAYER_CACHE" ]]; then
+                stale=true
+                break
+            fi
+        done
+    fi
+    [[ "$stale" == "false" ]] || build_shared_layer_cache || return 1
+    
+    BOOKMARKS_VIEW_FILE="$LAYER_CACHE_DIR/view.json"
+    if [[ ! -f "$BOOKMARKS_VIEW_FILE" || "$BOOKMARKS_FILE" -nt "$BOOKMARKS_VIEW_FILE" \
+        || "$SHARED_LAYER_CACHE" -nt "$BOOKMARKS_VIEW_FILE" ]]; then
+        build_bookmarks_view
+    fi
+}
+
+# Get the shared record for a bookmark the user has not made a personal copy of
+# Args: $1 - bookmark ID or description
+# Returns: JSON record, or nothing if the bookmark is personal or unknown
+get_shared_only_bookmark() {
+    local id_or_desc="$1"
+    [[ ${#BOOKMARK_LAYERS[@]} -gt 0 ]] || return 0
+    
+    jq -c --arg key "$id_or_desc" '
+        first(.bookmarks[] | select((.id == $key or .description == $key) and has("layer"))) // empty
+    ' "$BOOKMARKS_VIEW_FILE"
+}
+
+# Copy a shared bookmark into the personal store before changing it
+# Args: $1 - bookmark ID or description, $2 - overlay kind: "stats" for access
+#       statistics only, "edit" for a personal copy of the whole record
+ensure_overlay_record() {
+    [[ ${#BOOKMARK_LAYERS[@]} -gt 0 ]] || return 0
+    [[ "$STORE_LOCK_HELD" == "true" ]] || { with_store_lock ensure_overlay_record "$@"; return; }
+    
+    local id_or_desc="$1"
+    local kind="$2"
+    
+    local shared_record
+    shared_record=$(jq -c --arg key "$id_or_desc" '
+        first(.bookmarks[] | select((.id == $key or .description == $key) and has("layer"))) // empty
+    ' "$BOOKMARKS_VIEW_FILE")
+    [[ -n "$shared_record" ]] || return 0
+    
+    local record_id updated_json
+    record_id=$(jq -r '.id' <<< "$shared_record")
+    updated_json=$(jq --argjson rec "$shared_record" --arg kind "$kind" '
+        if any(.bookmarks[]; .id == $rec.id) then
+            .bookmarks |= map(if .id == $rec.id and $kind == "edit" and .overlay == "stats"
+                then ($rec | del(.layer)) + {overlay: "edit", base_layer: $rec.layer, access_count, last_accessed, frecency_score, usage, runs}
+                else . end)
+        else
+            .bookmarks += [($rec | del(.layer, .overlay)) + {overlay: $kind, base_layer: $rec.layer}]
+        end
+    ' "$BOOKMARKS_FILE") || return 1
+    commit_bookmarks_json "$updated_json" "overlay" "$(jq -nc --arg id "$record_id" '[$id]')"
+}
+
+load_bookmark_layers
+
+#=============================================================================
+# ARCHIVE PARTITION
+#=============================================================================
+
+# Obsolete bookmarks are moved out of bookmarks.json into archive.json, so the
+# store that every listing and search parses only holds live records. The
+# archive is read by `details`, `list --all`, lookups that miss the store and
+# sync. Overlays of shared bookmarks stay in the store, because they are what
+# hides the shared record.
+ARCHIVE_FILE="$BOOKMARKS_DIR/archive.json"
+
+# Print a store with its archived bookmarks appended
+# Records present in both (e.g. after an undo) are taken from the store
+# Args: $1 - store file, $2 - archive file
+# Returns: {"bookmarks": [...]} JSON
+merge_archive_json() {
+    if [[ ! -s "$2" ]]; then
+        cat "$1"
+        return
+    fi
+    jq -n 'input as $store | input as $archive
+        | (reduce $store.bookmarks[] as $r ({}; .[$r.id] = true)) as $present
+        | $store | .bookmarks += [$archive.bookmarks[] | select($present[.id] | not)]
+    ' "$1" "$2"
+}
+
+# Move obsolete records from a store into the archive
+# Archived copies of records that are back in the store are dropped as stale
+# Args: $1 - only archive records last used at or before this date (optional)
+# Input: store JSON on stdin
+# Output: the store JSON without the archived records
+archive_obsolete_records() {
+    local used_before="${1:-}"
+    local store_file
+    store_file=$(mktemp)
+    cat > "$store_file"
+    [[ -s "$ARCHIVE_FILE" ]] || echo '{"bookmarks":[]}' > "$ARCHIVE_FILE"
+    
+    # Line 1: new archive, line 2: store
+    local result_file="$ARCHIVE_FILE.tmp.$$"
+    if ! jq -nc --slurpfile store "$store_file" --slurpfile archive "$ARCHIVE_FILE" --arg before "$used_before" '
+        def archived: .status == "obsolete" and .overlay == null
+            and ($before == "" or ((.last_accessed // .modified // .created // "") | . != "" and . <= $before));
+        $store[0] as $s
+        | [$s.bookmarks[] | select(archived | not)] as $kept
+        | [$s.bookmarks[] | select(archived)] as $moved
+        | (reduce ($kept + $moved)[] as $r ({}; .[$r.id] = true)) as $present
+        | {bookmarks: ([$archive[0].bookmarks[] | select($present[.id] | not)] + $moved)},
+          ($s | .bookmarks = $kept)
+    ' > "$result_file"; then
+        rm -f "$store_file" "$result_file"
+        echo -e "${RED}Error: Failed to update $ARCHIVE_FILE${NC}" >&2
+        return 1
+    fi
+    
+    head -n 1 "$result_file" | jq -r "$STORE_LINES_JQ_DEFS"'store_lines' > "$ARCHIVE_FILE.new.$$" \
+        && mv "$ARCHIVE_FILE.new.$$" "$ARCHIVE_FILE"
+    sed -n 2p "$result_file"
+    rm -f "$store_file" "$result_file"
+}
+
+# Move an archived bookmark back into the store before it is changed
+# Args: $1 - bookmark ID or description
+ensure_hot_record() {
+    [[ -s "$ARCHIVE_FILE" ]] || return 0
+    [[ "$STORE_LOCK_HELD" == "true" ]] || { with_store_lock ensure_hot_record "$@"; return; }
+    
+    local id_or_desc="$1"
+    [[ -z "$(lookup_bookmark "$BOOKMARKS_VIEW_FILE" "$id_or_desc")" ]] || return 0
+    
+    local records
+    records=$(lookup_bookmark "$ARCHIVE_FILE" "$id_or_desc" | jq -sc '.')
+    [[ "$records" != "[]" ]] || return 0
+    
+    local ids_json updated_json
+    ids_json=$(jq -c 'map(.id)' <<< "$records")
+    updated_json=$(jq --argjson recs "$records" '.bookmarks += $recs' "$BOOKMARKS_FILE") || return 1
+    commit_bookmarks_json "$updated_json" "unarchive" "$ids_json" || return 1
+    
+    # The store has the record now, so a crash here leaves only a stale copy
+    jq -r --argjson ids "$ids_json" "$STORE_LINES_JQ_DEFS"'.bookmarks |= map(select(.id | IN($ids[]) | not)) | store_lines' \
+        "$ARCHIVE_FILE" > "$ARCHIVE_FILE.tmp.$$" && mv "$ARCHIVE_FILE.tmp.$$" "$ARCHIVE_FILE"
+}
 
 #=============================================================================
 # UTILITY FUNCTIONS
@@ -74,17 +476,9 @@ fi
 
 # Pure function to detect system opener command
 # Returns: opener command name (xdg-open, open, start) or empty string
-# This is a pure function with no side effects, following UNIX philosophy
+# Answered from the capability cache, so no PATH lookups happen per execution
 detect_system_opener() {
-    if command -v xdg-open &> /dev/null; then
-        echo "xdg-open"
-    elif command -v open &> /dev/null; then
-        echo "open"
-    elif command -v start &> /dev/null; then
-        echo "start"
-    else
-        echo ""
-    fi
+    echo "${CAPABILITIES[opener]:-}"
 }
 
 # Pure function to detect default editor
@@ -94,10 +488,66 @@ detect_editor() {
 }
 
 # Pure function to check if command/tool is available
+# Uses the capability cache for probed tools, falls back to a PATH lookup
 # Args: $1 - command name to check
 # Returns: 0 if available, 1 if not
 is_command_available() {
-    command -v "$1" &> /dev/null
+    if [[ -n "${CAPABILITIES["cap_$1"]+set}" ]]; then
+        has_capability "$1"
+    else
+        command -v "$1" &> /dev/null
+    fi
+}
+
+declare -A LOCK_FDS=()
+
+# Take an exclusive lock held until release_lock or shell exit
+# Uses flock when available, otherwise falls back to an mkdir lock directory
+# Args: $1 - lock file path, $2 - seconds to wait for the lock (default 0, non-blocking)
+# Returns: 0 if acquired, 1 if another process holds the lock
+try_lock() {
+    local lock_path="$1"
+    local wait_seconds="${2:-0}"
+    if has_capability flock; then
+        local fd
+        exec {fd}>>"$lock_path" || return 1
+        if ! flock -w "$wait_seconds" "$fd"; then
+            exec {fd}>&-
+            return 1
+        fi
+        LOCK_FDS["$lock_path"]="$fd"
+    else
+        local attempts=$((wait_seconds * 20))
+        until mkdir "$lock_path.d" 2>/dev/null; do
+            [[ "$attempts" -gt 0 ]] || return 1
+            attempts=$((attempts - 1))
+            sleep 0.05
+        done
+    fi
+}
+
+# Release a lock taken with try_lock
+# Args: $1 - lock file path
+release_lock() {
+    local lock_path="$1"
+    local fd="${LOCK_FDS["$lock_path"]:-}"
+    if [[ -n "$fd" ]]; then
+        exec {fd}>&-
+        unset 'LOCK_FDS["$lock_path"]'
+    else
+        rmdir "$lock_path.d" 2>/dev/null || true
+    fi
+}
+
+# Rotate a log file once it grows past a size, keeping one previous file
+# Args: $1 - log file, $2 - maximum size in bytes
+# Returns: 0 if the log was rotated, 1 if it was left alone
+rotate_log() {
+    [[ -f "$1" ]] || return 1
+    local size
+    size=$(wc -c < "$1")
+    [[ "$size" -gt "$2" ]] || return 1
+    mv -f "$1" "$1.1"
 }
 
 # Generate a unique ID for bookmarks
@@ -106,7 +556,7 @@ generate_id() {
     echo "$(date +%s)_$(tr -dc 'a-zA-Z0-9' < /dev/urandom | head -c 6)"
 }
 
-# Validate bookmark type against allowed types
+# Validate bookmark type against built-in and registered handler types
 # Args: $1 - type to validate
 # Returns: 0 if valid, 1 if invalid
 is_valid_type() {
@@ -116,7 +566,69 @@ is_valid_type() {
             return 0
         fi
     done
-    return 1
+    has_type_handler "$type"
+}
+
+# List built-in types followed by types provided by registered handlers
+# Returns: space-separated type names
+list_valid_types() {
+    local types=("${VALID_TYPES[@]}")
+    local key
+    for key in "${!CAPABILITIES[@]}"; do
+        if [[ "$key" == type_* ]] && ! [[ " ${VALID_TYPES[*]} " == *" ${key#type_} "* ]]; then
+            types+=("${key#type_}")
+        fi
+    done
+    echo "${types[*]}"
+}
+
+#=============================================================================
+# TYPE HANDLER REGISTRY
+#=============================================================================
+# Handlers live in $BOOKMARKS_DIR/types/ and are discovered once into the
+# capability cache. Only the handler for the selected type is loaded.
+#
+# <type>.sh   - sourced in a subshell; may define type_exec, type_preview and
+#               type_validate, each called with: command description
+# <type>      - native executable, called as: <type> exec|preview|validate
+#               command description
+
+# Check whether a handler is registered for a type (cache lookup only)
+# Args: $1 - type name
+# Returns: 0 if a handler exists, 1 if not
+has_type_handler() {
+    [[ -n "${CAPABILITIES["type_$1"]:-}" ]]
+}
+
+# Run one entry point of a type handler
+# Args: $1 - type, $2 - entry point (exec, preview, validate), $3 - command, $4 - description
+# Returns: handler exit status, or 127 if the handler lacks the entry point
+run_type_handler() {
+    local type="$1"
+    local entry="$2"
+    local command="$3"
+    local description="$4"
+
+    case "${CAPABILITIES["type_$type"]:-}" in
+        sh)
+            local handler="$TYPES_DIR/$type.sh"
+            [[ -f "$handler" ]] || return 127
+            (
+                # shellcheck source=/dev/null
+                source "$handler"
+                declare -F "type_$entry" > /dev/null || exit 127
+                "type_$entry" "$command" "$description"
+            )
+            ;;
+        exe)
+            local handler="$TYPES_DIR/$type"
+            [[ -x "$handler" ]] || return 127
+            "$handler" "$entry" "$command" "$description"
+            ;;
+        *)
+            return 127
+            ;;
+    esac
 }
 
 # Get bookmark data by ID or description (optimized single jq call)
@@ -124,6 +636,22 @@ is_valid_type() {
 # Returns: JSON object of the bookmark or empty if not found
 get_bookmark_by_id_or_desc() {
     local id_or_desc="$1"
+    local bookmark
+    bookmark=$(lookup_bookmark "$BOOKMARKS_VIEW_FILE" "$id_or_desc")
+    
+    # Obsolete bookmarks live in the archive; only look there on a miss
+    if [[ -z "$bookmark" && -s "$ARCHIVE_FILE" ]]; then
+        bookmark=$(lookup_bookmark "$ARCHIVE_FILE" "$id_or_desc")
+    fi
+    [[ -z "$bookmark" ]] || printf '%s\n' "$bookmark"
+}
+
+# Find bookmarks by ID or description in one store file
+# Args: $1 - store file, $2 - ID or description to search for
+# Returns: JSON objects of matching bookmarks
+lookup_bookmark() {
+    local file="$1"
+    local id_or_desc="$2"
     
     # ID format: timestamp_randomstring (e.g., 1633042516_a3b2c1)
     # - Timestamp: Unix timestamp (10+ digits, currently 10 but will be 11 around year 2286)
@@ -131,10 +659,10 @@ get_bookmark_by_id_or_desc() {
     # - Random string: 6 alphanumeric characters
     if [[ "$id_or_desc" =~ ^[0-9]{10,}_[a-zA-Z0-9]{6}$ ]]; then
         # Looks like an ID
-        jq -r --arg id "$id_or_desc" '.bookmarks[] | select(.id == $id)' "$BOOKMARKS_FILE"
+        jq -r --arg id "$id_or_desc" '.bookmarks[] | select(.id == $id)' "$file"
     else
         # Treat as description
-        jq -r --arg desc "$id_or_desc" '.bookmarks[] | select(.description == $desc)' "$BOOKMARKS_FILE"
+        jq -r --arg desc "$id_or_desc" '.bookmarks[] | select(.description == $desc)' "$file"
     fi
 }
 
@@ -148,7 +676,7 @@ get_bookmark_by_id_or_desc() {
 # Input: bookmarks.json file path
 # Output: JSON array of bookmark objects (one per line)
 filter_all_bookmarks() {
-    jq -c '.bookmarks[]' "$BOOKMARKS_FILE"
+    jq -c '.bookmarks[]' "$BOOKMARKS_VIEW_FILE"
 }
 
 # Filter: Select active bookmarks only
@@ -201,11 +729,11 @@ format_bookmark_line() {
     jq -r '"[\(.type)] \(.description)"'
 }
 
-# Transform: Sort bookmarks by frecency score (descending)
+# Transform: Sort bookmarks by rank score (descending)
 # Input: JSON bookmark objects from stdin (as array)
 # Output: Sorted JSON bookmark objects
 sort_by_frecency() {
-    jq -s 'sort_by(-.frecency_score // 0) | .[]'
+    jq -s "${RANKING_JQ_ARGS[@]}" "$RANKING_JQ_DEFS"'sort_by(-rank_score) | .[]'
 }
 
 # Transform: Convert bookmarks to TSV format
@@ -247,19 +775,21 @@ migrate_bookmarks_schema() {
     # Check if migration is needed (check if any bookmark lacks the new fields)
     local needs_migration
     needs_migration=$(jq '.bookmarks | map(select(has("access_count") | not)) | length > 0' "$BOOKMARKS_FILE")
+    [[ "$needs_migration" == "true" ]] || return 0
     
-    if [[ "$needs_migration" == "true" ]]; then
-        local updated_json
-        updated_json=$(jq '.bookmarks |= map(
-            . + {
-                access_count: (.access_count // 0),
-                last_accessed: (.last_accessed // null),
-                frecency_score: (.frecency_score // 0)
-            }
-        )' "$BOOKMARKS_FILE")
-        
-        echo "$updated_json" > "$BOOKMARKS_FILE"
-    fi
+    # Check again under the lock; another invocation may have migrated already
+    [[ "$STORE_LOCK_HELD" == "true" ]] || { with_store_lock migrate_bookmarks_schema; return; }
+    
+    local updated_json
+    updated_json=$(jq '.bookmarks |= map(
+        . + {
+            access_count: (.access_count // 0),
+            last_accessed: (.last_accessed // null),
+            frecency_score: (.frecency_score // 0)
+        }
+    )' "$BOOKMARKS_FILE") || return 1
+    
+    commit_bookmarks_json "$updated_json" "migrate"
 }
 
 # Get user confirmation (respects NON_INTERACTIVE flag)
@@ -317,184 +847,1615 @@ calculate_frecency() {
     echo "$frecency"
 }
 
-# Calculate frecency scores for all bookmarks using pipeline approach
-# This is a pure function that reads from stdin and writes to stdout
-# Input: JSON array of bookmarks
-# Output: TSV with format: index access_count last_accessed
-# This allows for efficient batch processing through awk
-extract_frecency_data() {
-    jq -r '.bookmarks | to_entries[] | 
-        [.key, .value.access_count // 0, .value.last_accessed // "null"] | 
-        @tsv'
-}
-
-# Calculate frecency scores in a batch using awk (pure function)
-# Input: TSV with format: index access_count last_accessed (from stdin)
-# Output: TSV with format: index frecency_score
-batch_calculate_frecency() {
-    local current_time
-    current_time=$(date +%s)
-    
-    awk -F'\t' -v current_time="$current_time" '
-    function date_to_epoch(date_str) {
-        # Parse YYYY-MM-DD HH:MM:SS format
-        if (match(date_str, /^([0-9]{4})-([0-9]{2})-([0-9]{2}) ([0-9]{2}):([0-9]{2}):([0-9]{2})/, parts)) {
-            # Convert to epoch using date command (portable approach)
-            cmd = "date -d \"" date_str "\" +%s 2>/dev/null || echo 0"
-            cmd | getline epoch
-            close(cmd)
-            return epoch + 0
-        }
-        return 0
-    }
-    
-    {
-        index = $1
-        access_count = $2 + 0
-        last_accessed = $3
-        
-        if (last_accessed == "null" || last_accessed == "" || access_count == 0) {
-            print index "\t0"
-        } else {
-            # Try to parse as epoch first, then as date string
-            if (last_accessed ~ /^[0-9]+$/) {
-                epoch = last_accessed + 0
-            } else {
-                epoch = date_to_epoch(last_accessed)
-            }
-            
-            age = current_time - epoch
-            
-            # Calculate frecency: 10000 * rank * (3.75 / ((0.0001 * age + 1) + 0.25))
-            frecency = 10000 * access_count * (3.75 / ((0.0001 * age + 1) + 0.25))
-            print index "\t" int(frecency + 0.5)
-        }
-    }'
-}
-
-# Update bookmark access statistics when it's executed
-# Args: $1 - bookmark ID or description
-update_bookmark_access() {
-    local id_or_desc="$1"
-    
-    # Find the bookmark
-    local bookmark
-    bookmark=$(get_bookmark_by_id_or_desc "$id_or_desc")
-    
-    if [[ -z "$bookmark" ]]; then
+# Update the access statistics of several bookmarks in one commit, together
+# with the outcome of their runs. Archived bookmarks come back into the store
+# with their access, and shared ones get their stats overlay in the same commit
+# Args: $1 - JSON array of bookmark IDs,
+#       $2 - JSON object of runs by ID, {"<id>": {"ms": n, "status": n}} (optional);
+#       it may also hold runs of bookmarks whose access was already recorded
+update_bookmarks_access() {
+    [[ "$STORE_LOCK_HELD" == "true" ]] || { with_store_lock update_bookmarks_access "$@"; return; }
+    
+    local ids_json="$1"
+    local runs_json="${2:-}"
+    [[ -n "$runs_json" ]] || runs_json='{}'
+    
+    local -a ids=()
+    readarray -t ids < <(jq -r '.[]' <<< "$ids_json")
+    
+    # Get current timestamp; an access is worth calculate_frecency of one
+    # access at age 0, so the score is that times the new count
+    local now per_access
+    now=$(date +"%Y-%m-%d %H:%M:%S")
+    per_access=$(calculate_frecency 1 "$now")
+    
+    local archive_file=/dev/null view_file=/dev/null
+    [[ ! -s "$ARCHIVE_FILE" ]] || archive_file="$ARCHIVE_FILE"
+    [[ ${#BOOKMARK_LAYERS[@]} -eq 0 ]] || view_file="$BOOKMARKS_VIEW_FILE"
+    
+    # Line 1: the updated store, line 2: the IDs taken from the archive, then
+    # one access history entry per bookmark
+    # Counts are fractional once aged by recalculate_all_frecency, so jq adds
+    local result_file
+    result_file=$(mktemp)
+    if ! jq -c --argjson ids "$ids_json" --argjson runs "$runs_json" \
+        --arg accessed "$now" --argjson per_access "$per_access" \
+        --argjson how "$CURRENT_HOUR_OF_WEEK" --argjson day "$CURRENT_LOCAL_DAY" \
+        --argjson t "$EPOCHSECONDS" --arg cwd "$CONTEXT_PWD" \
+        --slurpfile archive "$archive_file" --slurpfile view "$view_file" \
+        "$USAGE_JQ_DEFS$TELEMETRY_JQ_DEFS"'
+        (reduce $ids[] as $i ({}; .[$i] = true)) as $accessed_ids
+        | (reduce .bookmarks[] as $r ({}; .[$r.id] = true)) as $present
+        | [($archive[0].bookmarks // [])[] | select($accessed_ids[.id] and ($present[.id] | not))] as $unarchived
+        # Access statistics for shared bookmarks live in the personal overlay
+        | [($view[0].bookmarks // [])[] | select(has("layer") and $accessed_ids[.id] and ($present[.id] | not))
+            | del(.layer, .overlay) + {overlay: "stats", base_layer: .layer}] as $overlays
+        | .bookmarks += $unarchived + $overlays
+        | .bookmarks |= map(if $accessed_ids[.id] then
+              .access_count = (.access_count // 0) + 1
+              | .last_accessed = $accessed
+              | .frecency_score = (.access_count * $per_access | round)
+              | record_usage($how; $day)
+            else . end
+            | if $runs[.id] then record_run($runs[.id].ms; $runs[.id].status; $accessed) else . end)
+        | ., ($unarchived | map(.id)), (.bookmarks[] | select($accessed_ids[.id])
+              | {t: $t, id, description, type, tags: (.tags // ""), command, cwd: $cwd})
+    ' "$BOOKMARKS_FILE" > "$result_file"; then
+        rm -f "$result_file"
         return 1
     fi
     
-    # Extract current values
-    local bookmark_data
-    bookmark_data=$(echo "$bookmark" | jq -r '[.id, .access_count // 0] | @tsv')
-    IFS=$'\t' read -r id current_count <<< "$bookmark_data"
-    
-    # Increment access count
-    local new_count=$((current_count + 1))
-    
-    # Get current timestamp
-    local now
-    now=$(date +"%Y-%m-%d %H:%M:%S")
-    
-    # Calculate new frecency score
-    local frecency
-    frecency=$(calculate_frecency "$new_count" "$now")
+    head -n 1 "$result_file" | commit_bookmarks_stream "access" "$ids_json" || { rm -f "$result_file"; return 1; }
     
-    # Update the bookmark
-    local updated_json
-    if [[ "$id_or_desc" =~ ^[0-9]{10,}_[a-zA-Z0-9]{6}$ ]]; then
-        # Update by ID
-        updated_json=$(jq --arg id "$id" \
-            --argjson count "$new_count" \
-            --arg accessed "$now" \
-            --argjson score "$frecency" \
-            '.bookmarks = [.bookmarks[] | if .id == $id then .access_count = $count | .last_accessed = $accessed | .frecency_score = $score else . end]' "$BOOKMARKS_FILE")
-    else
-        # Update by description
-        updated_json=$(jq --arg desc "$id_or_desc" \
-            --argjson count "$new_count" \
-            --arg accessed "$now" \
-            --argjson score "$frecency" \
-            '.bookmarks = [.bookmarks[] | if .description == $desc then .access_count = $count | .last_accessed = $accessed | .frecency_score = $score else . end]' "$BOOKMARKS_FILE")
+    # The store has the records now, so a crash here leaves only stale copies
+    local unarchived_ids
+    unarchived_ids=$(sed -n 2p "$result_file")
+    if [[ "$unarchived_ids" != "[]" ]]; then
+        jq -r --argjson ids "$unarchived_ids" "$STORE_LINES_JQ_DEFS"'.bookmarks |= map(select(.id | IN($ids[]) | not)) | store_lines' \
+            "$ARCHIVE_FILE" > "$ARCHIVE_FILE.tmp.$$" && mv "$ARCHIVE_FILE.tmp.$$" "$ARCHIVE_FILE"
     fi
     
-    echo "$updated_json" > "$BOOKMARKS_FILE"
+    record_context_access "${ids[@]}"
+    tail -n +3 "$result_file" | record_access_history "$EPOCHSECONDS"
+    rm -f "$result_file"
 }
 
-# Recalculate frecency scores for all bookmarks using pipeline approach
-# This is useful for updating scores after time has passed
-# Uses pure functions and pipelines following UNIX philosophy
+# Recalculate frecency scores for all bookmarks in a single jq pass
+# This is useful for updating scores after time has passed. Callers serialize
+# runs through the maintenance lock (see maintain_store and
+# run_background_maintenance); the store is read and written under the store
+# lock, so an access committed meanwhile is never overwritten
+# Counts are aged as in z.sh: once their total exceeds FRECENCY_MAX_RANK they
+# are all scaled down to 90% of it, and counts that fall below 1 are reset to
+# 0 so the bookmark drops out of the ranking (it is never deleted). The
+# hour-of-week usage buckets are scaled by the same factor
+# Returns: 0 on success (also when nothing changed), 1 on error
 recalculate_all_frecency() {
+    [[ "$STORE_LOCK_HELD" == "true" ]] || { with_store_lock recalculate_all_frecency "$@"; return; }
     validate_bookmarks_file || return 1
     
-    # Use a lock file to prevent concurrent recalculations
-    local lock_file="$BOOKMARKS_DIR/.frecency_recalc.lock"
-    
-    # Clean up stale locks (older than 60 seconds)
-    if [ -d "$lock_file" ]; then
-        # Get lock file modification time (portable for Linux and macOS)
-        # Linux uses: stat -c %Y
-        # macOS uses: stat -f %m
-        local lock_mtime
-        if lock_mtime=$(stat -c %Y "$lock_file" 2>/dev/null); then
-            : # Linux succeeded
-        elif lock_mtime=$(stat -f %m "$lock_file" 2>/dev/null); then
-            : # macOS succeeded
+    # Same z.sh formula as calculate_frecency; empty output means nothing changed
+    # Stored dates are local time and jq's mktime reads them as UTC, hence $offset
+    local updated_json
+    updated_json=$(jq -c --argjson now "$(date +%s)" --argjson offset "$(utc_offset_seconds)" \
+        --argjson max_rank "${FRECENCY_MAX_RANK:-$DEFAULT_FRECENCY_MAX_RANK}" '
+        def epoch:
+            if type == "number" then .
+            elif test("^[0-9]+$") then tonumber
+            elif test("^[0-9]{4}-[0-9]{2}-[0-9]{2} [0-9]{2}:[0-9]{2}:[0-9]{2}")
+            then .[0:19] | strptime("%Y-%m-%d %H:%M:%S") | mktime - $offset
+            else 0 end;
+        def score:
+            if (.access_count // 0) == 0 or .last_accessed == null then 0
+            else 10000 * .access_count * (3.75 / ((0.0001 * ($now - (.last_accessed | epoch)) + 1) + 0.25)) + 0.5 | floor
+            end;
+        def age_counts:
+            (map(.access_count // 0) | add // 0) as $total
+            | if $total <= $max_rank then .
+              else ($max_rank * 0.9 / $total) as $factor
+                | map(if (.access_count // 0) > 0
+                      then .access_count = ((.access_count * $factor * 100 | floor) / 100)
+                      | if .access_count < 1 then .access_count = 0 else . end
+                      | if .usage.week then .usage.week |= (map_values(. * $factor * 100 | floor / 100)
+                                                            | with_entries(select(.value >= 1)))
+                        else . end
+                      else . end)
+              end;
+        # Line 1: whether counts were aged, line 2: the updated store
+        .bookmarks as $old
+        | (.bookmarks | age_counts) as $aged
+        | .bookmarks = ($aged | map(.frecency_score = score))
+        | if .bookmarks == $old then empty else ($aged != $old), . end
+    ' "$BOOKMARKS_FILE") || return 1
+    
+    if [[ -n "$updated_json" ]]; then
+        # Aging rewrites access counts, which are not derived: the "age" op is
+        # journaled with snapshots and makes the next sync a full merge
+        local operation="rescore"
+        [[ "${updated_json%%$'\n'*}" == "true" ]] && operation="age"
+        commit_bookmarks_json "${updated_json#*$'\n'}" "$operation"
+    fi
+}
+
+#=============================================================================
+# USAGE HISTOGRAMS AND RANKING
+#=============================================================================
+
+# Every access also updates a small histogram in the bookmark's "usage" field:
+#   week - access counts keyed by local hour of the week (0 = Monday 00:00);
+#          at most 168 buckets, aged together with access_count
+#   days - a 14-slot ring of daily counts; slot (day % 14) holds local day
+#          number "day", the day of the most recent access
+# An update touches at most 14 slots however long the history is.
+# BOOKMARKS_RANKING=time weights frecency by how often a bookmark was used at
+# the current time of the week; the default ranks by frecency alone.
+
+# jq helpers for reading and updating usage histograms
+readonly USAGE_JQ_DEFS='
+def record_usage($how; $day):
+    (.usage // {week: {}, days: [range(14) | 0], day: $day}) as $u
+    | .usage = ($u
+        | if $day - .day >= 14 then .days = [range(14) | 0]
+          else reduce range(.day + 1; $day + 1) as $d (.; .days[$d % 14] = 0) end
+        | .day = ([$day, .day] | max)
+        | .days[$day % 14] += 1
+        | .week[$how | tostring] += 1);
+# Daily counts for the 14 days up to $today, oldest first
+def usage_days($today):
+    .usage as $u
+    | [range($today - 13; $today + 1) as $d
+        | if $u == null or $d > $u.day or $d <= $u.day - 14 then 0 else $u.days[$d % 14] end];
+# Counts per hour of the day, summed over the days of the week
+def usage_hours:
+    (.usage.week // {}) as $w
+    | [range(24) as $h | [range(7) as $d | $w[($d * 24 + $h) | tostring] // 0] | add];
+# Share of accesses that fell within an hour of the given hour of the week
+def time_affinity($how):
+    (.usage.week // {}) as $w | ([$w[]] | add // 0) as $total
+    | if $total == 0 then 0
+      else ([($how + 167) % 168, $how, ($how + 1) % 168] | map($w[tostring] // 0) | add) / $total end;
+def sparkline:
+    (max // 0) as $max
+    | map(if . <= 0 then "\u00b7" else ["\u2581","\u2582","\u2583","\u2584","\u2585","\u2586","\u2587","\u2588"][(. * 7 / $max) | floor] end)
+    | add // "";
+'
+
+# Offset of local time from UTC in seconds, from the bash clock
+utc_offset_seconds() {
+    local offset
+    printf -v offset '%(%z)T' -1
+    echo $(( ${offset:0:1}1 * (10#${offset:1:2} * 3600 + 10#${offset:3:2} * 60) ))
+}
+
+# Set CURRENT_HOUR_OF_WEEK and CURRENT_LOCAL_DAY from the bash clock
+load_usage_clock() {
+    local weekday hour epoch
+    printf -v weekday '%(%u)T' -1
+    printf -v hour '%(%H)T' -1
+    printf -v epoch '%(%s)T' -1
+    CURRENT_HOUR_OF_WEEK=$(( (weekday - 1) * 24 + 10#$hour ))
+    CURRENT_LOCAL_DAY=$(( (epoch + $(utc_offset_seconds)) / 86400 ))
+}
+load_usage_clock
+
+#=============================================================================
+# WORKING CONTEXT
+#=============================================================================
+
+# Each access is also counted against the directory it ran from and, inside
+# a git work tree, against the repository's top level. Every context has its
+# own small file under contexts/ named after its path, so ranking looks up
+# the current directory and repository directly instead of scanning a shared
+# index:
+#   contexts/dir-<path>.json  {"path": "/abs/dir", "counts": {"<id>": n}}
+#   contexts/git-<path>.json  same, keyed by the repository top level
+# Paths are escaped into file names (% -> %25, / -> %2F); very long paths
+# fall back to a checksum.
+CONTEXT_DIR="$BOOKMARKS_DIR/contexts"
+
+# Map a context path to its index file
+# Args: $1 - context kind (dir or git), $2 - absolute path
+# Returns: index file path
+context_index_file() {
+    local name="${2//%/%25}"
+    name="${name//\//%2F}"
+    if [[ ${#name} -gt 200 ]]; then
+        name="sum-$(printf '%s' "$2" | cksum | cut -d' ' -f1)"
+    fi
+    echo "$CONTEXT_DIR/$1-$name.json"
+}
+
+# Find the top level of the git work tree containing a directory, without
+# running git
+# Args: $1 - absolute directory
+# Returns: top-level path, or nothing outside a work tree
+find_git_toplevel() {
+    local dir="$1"
+    while [[ -n "$dir" ]]; do
+        if [[ -e "$dir/.git" ]]; then
+            echo "$dir"
+            return 0
+        fi
+        dir="${dir%/*}"
+    done
+    [[ -e "/.git" ]] && echo "/"
+    return 0
+}
+
+# Set CONTEXT_DIR_FILE / CONTEXT_GIT_FILE for the current directory and load
+# their counts into CONTEXT_DIR_JSON / CONTEXT_GIT_JSON
+load_working_context() {
+    CONTEXT_PWD="$PWD"
+    CONTEXT_GIT_TOPLEVEL=$(find_git_toplevel "$PWD")
+    CONTEXT_DIR_FILE=$(context_index_file dir "$CONTEXT_PWD")
+    CONTEXT_GIT_FILE=""
+    [[ -z "$CONTEXT_GIT_TOPLEVEL" ]] || CONTEXT_GIT_FILE=$(context_index_file git "$CONTEXT_GIT_TOPLEVEL")
+    
+    CONTEXT_DIR_JSON='{}'
+    CONTEXT_GIT_JSON='{}'
+    [[ ! -f "$CONTEXT_DIR_FILE" ]] || read -r -d '' CONTEXT_DIR_JSON < "$CONTEXT_DIR_FILE" || true
+    [[ -z "$CONTEXT_GIT_FILE" || ! -f "$CONTEXT_GIT_FILE" ]] || read -r -d '' CONTEXT_GIT_JSON < "$CONTEXT_GIT_FILE" || true
+}
+
+# Count an access of bookmarks against the current directory and repository
+# The files are read, updated and replaced under the store lock, so
+# overlapping accesses do not lose counts; a busy store skips the update
+# Args: bookmark IDs
+record_context_access() {
+    [[ "$STORE_LOCK_HELD" == "true" ]] || { with_store_lock record_context_access "$@" || true; return 0; }
+    
+    local ids_json kind path index_file
+    ids_json=$(jq -nc '$ARGS.positional' --args "$@")
+    mkdir -p "$CONTEXT_DIR"
+    for kind in dir git; do
+        if [[ "$kind" == "dir" ]]; then
+            path="$CONTEXT_PWD" index_file="$CONTEXT_DIR_FILE"
         else
-            # stat failed, skip stale lock cleanup to be safe
-            lock_mtime=""
+            path="$CONTEXT_GIT_TOPLEVEL" index_file="$CONTEXT_GIT_FILE"
         fi
-        
-        if [ -n "$lock_mtime" ]; then
-            local lock_age=$(($(date +%s) - lock_mtime))
-            if [ "$lock_age" -gt 60 ]; then
-                rmdir "$lock_file" 2>/dev/null || true
-            fi
+        [[ -n "$index_file" ]] || continue
+        if { [[ -f "$index_file" ]] && cat "$index_file" || echo '{}'; } | \
+            jq -c --arg path "$path" --argjson ids "$ids_json" '.path = $path | reduce $ids[] as $id (.; .counts[$id] += 1)' \
+            > "$index_file.tmp.$$"; then
+            mv "$index_file.tmp.$$" "$index_file"
+        else
+            rm -f "$index_file.tmp.$$"
+        fi
+    done
+}
+
+# Drop context entries for deleted bookmarks and contexts whose directory is gone
+# Holds the store lock like record_context_access
+# Args: $1 - JSON array of bookmark IDs that still exist
+# Returns: number of context files removed on stdout
+prune_context_index() {
+    [[ "$STORE_LOCK_HELD" == "true" ]] || { with_store_lock prune_context_index "$@" || echo 0; return 0; }
+    
+    local live_ids="$1" index_file path removed=0
+    for index_file in "$CONTEXT_DIR"/*.json; do
+        [[ -f "$index_file" ]] || continue
+        path=$(jq -r '.path // ""' "$index_file" 2>/dev/null) || path=""
+        if [[ -z "$path" || ! -d "$path" ]]; then
+            rm -f "$index_file"
+            removed=$((removed + 1))
+            continue
         fi
+        jq -c --argjson live "$live_ids" '
+            (reduce $live[] as $i ({}; .[$i] = true)) as $keep
+            | .counts |= with_entries(select($keep[.key]))
+        ' "$index_file" > "$index_file.tmp.$$" && mv "$index_file.tmp.$$" "$index_file"
+    done
+    echo "$removed"
+}
+
+load_working_context
+
+#=============================================================================
+# ACCESS HISTORY
+#=============================================================================
+
+# Every access is appended to a history log partitioned by local day, so the
+# directory listing is the time index: a range query only opens the buckets
+# for the days it overlaps, however many months of history there are.
+#   history/YYYY-MM-DD.jsonl  one line per access:
+#   {"t": epoch, "id", "description", "type", "tags", "command", "cwd"}
+# Entries keep a copy of the bookmark as it was run, so the timeline still
+# reads correctly after bookmarks are edited or deleted.
+HISTORY_DIR="$BOOKMARKS_DIR/history"
+
+# Append accesses to the bucket of their day
+# Args: $1 - time of the accesses in epoch seconds
+# Input: JSON history entries, one per line
+record_access_history() {
+    local day
+    printf -v day '%(%Y-%m-%d)T' "$1"
+    mkdir -p "$HISTORY_DIR"
+    cat >> "$HISTORY_DIR/$day.jsonl"
+}
+
+# Parse a history bound
+# Args: $1 - epoch seconds or a date understood by `date -d`
+# Returns: epoch seconds on stdout; 1 if the bound cannot be parsed
+parse_history_bound() {
+    if [[ "$1" =~ ^[0-9]+$ ]]; then
+        echo "$1"
+    else
+        date -d "$1" +%s 2>/dev/null
     fi
+}
+
+# Show accesses in a time range, oldest first
+# Args: --since WHEN (default 7 days ago), --until WHEN (default now),
+#       --type TYPE, --tag TAG (partial match), --json for one JSON object per
+#       access with a local "time" field added
+show_history() {
+    local since="7 days ago" until="" type="" tag="" json=false
+    local usage="Usage: $0 history [--since WHEN] [--until WHEN] [--type TYPE] [--tag TAG] [--json]"
+    
+    while [[ $# -gt 0 ]]; do
+        case "$1" in
+            --since|--until|--type|--tag)
+                if [[ $# -lt 2 ]]; then
+                    echo -e "${RED}$usage${NC}" >&2
+                    exit 1
+                fi
+                case "$1" in
+                    --since) since="$2" ;;
+                    --until) until="$2" ;;
+                    --type) type="$2" ;;
+                    --tag) tag="$2" ;;
+                esac
+                shift 2
+                ;;
+            --json)
+                json=true
+                shift
+                ;;
+            *)
+                echo -e "${RED}$usage${NC}" >&2
+                exit 1
+                ;;
+        esac
+    done
     
-    # Try to acquire lock (non-blocking)
-    if ! mkdir "$lock_file" 2>/dev/null; then
-        # Another process is already recalculating, skip this run
-        return 0
+    local since_epoch until_epoch
+    if ! since_epoch=$(parse_history_bound "$since"); then
+        echo -e "${RED}Error: Cannot parse --since '$since'${NC}" >&2
+        exit 1
+    fi
+    if [[ -z "$until" ]]; then
+        until_epoch="$EPOCHSECONDS"
+    elif ! until_epoch=$(parse_history_bound "$until"); then
+        echo -e "${RED}Error: Cannot parse --until '$until'${NC}" >&2
+        exit 1
     fi
     
-    # We acquired the lock, ensure it's removed on exit/error
-    trap "rmdir '$lock_file' 2>/dev/null || true" RETURN
-    
-    # Pipeline approach: Extract data -> Calculate scores -> Update JSON
-    # This is much more efficient than the previous loop-based approach
-    local frecency_scores
-    frecency_scores=$(cat "$BOOKMARKS_FILE" | extract_frecency_data | batch_calculate_frecency)
-    
-    # Build jq arguments for batch update
-    local jq_args=""
-    while IFS=$'\t' read -r index score; do
-        jq_args="$jq_args --argjson idx$index $index --argjson score$index $score"
-    done <<< "$frecency_scores"
+    # Only the buckets whose day falls inside the range are read
+    local first_day last_day bucket day
+    local -a buckets=()
+    printf -v first_day '%(%Y-%m-%d)T' "$since_epoch"
+    printf -v last_day '%(%Y-%m-%d)T' "$until_epoch"
+    for bucket in "$HISTORY_DIR"/*.jsonl; do
+        [[ -f "$bucket" ]] || continue
+        day="${bucket##*/}"
+        day="${day%.jsonl}"
+        [[ "$day" < "$first_day" || "$day" > "$last_day" ]] || buckets+=("$bucket")
+    done
     
-    # Generate jq update script dynamically
-    local jq_script='.bookmarks = [.bookmarks | to_entries[] | '
-    local first=true
-    while IFS=$'\t' read -r index score; do
-        if [[ "$first" == "true" ]]; then
-            jq_script="${jq_script}if .key == \$idx$index then .value.frecency_score = \$score$index"
-            first=false
-        else
-            jq_script="${jq_script} elif .key == \$idx$index then .value.frecency_score = \$score$index"
-        fi
-    done <<< "$frecency_scores"
-    jq_script="${jq_script} else .value end | .value]"
+    if [[ ${#buckets[@]} -eq 0 ]]; then
+        [[ "$json" == "true" ]] || echo -e "${YELLOW}No accesses recorded in that range${NC}"
+        return 0
+    fi
     
-    # Apply updates in single jq call
-    if [[ -n "$jq_args" ]]; then
-        local updated_json
-        updated_json=$(jq $jq_args "$jq_script" "$BOOKMARKS_FILE")
-        echo "$updated_json" > "$BOOKMARKS_FILE"
+    local entries
+    entries=$(jq -c --argjson since "$since_epoch" --argjson until "$until_epoch" \
+        --arg type "$type" --arg tag "$tag" '
+        select(.t >= $since and .t <= $until)
+        | select($type == "" or .type == $type)
+        | select($tag == "" or (.tags // "" | contains($tag)))
+        | {time: (.t | strflocaltime("%Y-%m-%d %H:%M:%S"))} + .
+    ' "${buckets[@]}")
+    
+    if [[ "$json" == "true" ]]; then
+        [[ -z "$entries" ]] || printf '%s\n' "$entries"
+    elif [[ -z "$entries" ]]; then
+        echo -e "${YELLOW}No accesses recorded in that range${NC}"
+    else
+        jq -r '"\(.time)\t[\(.type)] \(.description)\t\(.cwd // "")"' <<< "$entries" | \
+            while IFS=$'\t' read -r time label cwd; do
+                echo -e "${BLUE}$time${NC}  $label  ${CYAN}$cwd${NC}"
+            done
     fi
 }
 
+# Drop history buckets older than the retention period
+# Args: $1 - days of history to keep (0 keeps everything)
+# Returns: number of buckets removed on stdout
+prune_access_history() {
+    local keep_days="$1" oldest bucket day removed=0
+    if [[ "$keep_days" -gt 0 && -d "$HISTORY_DIR" ]]; then
+        printf -v oldest '%(%Y-%m-%d)T' "$((EPOCHSECONDS - keep_days * 86400))"
+        for bucket in "$HISTORY_DIR"/*.jsonl; do
+            [[ -f "$bucket" ]] || continue
+            day="${bucket##*/}"
+            if [[ "${day%.jsonl}" < "$oldest" ]]; then
+                rm -f "$bucket"
+                removed=$((removed + 1))
+            fi
+        done
+    fi
+    echo "$removed"
+}
+
+#=============================================================================
+# EXECUTION TELEMETRY
+#=============================================================================
+
+# cmd, script and ssh bookmarks are timed, and the outcome of each run is kept
+# on the bookmark as a small streaming summary instead of raw samples:
+#   runs.count / runs.failures        - runs so far and how many exited non-zero
+#   runs.last_status / last_ms / last_run
+#   runs.sketch                       - durations in log-spaced buckets keyed
+#                                       by ceil(log_1.1(ms)), as in DDSketch
+# Quantiles read from the sketch are within about 5% of the true value. The
+# sketch never holds more than 64 buckets: beyond that the two lowest are
+# merged, which only coarsens the fastest runs.
+
+# jq helpers for recording and summarising runs
+readonly TELEMETRY_JQ_DEFS='
+def run_bucket: if . <= 1 then 0 else (log / (1.1 | log)) | ceil end;
+def record_run($ms; $status; $at):
+    (.runs // {count: 0, failures: 0, sketch: {}}) as $r
+    | .runs = ($r
+        | .count += 1
+        | .failures += (if $status == 0 then 0 else 1 end)
+        | .last_status = $status | .last_ms = $ms | .last_run = $at
+        | .sketch[$ms | run_bucket | tostring] += 1
+        | if (.sketch | length) > 64 then
+            (.sketch | keys | map(tonumber) | sort | map(tostring)) as $k
+            | .sketch[$k[1]] += .sketch[$k[0]] | del(.sketch[$k[0]])
+          else . end);
+# Duration in ms at quantile $q, or null before the first run
+def run_quantile($q):
+    (.runs.sketch // {}) | [to_entries[] | [(.key | tonumber), .value]] | sort_by(.[0]) as $b
+    | ([$b[][1]] | add // 0) as $n
+    | if $n == 0 then null
+      else ($q * ($n - 1)) as $rank
+        | first(foreach $b[] as $e (0; . + $e[1]; if . > $rank then $e[0] else empty end))
+        | if . == 0 then 1 else 2 * pow(1.1; .) / 2.1 end
+      end;
+def failure_rate: if (.runs.count // 0) == 0 then 0 else .runs.failures / .runs.count end;
+def format_ms:
+    if . == null then "N/A"
+    elif . < 1000 then "\(. + 0.5 | floor) ms"
+    elif . < 60000 then "\(. / 100 + 0.5 | floor / 10) s"
+    else "\(. / 6000 + 0.5 | floor / 10) min" end;
+def format_percent: "\(. * 100 + 0.5 | floor)%";
+'
+
+# Timed runs write "ms<TAB>status" here; the caller records the run in the
+# same commit as the access (execute_selected_bookmark, run_bookmarks_parallel)
+TELEMETRY_RESULT_FILE=""
+
+# Run a command, then report how long it took and how it exited
+# Args: $1 - command, $2 - bookmark description,
+#       $3 - output cache entry to fill on success (optional)
+# Returns: the command's exit status
+run_with_telemetry() {
+    local command="$1"
+    local description="$2"
+    local cache_entry="${3:-}"
+    local started exit_status
+    
+    # The subshell keeps errexit semantics and lets an `exit` in the command
+    # end only the command, so its status is still recorded
+    started=$(now_microseconds)
+    set +e
+    if [[ -n "$cache_entry" ]]; then
+        mkdir -p "$OUTPUT_CACHE_DIR"
+        ( set -e; eval "$command" ) | tee "$cache_entry.tmp.$$"
+        exit_status=${PIPESTATUS[0]}
+    else
+        ( set -e; eval "$command" )
+        exit_status=$?
+    fi
+    set -e
+    if [[ -n "$cache_entry" ]]; then
+        if [[ "$exit_status" -eq 0 ]]; then
+            store_cached_output "$cache_entry" "$cache_entry.tmp.$$"
+        else
+            rm -f "$cache_entry.tmp.$$"
+        fi
+    fi
+    local duration_ms=$(( ($(now_microseconds) - started) / 1000 ))
+    if [[ -n "$TELEMETRY_RESULT_FILE" ]]; then
+        printf '%s\t%s\n' "$duration_ms" "$exit_status" > "$TELEMETRY_RESULT_FILE"
+    fi
+    return "$exit_status"
+}
+
+# Show run statistics: a table of every bookmark that has run, failing and
+# slow ones first, or the full statistics of one bookmark
+# Args: $1 - bookmark ID or description (optional)
+show_stats() {
+    local id_or_desc="${1:-}"
+    validate_bookmarks_file || return 1
+    
+    if [[ -n "$id_or_desc" ]]; then
+        local bookmark
+        bookmark=$(get_bookmark_by_id_or_desc "$id_or_desc")
+        if [[ -z "$bookmark" ]]; then
+            echo -e "${RED}Error: Bookmark not found: $id_or_desc${NC}" >&2
+            exit 1
+        fi
+        echo -e "${BLUE}Statistics for ${CYAN}$(jq -r '.description' <<< "$bookmark")${NC}"
+        jq -r "$TELEMETRY_JQ_DEFS"'
+            "  Access Count:    \(.access_count // 0)",
+            "  Last Accessed:   \(.last_accessed // "N/A")",
+            "  Frecency Score:  \(.frecency_score // 0)",
+            if .runs then
+                "  Runs:            \(.runs.count) (\(failure_rate | format_percent) failed, last exit \(.runs.last_status))",
+                "  Duration:        p50 \(run_quantile(0.5) | format_ms), p95 \(run_quantile(0.95) | format_ms), last \(.runs.last_ms | format_ms)",
+                "  Last Run:        \(.runs.last_run)"
+            else "  Runs:            none recorded" end
+        ' <<< "$bookmark"
+        return 0
+    fi
+    
+    local rows
+    rows=$(jq -r "$TELEMETRY_JQ_DEFS"'
+        [.bookmarks[] | select(.runs) | {description, count: .runs.count, rate: failure_rate,
+            p50: run_quantile(0.5), p95: run_quantile(0.95)}]
+        | sort_by(-.rate, -.p95)[]
+        | [.description, .count, (.p50 | format_ms), (.p95 | format_ms), (.rate | format_percent), .rate] | @tsv
+    ' "$BOOKMARKS_VIEW_FILE")
+    if [[ -z "$rows" ]]; then
+        echo -e "${YELLOW}No runs recorded yet${NC}"
+        return 0
+    fi
+    
+    printf "${BLUE}%-40s %6s %10s %10s %7s${NC}\n" "Description" "Runs" "p50" "p95" "Failed"
+    local description count p50 p95 failed rate color
+    while IFS=$'\t' read -r description count p50 p95 failed rate; do
+        color="$NC"
+        [[ "$rate" == "0" ]] || color="$RED"
+        printf "${color}%-40s %6s %10s %10s %7s${NC}\n" "${description:0:40}" "$count" "$p50" "$p95" "$failed"
+    done <<< "$rows"
+}
+
+#=============================================================================
+# OUTPUT CACHE
+#=============================================================================
+
+# cmd and script bookmarks with a cache_ttl (seconds) replay the output of
+# their last successful run while it is younger than the TTL instead of
+# running again; `bookmark --fresh` bypasses the cache. Only stdout is kept:
+#   output_cache/<id>-<checksum of command>.out   output; mtime = time of run
+#   output_cache/<id>-<checksum of command>.used  touched on every replay
+# Editing the command changes the key, so stale output is never replayed.
+# When the cache outgrows OUTPUT_CACHE_MAX_BYTES the least recently used
+# outputs are evicted.
+OUTPUT_CACHE_DIR="$BOOKMARKS_DIR/output_cache"
+
+# Set by `bookmark --fresh` to run cached bookmarks even when their output is fresh
+OUTPUT_CACHE_FRESH=false
+
+# Map a bookmark and its command to its cache entry
+# Args: $1 - bookmark ID, $2 - command
+# Returns: cache entry path without extension
+output_cache_entry() {
+    echo "$OUTPUT_CACHE_DIR/$1-$(printf '%s' "$2" | cksum | cut -d' ' -f1)"
+}
+
+# Replay a cached output if it is younger than the TTL
+# Args: $1 - cache entry, $2 - TTL in seconds
+# Returns: 0 after replaying, 1 if there is no fresh output
+replay_cached_output() {
+    local entry="$1"
+    local ttl="$2"
+    [[ "$OUTPUT_CACHE_FRESH" != "true" ]] || return 1
+    
+    local age
+    age=$(file_age_seconds "$entry.out")
+    [[ -n "$age" && "$age" -lt "$ttl" ]] || return 1
+    
+    touch "$entry.used"
+    echo -e "${BLUE}Cached output from ${age}s ago (cache_ttl ${ttl}s, use --fresh to re-run)${NC}" >&2
+    cat "$entry.out"
+}
+
+# Store the output of a successful run and evict least recently used outputs
+# until the cache fits in OUTPUT_CACHE_MAX_BYTES
+# Args: $1 - cache entry, $2 - file holding the output
+store_cached_output() {
+    local entry="$1"
+    local output_file="$2"
+    local max_bytes="${OUTPUT_CACHE_MAX_BYTES:-$DEFAULT_OUTPUT_CACHE_MAX_BYTES}"
+    
+    # An output that alone exceeds the limit is not worth evicting everything for
+    if [[ $(wc -c < "$output_file") -gt "$max_bytes" ]]; then
+        rm -f "$output_file"
+        return 0
+    fi
+    mv "$output_file" "$entry.out"
+    touch "$entry.used"
+    
+    local total used_file
+    total=$(cat "$OUTPUT_CACHE_DIR"/*.out 2>/dev/null | wc -c)
+    [[ "$total" -gt "$max_bytes" ]] || return 0
+    while read -r used_file; do
+        [[ "$total" -gt "$max_bytes" ]] || break
+        [[ "$used_file" != "$entry.used" ]] || continue
+        total=$(( total - $( { wc -c < "${used_file%.used}.out"; } 2>/dev/null || echo 0) ))
+        rm -f "${used_file%.used}.out" "$used_file"
+    done < <(ls -tr "$OUTPUT_CACHE_DIR"/*.used)
+}
+
+# Drop cached outputs of deleted bookmarks
+# Args: $1 - JSON array of bookmark IDs that still exist
+# Returns: number of outputs removed on stdout
+prune_output_cache() {
+    local live_ids="$1" entry id removed=0
+    local -A live=()
+    while read -r id; do
+        live["$id"]=1
+    done < <(jq -r '.[]' <<< "$live_ids")
+    for entry in "$OUTPUT_CACHE_DIR"/*.used; do
+        [[ -f "$entry" ]] || continue
+        id="${entry##*/}"
+        id="${id%-*}"
+        if [[ -z "${live[$id]:-}" ]]; then
+            rm -f "${entry%.used}.out" "$entry"
+            removed=$((removed + 1))
+        fi
+    done
+    echo "$removed"
+}
+
+#=============================================================================
+# RANKING WEIGHTS AND SELECTION LOG
+#=============================================================================
+
+# rank_score orders bookmarks in every listing, fzf and completion path. It is
+# a weighted blend of four features:
+#   frequency - log of the access count
+#   recency   - log of the z.sh recency factor (frecency_score / 10000 / count)
+#   (both are -10 for bookmarks without a frecency score)
+#   context   - u / (u + 2), where u counts runs from this directory and repository
+#   time      - share of accesses within an hour of this time of the week
+# score = w_frequency * frequency + w_recency * recency
+#         + log(1 + w_context * context) + log(1 + w_time * time)
+# With frequency and recency weights of 1 this orders exactly like
+# frecency * (1 + w_context * context) * (1 + w_time * time). The time term
+# only applies with BOOKMARKS_RANKING=time. `tune` fits the weights to the
+# selection log and stores them in ranking_weights.
+RANKING_WEIGHTS_FILE="$BOOKMARKS_DIR/ranking_weights"
+SELECTION_LOG_FILE="$BOOKMARKS_DIR/selections.jsonl"
+
+# Load ranking weights (key=value lines) over the defaults into RANKING_WEIGHTS
+load_ranking_weights() {
+    local -A weights=([frequency]=1 [recency]=1 [context]=9 [time]=2)
+    if [[ -f "$RANKING_WEIGHTS_FILE" ]]; then
+        local key value
+        while IFS='=' read -r key value; do
+            [[ -n "${weights[$key]:-}" && "$value" =~ ^[0-9]+(\.[0-9]+)?$ ]] && weights["$key"]="$value"
+        done < "$RANKING_WEIGHTS_FILE"
+    fi
+    [[ "${BOOKMARKS_RANKING:-$DEFAULT_RANKING_MODE}" == "time" ]] || weights[time]=0
+    RANKING_WEIGHTS="{\"frequency\": ${weights[frequency]}, \"recency\": ${weights[recency]}, \"context\": ${weights[context]}, \"time\": ${weights[time]}}"
+}
+load_ranking_weights
+
+# jq helpers shared by ranking, the selection log and `tune`
+readonly RANKING_FEATURE_JQ_DEFS='
+def rank_features($how; $with_time):
+    ([.access_count // 0, 1] | max) as $count | (.frecency_score // 0) as $score
+    | [ (if $score > 0 then $count | log else -10 end),
+        (if $score > 0 then $score / (10000 * $count) | log else -10 end),
+        ((($context_dir.counts[.id] // 0) + ($context_git.counts[.id] // 0)) as $u | $u / ($u + 2)),
+        (if $with_time then time_affinity($how) else 0 end) ];
+def blend($w):
+    .[0] * $w.frequency + .[1] * $w.recency + (1 + $w.context * .[2] | log) + (1 + $w.time * .[3] | log);
+'
+RANKING_JQ_DEFS="$USAGE_JQ_DEFS$RANKING_FEATURE_JQ_DEFS
+def rank_score: $RANKING_WEIGHTS as \$w | rank_features($CURRENT_HOUR_OF_WEEK; \$w.time > 0) | blend(\$w);
+"
+# jq arguments that go with RANKING_JQ_DEFS
+RANKING_JQ_ARGS=(--argjson context_dir "$CONTEXT_DIR_JSON" --argjson context_git "$CONTEXT_GIT_JSON")
+
+# Run fzf over a ranked list and print the chosen line
+# With BOOKMARKS_LOG_SELECTIONS=true the query and the chosen item's position
+# are appended to the selection log
+# Args: $1 - ranked list (one formatted bookmark per line), $@ - fzf options
+fzf_select_ranked() {
+    local list="$1"
+    shift
+    if [[ "${BOOKMARKS_LOG_SELECTIONS:-false}" != "true" ]]; then
+        fzf "$@" <<< "$list"
+        return
+    fi
+    
+    local output query selected
+    output=$(fzf "$@" --print-query <<< "$list") || return $?
+    query="${output%%$'\n'*}"
+    [[ "$output" == *$'\n'* ]] && selected="${output#*$'\n'}" || selected=""
+    [[ -n "$selected" ]] || return 1
+    
+    # With --multi every picked line counts as a selection
+    local line
+    while IFS= read -r line; do
+        log_selection "$query" "$line" "$list" "$@" 2>/dev/null || true
+    done <<< "$selected"
+    echo "$selected"
+}
+
+# Append one selection to the log: the query, the chosen item's position among
+# the bookmarks matching it, the candidate count, and the ranking features of
+# the chosen item and of its neighbours (up to 50 above and 10 below), so that
+# `tune` can re-rank them under other weights
+# The matches are listed by fzf --filter with the picker's matching and sort
+# options, so a typed query is ordered by match score as it was on screen
+# Args: $1 - query, $2 - chosen line, $3 - ranked list shown to fzf,
+#       $@ - the picker's fzf options
+log_selection() {
+    local query="$1" chosen="$2" list="$3"
+    shift 3
+    
+    local matches="$list"
+    if [[ -n "$query" ]]; then
+        local option
+        local -a filter_options=()
+        for option in "$@"; do
+            case "$option" in
+                --tiebreak=*|--no-sort|+s|--tac|--exact|-e|--literal|-i|+i|--ignore-case|--no-ignore-case|--smart-case|--scheme=*|--algo=*|--nth=*|--with-nth=*|--delimiter=*|--ansi)
+                    filter_options+=("$option") ;;
+            esac
+        done
+        matches=$(fzf --filter="$query" "${filter_options[@]}" <<< "$list") || return 0
+    fi
+    
+    mkdir -p "$BOOKMARKS_DIR"
+    rotate_log "$SELECTION_LOG_FILE" "${LOG_MAX_BYTES:-$DEFAULT_LOG_MAX_BYTES}" || true
+    sed -E 's/\x1B\[[0-9;]*[mK]//g' <<< "$matches" | \
+    jq -R -s -c "${RANKING_JQ_ARGS[@]}" \
+        --slurpfile store "$BOOKMARKS_VIEW_FILE" \
+        --arg chosen "$(sed -E 's/\x1B\[[0-9;]*[mK]//g' <<< "$chosen")" \
+        --arg query "$query" \
+        --argjson how "$CURRENT_HOUR_OF_WEEK" \
+        --argjson now "$(date +%s)" \
+        "$USAGE_JQ_DEFS$RANKING_FEATURE_JQ_DEFS"'
+        def features: rank_features($how; true) | map(. * 1000 | round / 1000);
+        (reduce $store[0].bookmarks[] as $r ({}; .["[" + $r.type + "] " + $r.description] = $r)) as $by_line
+        | [split("\n")[] | select($by_line[.] != null)] as $lines
+        | ($lines | index([$chosen]) // empty) as $pos
+        | ([$pos - 50, 0] | max) as $from
+        | {t: $now, q: $query, n: ($lines | length), pos: ($pos + 1), hidden: $from,
+           c: ($by_line[$chosen] | features),
+           o: [$lines[$from:$pos][], $lines[$pos + 1:$pos + 11][] | $by_line[.] | features]}
+    ' >> "$SELECTION_LOG_FILE"
+}
+
+# Fit the ranking weights to the selection log by coordinate descent and
+# report mean position, top-1 rate and mean reciprocal rank before and after
+# Args: $1 - "--dry-run" to report without saving the weights
+tune_ranking_weights() {
+    local dry_run="${1:-}"
+    
+    if [[ ! -s "$SELECTION_LOG_FILE" ]]; then
+        echo -e "${YELLOW}No selections recorded yet.${NC}"
+        echo "Set BOOKMARKS_LOG_SELECTIONS=true and pick bookmarks through fzf to build up a history."
+        return 1
+    fi
+    
+    # Current weights with the time term, so it can be fitted too
+    local current
+    current=$(BOOKMARKS_RANKING=time; load_ranking_weights; echo "$RANKING_WEIGHTS")
+    
+    # Include the rotated log, if any
+    local -a log_files=("$SELECTION_LOG_FILE")
+    [[ ! -f "$SELECTION_LOG_FILE.1" ]] || log_files=("$SELECTION_LOG_FILE.1" "$SELECTION_LOG_FILE")
+    
+    local result
+    result=$(jq -s -c --argjson start "$current" '
+        def blend($w):
+            .[0] * $w.frequency + .[1] * $w.recency + (1 + $w.context * .[2] | log) + (1 + $w.time * .[3] | log);
+        # Position of the chosen item when its logged neighbours are re-ranked;
+        # items above the logged window stay above, ties count half
+        def position($w):
+            (.c | blend($w)) as $s
+            | 1 + .hidden + ([.o[] | blend($w) | if . > $s then 1 elif . == $s then 0.5 else 0 end] | add // 0);
+        def metrics($w):
+            [.[] | position($w)] as $p
+            | {mean_position: ($p | add / length),
+               top1: ([$p[] | select(. < 1.5)] | length / ($p | length)),
+               mrr: ([$p[] | 1 / .] | add / length)};
+        def candidates($name):
+            {frequency: [0, 0.25, 0.5, 1, 2, 4], recency: [0, 0.25, 0.5, 1, 2, 4],
+             context: [0, 1, 3, 9, 27, 81], time: [0, 1, 2, 4, 8, 16]}[$name];
+        [.[] | select(.c != null)] as $log
+        | ($log | metrics($start)) as $before
+        | (reduce range(3) as $round ($start;
+            reduce ("frequency", "recency", "context", "time") as $name (.;
+                . as $w
+                | [candidates($name)[] as $v | ($w | .[$name] = $v) as $c | {w: $c, m: ($log | metrics($c)).mean_position}]
+                | min_by(.m) as $best
+                | if $best.m < ($log | metrics($w)).mean_position then $best.w else $w end))) as $after
+        | {selections: ($log | length), before: $before, after: ($log | metrics($after)), weights: $after}
+    ' "${log_files[@]}") || return 1
+    
+    echo -e "${BLUE}Tuned ranking weights on ${CYAN}$(jq '.selections' <<< "$result")${BLUE} recorded selections${NC}"
+    jq -r '
+        def pad($n): tostring | . + (" " * ([$n - length, 1] | max));
+        def row($name; f): "  \($name | pad(22))\(.before | f | . * 1000 | round / 1000 | pad(8)) -> \(.after | f | . * 1000 | round / 1000)";
+        row("mean position"; .mean_position), row("top-1 rate"; .top1), row("mean reciprocal rank"; .mrr),
+        "", "  weights: " + (.weights | to_entries | map("\(.key)=\(.value)") | join(" "))
+    ' <<< "$result"
+    
+    if [[ "$dry_run" == "--dry-run" ]]; then
+        echo -e "${YELLOW}Dry run; weights not saved${NC}"
+        return 0
+    fi
+    jq -r '.weights | to_entries[] | "\(.key)=\(.value)"' <<< "$result" > "$RANKING_WEIGHTS_FILE"
+    echo -e "${GREEN}Saved to $RANKING_WEIGHTS_FILE${NC}"
+}
+
+#=============================================================================
+# STORE GENERATIONS AND CHANGE FEED
+#=============================================================================
+
+# Every write of bookmarks.json goes through commit_bookmarks_json, which
+# stamps the store with the next generation and appends the affected IDs to
+# a bounded change log. Consumers remember the last generation they saw and
+# ask `changes --since N` for everything newer.
+#
+# The store is written with one bookmark per line, its ID first:
+#   {"generation":12,"bookmarks":[
+#   {"id":"...","description":"...",...},
+#   {"id":"...","description":"...",...}
+#   ]}
+# It is still one JSON document for every reader, but sync can find and
+# replace records by ID with grep and awk without parsing the rest (see
+# select_sync_records and splice_store_records). The archive uses the same
+# layout.
+
+# jq helper that prints a store in the record-per-line layout (use with jq -r)
+readonly STORE_LINES_JQ_DEFS='
+def store_lines:
+    (del(.bookmarks) | tojson | .[1:-1]) as $keys
+    | "{\($keys)\(if $keys == "" then "" else "," end)\"bookmarks\":[",
+      (.bookmarks | (length - 1) as $last
+        | range(0; length) as $i
+        | ({id: .[$i].id} + .[$i] | tojson) + (if $i < $last then "," else "" end)),
+      "]}";
+'
+
+# Check whether a store or archive file is in the record-per-line layout
+# Args: $1 - file
+# Returns: 0 if it is, 1 otherwise
+store_has_record_lines() {
+    local header
+    header=$(head -c 4096 "$1" 2>/dev/null | head -n 1)
+    [[ "$header" =~ ^\{(.*,)?\"bookmarks\":\[$ ]]
+}
+
+# Copy a store in the record-per-line layout from stdin, stamping its header
+# with a generation; the records are copied without being parsed
+# Args: $1 - generation
+stamp_store_lines() {
+    local header
+    IFS= read -r header || return 1
+    [[ "$header" =~ ^\{(\"generation\":[0-9]+,)?(.*\"bookmarks\":\[)$ ]] || return 1
+    printf '{"generation":%s,%s\n' "$1" "${BASH_REMATCH[2]}"
+    cat
+}
+
+# Get the generation number of the bookmarks store
+# Reads the tail of the change log instead of parsing the whole store
+# Returns: generation as an integer (0 for stores that predate generations)
+get_store_generation() {
+    if [[ -n "$STORE_GENERATION" ]]; then
+        echo "$STORE_GENERATION"
+        return
+    fi
+    
+    local last_line=""
+    if [[ -s "$CHANGE_LOG_FILE" ]]; then
+        last_line=$(tail -n 1 "$CHANGE_LOG_FILE")
+    fi
+    
+    if [[ "$last_line" =~ ^([0-9]+)$'\t' ]]; then
+        echo "${BASH_REMATCH[1]}"
+    else
+        jq '.generation // 0' "$BOOKMARKS_FILE"
+    fi
+}
+
+# Keep the change log within CHANGE_LOG_MAX_ENTRIES lines
+# Trims on generation boundaries so a generation is never half-logged
+# Args: $1 - maximum number of lines to keep
+trim_change_log() {
+    local max_entries="$1"
+    local tmp_file="$CHANGE_LOG_FILE.tmp.$$"
+    local line_count
+    line_count=$(wc -l < "$CHANGE_LOG_FILE")
+    [[ "$line_count" -gt "$max_entries" ]] || return 0
+    
+    tail -n "$max_entries" "$CHANGE_LOG_FILE" | awk -F'\t' '
+        NR == 1 { first = $1 }
+        $1 != first || seen_other { seen_other = 1; print }
+    ' > "$tmp_file" && mv "$tmp_file" "$CHANGE_LOG_FILE"
+}
+
+# Run a command while holding the store lock
+# Writers read the store, compute the new version and commit it inside one
+# call, so no other invocation can commit in between and have its update
+# overwritten. Nested calls, including commit_bookmarks_stream, reuse the
+# lock that is already held
+# Args: command and its arguments
+# Returns: the command's status, 1 if the lock could not be taken
+with_store_lock() {
+    if [[ "$STORE_LOCK_HELD" == "true" ]]; then
+        "$@"
+        return
+    fi
+    
+    local lock_file="$BOOKMARKS_DIR/.store.lock"
+    if ! try_lock "$lock_file" 10; then
+        echo -e "${RED}Error: Timed out waiting for the bookmarks store lock${NC}" >&2
+        return 1
+    fi
+    # An exit inside the command must not leave an mkdir lock behind
+    trap 'release_lock "$BOOKMARKS_DIR/.store.lock"' EXIT
+    STORE_LOCK_HELD=true
+    
+    "$@"
+    local status=$?
+    
+    STORE_LOCK_HELD=false
+    trap - EXIT
+    release_lock "$lock_file"
+    return "$status"
+}
+
+# Atomically write a new version of the store and log the change
+# Args: $1 - updated JSON, $2 - operation name, $3 - JSON array of affected IDs (default ["*"])
+# Returns: 0 on success, 1 if the store lock could not be taken or the write failed
+commit_bookmarks_json() {
+    commit_bookmarks_stream "$2" "${3:-}" < <(printf '%s\n' "$1")
+}
+
+# Same as commit_bookmarks_json, reading the updated JSON from stdin
+# Large stores are streamed from a file instead of passing through a variable.
+# Callers that computed the JSON from the store should run inside
+# with_store_lock, so the store cannot change between their read and this write
+# Args: $1 - operation name, $2 - JSON array of affected IDs (default ["*"])
+# Returns: 0 on success, 1 if the store lock could not be taken or the write failed
+commit_bookmarks_stream() {
+    [[ "$STORE_LOCK_HELD" == "true" ]] || { with_store_lock commit_bookmarks_stream "$@"; return; }
+    
+    local operation="$1"
+    local ids_json="${2:-[\"*\"]}"
+    local lines_input="$STORE_LINES_INPUT"
+    STORE_LINES_INPUT=false
+    
+    STORE_GENERATION=""
+    local generation
+    generation=$(( $(get_store_generation) + 1 ))
+    
+    local -a stamp=(jq -r --argjson generation "$generation"
+        "$STORE_LINES_JQ_DEFS"'{generation: $generation} + del(.generation) | store_lines')
+    [[ "$lines_input" != "true" ]] || stamp=(stamp_store_lines "$generation")
+    
+    # Empty input (a failed read upstream) must never replace the store
+    local tmp_file="$BOOKMARKS_FILE.tmp.$$"
+    if ! "${stamp[@]}" > "$tmp_file" \
+        || [[ ! -s "$tmp_file" ]] \
+        || ! append_journal_entry "$generation" "$operation" "$ids_json" "$tmp_file" \
+        || ! mv "$tmp_file" "$BOOKMARKS_FILE"; then
+        rm -f "$tmp_file"
+        echo -e "${RED}Error: Failed to write $BOOKMARKS_FILE${NC}" >&2
+        return 1
+    fi
+    STORE_GENERATION="$generation"
+    
+    local -a ids=()
+    readarray -t ids < <(jq -r '.[]' <<< "$ids_json")
+    [[ ${#ids[@]} -gt 0 ]] || ids=("*")
+    
+    local id timestamp="$EPOCHSECONDS"
+    for id in "${ids[@]}"; do
+        printf '%s\t%s\t%s\t%s\n' "$generation" "$operation" "$id" "$timestamp"
+    done >> "$CHANGE_LOG_FILE"
+    
+    # Trim a few times per CHANGE_LOG_MAX_ENTRIES generations rather than on every write
+    local max_entries="${CHANGE_LOG_MAX_ENTRIES:-$DEFAULT_CHANGE_LOG_MAX_ENTRIES}"
+    local trim_interval=$(( (max_entries + 3) / 4 ))
+    if (( generation % trim_interval == 0 )); then
+        trim_change_log "$max_entries"
+    fi
+    
+    local journal_max="${JOURNAL_MAX_ENTRIES:-$DEFAULT_JOURNAL_MAX_ENTRIES}"
+    if (( generation % ((journal_max + 3) / 4) == 0 )); then
+        trim_journal "$journal_max"
+    fi
+    
+    # Keep the layered view in step for reads later in this invocation
+    if [[ ${#BOOKMARK_LAYERS[@]} -gt 0 ]]; then
+        build_bookmarks_view
+    fi
+}
+
+# Print change log lines newer than a generation
+# Args: $1 - generation to start after
+print_changes_since() {
+    local since="$1"
+    [[ -f "$CHANGE_LOG_FILE" ]] || return 0
+    awk -F'\t' -v since="$since" '$1 > since' "$CHANGE_LOG_FILE"
+}
+
+# Block until something in the bookmarks directory changes
+# Uses inotifywait when available, otherwise sleeps for the poll interval
+wait_for_store_change() {
+    if has_capability inotifywait; then
+        # Watch the directory: trimming replaces the log file via rename
+        inotifywait -qq -t 60 -e close_write -e moved_to "$BOOKMARKS_DIR" 2>/dev/null || true
+    else
+        sleep "${CHANGES_POLL_INTERVAL:-$DEFAULT_CHANGES_POLL_INTERVAL}"
+    fi
+}
+
+# Show the change feed for incremental consumers
+# Output lines are "generation<TAB>op<TAB>id<TAB>epoch"; an id of "*" means
+# the whole store was rewritten (rescoring, migrations, restores)
+# Args: --since N (default 0), --follow to keep streaming new changes
+# Returns: exits 2 when the log no longer reaches back to N (consumer must resync)
+show_changes() {
+    local since=0
+    local follow=false
+    
+    while [[ $# -gt 0 ]]; do
+        case "$1" in
+            --since)
+                since="${2:-}"
+                shift 2 || shift
+                ;;
+            --follow|-f)
+                follow=true
+                shift
+                ;;
+            *)
+                echo -e "${RED}Usage: $0 changes [--since N] [--follow]${NC}" >&2
+                exit 1
+                ;;
+        esac
+    done
+    
+    if ! [[ "$since" =~ ^[0-9]+$ ]]; then
+        echo -e "${RED}Error: --since expects a generation number${NC}" >&2
+        exit 1
+    fi
+    
+    # The oldest logged generation tells whether history since N is complete
+    local first_line="" oldest
+    if [[ -s "$CHANGE_LOG_FILE" ]]; then
+        read -r first_line < "$CHANGE_LOG_FILE"
+    fi
+    oldest="${first_line%%$'\t'*}"
+    if [[ -z "$oldest" ]]; then
+        oldest=$(( $(get_store_generation) + 1 ))
+    fi
+    if (( since < oldest - 1 )); then
+        echo -e "${YELLOW}Warning: Change log starts at generation $oldest; changes after $since are incomplete. Re-read $BOOKMARKS_FILE.${NC}" >&2
+        print_changes_since "$since"
+        exit 2
+    fi
+    
+    local output
+    while true; do
+        output=$(print_changes_since "$since")
+        if [[ -n "$output" ]]; then
+            printf '%s\n' "$output"
+            local last_line="${output##*$'\n'}"
+            since="${last_line%%$'\t'*}"
+        fi
+        
+        [[ "$follow" == "true" ]] || break
+        wait_for_store_change
+    done
+}
+
+#=============================================================================
+# STORE SYNC
+#=============================================================================
+
+# `sync` merges this store with a peer store (a bookmarks directory or a
+# bookmarks.json file). Per peer, $BOOKMARKS_DIR/sync/ keeps both stores'
+# signatures from the last sync (<peer>.state) and the merged records of that
+# sync (<peer>.base, "id<TAB>record" lines) as the common ancestor. Only IDs
+# named in either change log since then are read from each side, merged and
+# applied by ID; when neither store has changed the sync is a no-op that never
+# parses either store. The base is append-only: each sync adds the records it
+# merged, the last line of an ID wins ("null" once the bookmark is gone), and
+# superseded lines are compacted away once they outweigh the store. With the
+# stores in the record-per-line layout the work of a sync grows with the
+# number of changed bookmarks, not with the size of the stores.
+SYNC_DIR="$BOOKMARKS_DIR/sync"
+
+# Fields merged three-way against the common ancestor; the side with the newer
+# `modified` wins a field only when both sides changed it
+readonly SYNC_CONTENT_FIELDS='["description","type","command","tags","notes","status","cache_ttl","on_failure","host_group"]'
+
+# Get a cheap signature of a store: its generation when it has a change log,
+# otherwise the file's modification time and size
+# Args: $1 - bookmarks file, $2 - change log (may be empty)
+# Returns: "g<generation>" or "s<mtime>:<size>"
+peer_store_signature() {
+    local peer_file="$1"
+    local peer_log="$2"
+    local last_line=""
+    
+    if [[ -n "$peer_log" && -s "$peer_log" ]]; then
+        last_line=$(tail -n 1 "$peer_log")
+        echo "g${last_line%%$'\t'*}"
+    elif [[ -f "$peer_file" ]]; then
+        echo "s$(stat -c '%Y:%s' "$peer_file" 2>/dev/null || stat -f '%m:%z' "$peer_file")"
+    else
+        echo "s0:0"
+    fi
+}
+
+# List the IDs a change log records after a generation
+# Frecency rescoring is ignored: scores are derived data recomputed locally.
+# Aging ("age") rewrites access counts, so like any whole-store rewrite it
+# makes the sync fall back to a full merge
+# Args: $1 - change log path, $2 - generation of the last sync
+# Returns: IDs one per line; 1 if the log cannot answer (missing, truncated
+#          past the generation, or a whole-store rewrite since then)
+changed_ids_since() {
+    local log_file="$1"
+    local since="$2"
+    
+    [[ -f "$log_file" ]] || return 1
+    
+    awk -F'\t' -v since="$since" '
+        NR == 1 && $1 > since + 1 { exit 1 }
+        $1 > since && $2 != "rescore" {
+            if ($3 == "*") exit 1
+            if (!seen[$3]++) print $3
+        }
+    ' "$log_file"
+}
+
+# Print the records of a store or archive that a sync merges
+# A file in the record-per-line layout is searched with grep for the lines of
+# those IDs, so only the records being merged are parsed
+# Args: $1 - store or archive file, $2 - file with the IDs to merge one per line
+# Returns: {"bookmarks": [...]} holding only those records
+select_sync_records() {
+    local store_file="$1"
+    local ids_file="$2"
+    
+    if [[ ! -s "$store_file" ]]; then
+        echo '{"bookmarks":[]}'
+        return
+    fi
+    if store_has_record_lines "$store_file"; then
+        # Lines are matched on their JSON-encoded ID; awk drops lines that only
+        # contain it further in. IDs hold no control characters, so escaping
+        # backslashes and quotes encodes them as tojson does
+        local keys_file="$ids_file.keys"
+        [[ -f "$keys_file" ]] \
+            || awk '{ gsub(/\\/, "&&"); gsub(/"/, "\\\""); print "\"" $0 "\"" }' "$ids_file" > "$keys_file"
+        { awk '{ print "{\"id\":" $0 }' "$keys_file" | grep -F -f - "$store_file" || true; } \
+            | awk 'FILENAME == ARGV[1] { wanted[$0] = 1; next }
+                match($0, /^\{"id":"([^"\\]|\\.)*"/) && (substr($0, 7, RLENGTH - 6) in wanted) {
+                    sub(/,$/, "")
+                    records = records (records == "" ? "" : ",") $0
+                }
+                END { print "{\"bookmarks\":[" records "]}" }
+            ' "$keys_file" -
+        return
+    fi
+    jq -c --rawfile ids "$ids_file" '
+        (reduce ($ids | split("\n")[] | select(length > 0)) as $id ({}; .[$id] = true)) as $wanted
+        | {bookmarks: [.bookmarks[]? | select($wanted[.id])]}
+    ' "$store_file"
+}
+
+# Print the common ancestors kept in a sync base file
+# Given IDs, the file is searched with grep for their lines
+# Args: $1 - base file, $2 - file with the IDs to read one per line (optional)
+# Returns: the latest record of each ID one per line, without deleted ones
+read_sync_base() {
+    local base_file="$1"
+    local ids_file="${2:-}"
+    
+    [[ -f "$base_file" ]] || return 0
+    if [[ -z "$ids_file" ]]; then
+        awk -F'\t' '{ latest[$1] = $2 } END { for (id in latest) if (latest[id] != "null") print latest[id] }' "$base_file"
+        return
+    fi
+    { awk '{ print $0 "\t" }' "$ids_file" | grep -F -f - "$base_file" || true; } \
+        | awk -F'\t' 'FILENAME == ARGV[1] { wanted[$1] = 1; next }
+            $1 in wanted { latest[$1] = $2 }
+            END { for (id in latest) if (latest[id] != "null") print latest[id] }
+        ' "$ids_file" -
+}
+
+# Replace, drop and append records of a store in the record-per-line layout
+# by ID; the other lines are copied without being parsed
+# Args: $1 - store file, $2 - file with the {"ids","after","added"} update
+# Returns: the updated store in the same layout
+splice_store_records() {
+    local store_file="$1"
+    local update_file="$2"
+    local edits_file="$update_file.edits"
+    
+    # "T<TAB>key<TAB>record" per touched ID (no record when it was deleted),
+    # then "A<TAB>key" per added ID in order; keys are JSON-encoded IDs
+    jq -r '
+        (reduce .after[] as $r ({}; .[$r.id] = $r)) as $new
+        | ((.ids[] | ["T", tojson, ($new[.] | if . == null then "" else {id} + . | tojson end)]),
+           (.added[] | ["A", tojson]))
+        | join("\t")
+    ' "$update_file" > "$edits_file" || return 1
+    
+    # Only the lines grep finds for a touched ID are looked at; the others are
+    # copied, holding back one line so the last record loses its comma. Line 0
+    # keeps the list of lines from being empty, which awk would not count as a file
+    {
+        echo 0
+        awk -F'\t' '$1 == "T" { print "{\"id\":" $2 }' "$edits_file" \
+            | { grep -n -F -f - "$store_file" || true; } | cut -d: -f1
+    } > "$edits_file.lines"
+    awk -F'\t' '
+        function hold(line) {
+            if (held) print pending
+            pending = line
+            held = 1
+        }
+        FNR == 1 { file++ }
+        file == 1 {
+            if ($1 == "T") { touched[$2] = 1; if ($3 != "") replacement[$2] = $3 }
+            else added[++count] = $2
+            next
+        }
+        file == 2 { candidate[$1] = 1; next }
+        FNR == 1 { print; next }
+        FNR in candidate && match($0, /^\{"id":"([^"\\]|\\.)*"/) {
+            key = substr($0, 7, RLENGTH - 6)
+            if (key in touched) {
+                if (key in replacement) {
+                    written[key] = 1
+                    hold(replacement[key] (/,$/ ? "," : ""))
+                }
+                next
+            }
+        }
+        $0 == "]}" {
+            for (i = 1; i <= count; i++) {
+                if (added[i] in written) continue
+                if (held && pending !~ /,$/) pending = pending ","
+                hold(replacement[added[i]])
+            }
+            if (held) { sub(/,$/, "", pending); print pending }
+            print
+            next
+        }
+        {
+            if (held) print pending
+            pending = $0
+            held = 1
+        }
+    ' "$edits_file" "$edits_file.lines" "$store_file"
+    local status=$?
+    rm -f "$edits_file" "$edits_file.lines"
+    return "$status"
+}
+
+# Apply one side of a sync to the current store by ID and commit it
+# The journal entry is written from the update instead of diffing the stores
+# Args: $1 - file with the {"ids","before","after","added","archive"} update from the merge
+# Returns: 0 on success, 1 if the store could not be written
+apply_sync_update() {
+    [[ "$STORE_LOCK_HELD" == "true" ]] || { with_store_lock apply_sync_update "$@"; return; }
+    
+    local update_file="$1"
+    local ids_json archive
+    { read -r ids_json; read -r archive; } < <(jq -c '.ids, .archive' "$update_file")
+    
+    local store_tmp="$update_file.store"
+    local status=0
+    if [[ "$archive" != "true" ]] && store_has_record_lines "$BOOKMARKS_FILE"; then
+        splice_store_records "$BOOKMARKS_FILE" "$update_file" > "$store_tmp" || status=1
+        STORE_LINES_INPUT=true
+    else
+        # Like apply_records, without indexing the whole store to find new records
+        jq -c --slurpfile update "$update_file" '
+            $update[0] as $u
+            | (reduce $u.after[] as $r ({}; .[$r.id] = $r)) as $new
+            | (reduce $u.ids[] as $i ({}; .[$i] = true)) as $touched
+            | .bookmarks = ([.bookmarks[] | if $touched[.id] then $new[.id] else . end | select(. != null)]
+                + [$u.added[] | $new[.]])' "$BOOKMARKS_FILE" > "$store_tmp" || status=1
+    fi
+    if [[ $status -ne 0 ]]; then
+        STORE_LINES_INPUT=false
+        rm -f "$store_tmp"
+        echo -e "${RED}Error: Failed to update $BOOKMARKS_FILE${NC}" >&2
+        return 1
+    fi
+    
+    JOURNAL_RECORDS_FILE="$update_file"
+    if [[ "$archive" == "true" ]]; then
+        commit_bookmarks_stream "sync" "$ids_json" < <(archive_obsolete_records < "$store_tmp") || status=1
+    else
+        commit_bookmarks_stream "sync" "$ids_json" < "$store_tmp" || status=1
+    fi
+    rm -f "$store_tmp"
+    return "$status"
+}
+
+# Merge this store with a peer store in both directions
+# Args: $1 - peer bookmarks directory or bookmarks.json file
+sync_bookmarks() {
+    local peer="${1:-}"
+    
+    if [[ -z "$peer" ]]; then
+        echo -e "${RED}Usage: $0 sync <bookmarks-dir|bookmarks.json>${NC}" >&2
+        exit 1
+    fi
+    
+    local peer_dir="" peer_file peer_log=""
+    if [[ -d "$peer" ]]; then
+        peer_dir=$(cd "$peer" && pwd)
+        peer_file="$peer_dir/bookmarks.json"
+        peer_log="$peer_dir/changes.log"
+        [[ -f "$peer_file" ]] || echo '{"bookmarks":[]}' > "$peer_file"
+    elif [[ -f "$peer" ]]; then
+        peer_dir=$(cd "$(dirname "$peer")" && pwd)
+        peer_file="$peer_dir/$(basename "$peer")"
+        [[ "$(basename "$peer_file")" == "bookmarks.json" ]] && peer_log="$peer_dir/changes.log"
+    else
+        echo -e "${RED}Error: Sync peer not found: $peer${NC}" >&2
+        exit 1
+    fi
+    
+    if [[ "$peer_file" -ef "$BOOKMARKS_FILE" ]]; then
+        echo -e "${RED}Error: Cannot sync a store with itself${NC}" >&2
+        exit 1
+    fi
+    
+    mkdir -p "$SYNC_DIR"
+    local peer_key
+    peer_key=$(hash_string "$peer_file")
+    local state_file="$SYNC_DIR/$peer_key.state"
+    local base_file="$SYNC_DIR/$peer_key.base"
+    
+    local local_signature peer_signature
+    local_signature=$(peer_store_signature "$BOOKMARKS_FILE" "$CHANGE_LOG_FILE")
+    peer_signature=$(peer_store_signature "$peer_file" "$peer_log")
+    
+    # Fast path: neither side has committed anything since the last sync
+    local saved_local="" saved_peer=""
+    if [[ -f "$state_file" && -f "$base_file" ]]; then
+        IFS=$'\t' read -r saved_local saved_peer _ < "$state_file"
+        if [[ "$saved_local" == "$local_signature" && "$saved_peer" == "$peer_signature" ]]; then
+            echo -e "${GREEN}Already in sync with ${CYAN}$peer_file${NC}"
+            return 0
+        fi
+    fi
+    
+    # Both stores stay locked from the first read to the last write, so a
+    # change committed on either side meanwhile is never overwritten
+    with_store_lock merge_peer_store "$peer_file" "$peer_log" "$state_file" "$base_file"
+}
+
+# Merge this store with a peer and commit the result on both sides
+# Runs under this store's lock (see sync_bookmarks) and takes the peer's
+# Args: $1 - peer bookmarks file, $2 - peer change log (may be empty),
+#       $3 - sync state file, $4 - sync base file
+merge_peer_store() {
+    local peer_file="$1"
+    local peer_log="$2"
+    local state_file="$3"
+    local base_file="$4"
+    local peer_dir="${peer_file%/*}"
+    
+    # Only a peer store has writers of its own to lock out; a plain file
+    # may share a directory (and so a lock) with this store
+    local peer_lock=""
+    if [[ -n "$peer_log" ]]; then
+        peer_lock="$peer_dir/.store.lock"
+        if ! try_lock "$peer_lock" 10; then
+            echo -e "${RED}Error: Timed out waiting for the lock of $peer_file${NC}" >&2
+            return 1
+        fi
+    fi
+    
+    local saved_local="" saved_peer=""
+    if [[ -f "$state_file" && -f "$base_file" ]]; then
+        IFS=$'\t' read -r saved_local saved_peer _ < "$state_file"
+    fi
+    
+    # Collect the IDs changed on either side; fall back to a full merge when
+    # there is no previous sync or a change log cannot answer
+    local full=true
+    local ids_file
+    ids_file=$(mktemp "${TMPDIR:-/tmp}/bookmark_sync_XXXXXX")
+    if [[ "$saved_local" == g* && "$saved_peer" == g* ]] \
+        && changed_ids_since "$CHANGE_LOG_FILE" "${saved_local#g}" > "$ids_file" \
+        && changed_ids_since "$peer_log" "${saved_peer#g}" >> "$ids_file"; then
+        full=false
+    fi
+    
+    # Common ancestors of the records being merged, one JSON record per line
+    local base_records="$ids_file.base"
+    if [[ "$full" == "true" ]]; then
+        read_sync_base "$base_file" > "$base_records"
+    else
+        read_sync_base "$base_file" "$ids_file" > "$base_records"
+    fi
+    
+    # A full merge reads both stores; otherwise only the records being merged
+    # are read from each side. Archived bookmarks take part in the merge, so
+    # moving one to the archive is not mistaken for a deletion
+    local peer_archive=""
+    [[ -n "$peer_log" ]] && peer_archive="$peer_dir/archive.json"
+    local local_store="$BOOKMARKS_FILE" local_archive="$ARCHIVE_FILE"
+    local peer_store="$peer_file" peer_archive_input="$peer_archive"
+    if [[ "$full" == "false" ]]; then
+        local_store="$ids_file.local"
+        local_archive="$ids_file.local_archive"
+        peer_store="$ids_file.peer"
+        peer_archive_input="$ids_file.peer_archive"
+        if ! select_sync_records "$BOOKMARKS_FILE" "$ids_file" > "$local_store" \
+            || ! select_sync_records "$ARCHIVE_FILE" "$ids_file" > "$local_archive" \
+            || ! select_sync_records "$peer_file" "$ids_file" > "$peer_store" \
+            || ! select_sync_records "$peer_archive" "$ids_file" > "$peer_archive_input"; then
+            rm -f "$ids_file" "$ids_file".*
+            echo -e "${RED}Error: Could not read $BOOKMARKS_FILE or $peer_file (invalid JSON?)${NC}" >&2
+            exit 1
+        fi
+    fi
+    [[ -s "$local_archive" ]] || local_archive=/dev/null
+    [[ -n "$peer_archive_input" && -s "$peer_archive_input" ]] || peer_archive_input=/dev/null
+    
+    # Merge the selected records. Output lines: the update for this store,
+    # the update for the peer ({"ids","before","after","added","archive"}),
+    # then one "id<TAB>record" line per merged ID (record null once deleted)
+    local result_file
+    result_file=$(mktemp "${TMPDIR:-/tmp}/bookmark_sync_XXXXXX")
+    
+    if ! jq -nrc \
+        --slurpfile local_store "$local_store" \
+        --slurpfile local_archive "$local_archive" \
+        --slurpfile peer_store "$peer_store" \
+        --slurpfile peer_archive "$peer_archive_input" \
+        --slurpfile base "$base_records" \
+        --rawfile ids "$ids_file" \
+        --argjson full "$full" \
+        --argjson peer_archives "$([[ -n "$peer_archive" ]] && echo true || echo false)" \
+        --argjson fields "$SYNC_CONTENT_FIELDS" '
+        def stamp: .modified // .created // "";
+        def unchanged_since($b): . as $rec | all($fields[]; $rec[.] == $b[.]);
+        def newest(f): [f | select(. != null)] | max;
+        # Unset fields stay absent rather than becoming null
+        def put($f; $v): if $v == null then del(.[$f]) else .[$f] = $v end;
+        def merge_one($l; $r; $b):
+            if $l == null and $r == null then null
+            elif $l == null then (if $b != null and ($r | unchanged_since($b)) then null else $r end)
+            elif $r == null then (if $b != null and ($l | unchanged_since($b)) then null else $l end)
+            elif $l == $r then $l
+            else
+                (if ($r | stamp) > ($l | stamp) then $r else $l end) as $newer
+                | reduce $fields[] as $f ($newer;
+                    if $l[$f] == $r[$f] then put($f; $l[$f])
+                    elif $b != null and $l[$f] == $b[$f] then put($f; $r[$f])
+                    elif $b != null and $r[$f] == $b[$f] then put($f; $l[$f])
+                    else . end)
+                | .access_count = (if $b != null
+                    then [($l.access_count // 0) + ($r.access_count // 0) - ($b.access_count // 0), 0] | max
+                    else [$l.access_count // 0, $r.access_count // 0] | max end)
+                | .last_accessed = newest($l.last_accessed, $r.last_accessed)
+                | .frecency_score = newest($l.frecency_score, $r.frecency_score)
+                | (if ($r.last_accessed // "") > ($l.last_accessed // "") then $r.usage else $l.usage end) as $usage
+                | if $usage != null then .usage = $usage else . end
+                | (if ($r.runs.last_run // "") > ($l.runs.last_run // "") then $r.runs else $l.runs end) as $runs
+                | if $runs != null then .runs = $runs else . end
+                | (newest($l.modified, $r.modified)) as $modified
+                | if $modified != null then .modified = $modified else . end
+            end;
+        # reduce with plain assignment stays linear; INDEX is quadratic on jq 1.6
+        def index_by_id: reduce .[] as $rec ({}; .[$rec.id] = $rec);
+        # The records one side must replace by ID; deleted records are left out
+        # of "after" and records the store lacks are listed in "added". The
+        # archive needs a pass when a changed record is only in the archive or
+        # is now obsolete
+        def side_update($stored; $archived; $archives; $keys; $merged):
+            ($archived + $stored) as $index
+            | [$keys[] | select($merged[.] != $index[.])] as $changed
+            | {ids: $changed,
+               before: [$changed[] | $index[.] | select(. != null)],
+               after: [$changed[] | $merged[.] | select(. != null)],
+               added: [$changed[] | select($merged[.] != null and $stored[.] == null)],
+               archive: ($archives and any($changed[];
+                    ($stored[.] == null and $archived[.] != null)
+                    or ($merged[.] | . != null and .status == "obsolete" and .overlay == null)))};
+        def records_of($file): $file[0].bookmarks // [] | index_by_id;
+        
+        records_of($local_store) as $Ls | records_of($local_archive) as $La
+        | records_of($peer_store) as $Rs | records_of($peer_archive) as $Ra
+        | ($La + $Ls) as $Li | ($Ra + $Rs) as $Ri
+        | ($base | index_by_id) as $B
+        | (if $full then ($Li + $Ri | keys)
+           else $ids | split("\n") | map(select(length > 0)) | unique end) as $keys
+        | (reduce $keys[] as $k ({}; .[$k] = merge_one($Li[$k]; $Ri[$k]; $B[$k]))) as $merged
+        | side_update($Ls; $La; true; $keys; $merged),
+          side_update($Rs; $Ra; $peer_archives; $keys; $merged),
+          ($merged | to_entries[] | "\(.key)\t\(.value | tojson)")
+    ' > "$result_file"; then
+        rm -f "$ids_file" "$ids_file".* "$result_file"
+        echo -e "${RED}Error: Could not merge $BOOKMARKS_FILE with $peer_file (invalid JSON?)${NC}" >&2
+        exit 1
+    fi
+    rm -f "$ids_file" "$ids_file".*
+    
+    local local_changed peer_changed local_count peer_count
+    sed -n 1p "$result_file" > "$result_file.local"
+    sed -n 2p "$result_file" > "$result_file.peer"
+    local local_before local_after
+    { read -r local_count; read -r local_changed; read -r local_before; read -r local_after;
+      read -r peer_count; read -r peer_changed; } \
+        < <(jq -c '(.ids | length), .ids, .before, .after' "$result_file.local" "$result_file.peer")
+    
+    if [[ "$local_changed" != "[]" ]]; then
+        # Hook events get the before/after records straight from the merge
+        MUTATION_OP="sync"
+        MUTATION_IDS="$local_changed"
+        MUTATION_BEFORE="$local_before"
+        MUTATION_AFTER="$local_after"
+        apply_sync_update "$result_file.local"
+    fi
+    
+    if [[ "$peer_changed" != "[]" ]]; then
+        # Commit to the peer with its own generation counter, change log and lock
+        (
+            BOOKMARKS_DIR="$peer_dir"
+            BOOKMARKS_FILE="$peer_file"
+            ARCHIVE_FILE="${peer_archive:-/dev/null}"
+            CHANGE_LOG_FILE="${peer_log:-/dev/null}"
+            JOURNAL_FILE="${peer_log:+$peer_dir/journal.jsonl}"
+            JOURNAL_FILE="${JOURNAL_FILE:-/dev/null}"
+            STORE_GENERATION=""
+            BOOKMARK_LAYERS=()
+            apply_sync_update "$result_file.peer"
+        )
+    fi
+    
+    # Remember the merged records as the common ancestor for the next sync
+    local base_tmp="$base_file.tmp.$$"
+    if [[ "$full" == "true" ]]; then
+        tail -n +3 "$result_file" | awk -F'\t' '$2 != "null"' > "$base_tmp"
+        mv "$base_tmp" "$base_file"
+    else
+        tail -n +3 "$result_file" >> "$base_file"
+        if (( $(wc -c < "$base_file") > 2 * $(wc -c < "$BOOKMARKS_FILE") + 65536 )); then
+            awk -F'\t' '{ latest[$1] = $2 } END { for (id in latest) if (latest[id] != "null") print id "\t" latest[id] }' \
+                "$base_file" > "$base_tmp"
+            mv "$base_tmp" "$base_file"
+        fi
+    fi
+    
+    printf '%s\t%s\t%s\n' \
+        "$(peer_store_signature "$BOOKMARKS_FILE" "$CHANGE_LOG_FILE")" \
+        "$(peer_store_signature "$peer_file" "$peer_log")" \
+        "$peer_file" > "$state_file"
+    rm -f "$result_file" "$result_file.local" "$result_file.peer"
+    [[ -z "$peer_lock" ]] || release_lock "$peer_lock"
+    
+    echo -e "${GREEN}Synced with ${CYAN}$peer_file${NC}: $local_count updated here, $peer_count updated there"
+}
+
 #=============================================================================
 # BOOKMARK MANAGEMENT FUNCTIONS
 #=============================================================================
@@ -526,12 +2487,27 @@ validate_bookmark_input() {
     # Validate type or get user confirmation for custom types
     if ! is_valid_type "$type"; then
         echo -e "${RED}Error: Invalid bookmark type: $type${NC}" >&2
-        echo -e "Valid types: ${CYAN}${VALID_TYPES[*]}${NC}" >&2
+        echo -e "Valid types: ${CYAN}$(list_valid_types)${NC}" >&2
         
         if ! get_user_confirmation "Do you want to continue with a custom type? (y/n): "; then
             exit 1
         fi
     fi
+    
+    # Workflow steps must name existing bookmarks and form a DAG
+    if [[ "$type" == "workflow" ]] && ! resolve_workflow_steps "$command" > /dev/null; then
+        exit 1
+    fi
+    
+    # Let a registered handler reject commands it cannot run
+    if has_type_handler "$type"; then
+        local validate_status=0
+        run_type_handler "$type" validate "$command" "$description" || validate_status=$?
+        if [[ "$validate_status" -ne 0 ]] && [[ "$validate_status" -ne 127 ]]; then
+            echo -e "${RED}Error: Command rejected by the '$type' type handler.${NC}" >&2
+            exit 1
+        fi
+    fi
 }
 
 # Create bookmark JSON entry
@@ -560,11 +2536,26 @@ create_bookmark_entry() {
         '{id: $id, description: $desc, type: $type, command: $cmd, tags: $tags, notes: $notes, created: $created, status: "active", access_count: 0, last_accessed: null, frecency_score: 0}'
 }
 
+# Record the records affected by a mutation before it is written
+# Captures before/after copies so hooks do not need to re-read the store
+# Args: $1 - operation name, $2 - JSON array of affected IDs, $3 - updated bookmarks JSON
+record_mutation() {
+    local ids="$2"
+    MUTATION_OP="$1"
+    MUTATION_IDS="$ids"
+    MUTATION_BEFORE=$(jq -c --argjson ids "$ids" '[.bookmarks[] | select(.id | IN($ids[]))]' "$BOOKMARKS_FILE")
+    MUTATION_AFTER=$(printf '%s' "$3" | jq -c --argjson ids "$ids" '[.bookmarks[] | select(.id | IN($ids[]))]')
+}
+
 # Internal function to update bookmark fields in JSON file
+# Reads, changes and commits the store under one hold of the store lock
 # Args: $1 - identifier (id or description), $2 - identifier type ("id" or "desc"),
-#       $3 - new description, $4 - new type, $5 - new command, $6 - new tags, $7 - new notes
+#       $3 - new description, $4 - new type, $5 - new command, $6 - new tags, $7 - new notes,
+#       $8 - operation name recorded for hooks (default "update")
 # Returns: Updates the bookmarks file and returns 0 on success
 _update_bookmark_fields() {
+    [[ "$STORE_LOCK_HELD" == "true" ]] || { with_store_lock _update_bookmark_fields "$@"; return; }
+    
     local identifier="$1"
     local identifier_type="$2"
     local new_description="$3"
@@ -572,6 +2563,11 @@ _update_bookmark_fields() {
     local new_command="$5"
     local new_tags="$6"
     local new_notes="$7"
+    local operation="${8:-update}"
+    
+    # Archived bookmarks are edited in the store; shared ones through a personal copy
+    ensure_hot_record "$identifier"
+    ensure_overlay_record "$identifier" "edit"
     
     # Update the bookmark with timestamp
     local modified
@@ -587,7 +2583,7 @@ _update_bookmark_fields() {
             --arg tags "$new_tags" \
             --arg notes "$new_notes" \
             --arg modified "$modified" \
-            '.bookmarks = [.bookmarks[] | if .id == $id then .description = $desc | .type = $type | .command = $cmd | .tags = $tags | .notes = $notes | .modified = $modified else . end]' "$BOOKMARKS_FILE")
+            '.bookmarks = [.bookmarks[] | if .id == $id then .description = $desc | .type = $type | .command = $cmd | .tags = $tags | .notes = $notes | .modified = $modified else . end]' "$BOOKMARKS_FILE") || return 1
     else
         # Update by description
         updated_json=$(jq --arg desc "$identifier" \
@@ -597,10 +2593,23 @@ _update_bookmark_fields() {
             --arg tags "$new_tags" \
             --arg notes "$new_notes" \
             --arg modified "$modified" \
-            '.bookmarks = [.bookmarks[] | if .description == $desc then .description = $new_desc | .type = $type | .command = $cmd | .tags = $tags | .notes = $notes | .modified = $modified else . end]' "$BOOKMARKS_FILE")
+            '.bookmarks = [.bookmarks[] | if .description == $desc then .description = $new_desc | .type = $type | .command = $cmd | .tags = $tags | .notes = $notes | .modified = $modified else . end]' "$BOOKMARKS_FILE") || return 1
     fi
     
-    echo "$updated_json" > "$BOOKMARKS_FILE"
+    local ids
+    if [[ "$identifier_type" == "id" ]]; then
+        ids=$(jq -nc --arg id "$identifier" '[$id]')
+    else
+        ids=$(jq -c --arg desc "$identifier" '[.bookmarks[] | select(.description == $desc) | .id]' "$BOOKMARKS_FILE")
+    fi
+    record_mutation "$operation" "$ids" "$updated_json"
+    
+    # Edited obsolete bookmarks go back to the archive
+    if [[ -s "$ARCHIVE_FILE" ]]; then
+        updated_json=$(archive_obsolete_records <<< "$updated_json") || return 1
+    fi
+    
+    commit_bookmarks_json "$updated_json" "$operation" "$ids"
 }
 
 # Add a new bookmark with improved validation and modularity
@@ -634,14 +2643,23 @@ add_bookmark() {
     # Create and add the bookmark
     local entry
     entry=$(create_bookmark_entry "$description" "$type" "$command" "$tags" "$notes")
-    
-    local updated_json
-    updated_json=$(jq --argjson entry "$entry" '.bookmarks += [$entry]' "$BOOKMARKS_FILE")
-    echo "$updated_json" > "$BOOKMARKS_FILE"
+    insert_bookmark_entry "$entry"
     
     echo -e "${GREEN}Bookmark added: ${CYAN}$description${NC}"
 }
 
+# Append a new bookmark to the store under the store lock
+# Args: $1 - bookmark JSON from create_bookmark_entry
+insert_bookmark_entry() {
+    [[ "$STORE_LOCK_HELD" == "true" ]] || { with_store_lock insert_bookmark_entry "$@"; return; }
+    
+    local entry="$1"
+    local updated_json
+    updated_json=$(jq --argjson entry "$entry" '.bookmarks += [$entry]' "$BOOKMARKS_FILE") || return 1
+    record_mutation "add" "$(echo "$entry" | jq -c '[.id]')" "$updated_json"
+    commit_bookmarks_json "$updated_json" "$MUTATION_OP" "$MUTATION_IDS"
+}
+
 # Interactive bookmark creation with improved user experience
 # Prompts user for all bookmark fields with validation
 interactive_add_bookmark() {
@@ -658,7 +2676,7 @@ interactive_add_bookmark() {
     done
     
     # Get type with validation
-    echo -e "${CYAN}Valid types: ${VALID_TYPES[*]}${NC}"
+    echo -e "${CYAN}Valid types: $(list_valid_types)${NC}"
     local type
     while [[ -z "${type:-}" ]]; do
         read -p "Type: " type
@@ -670,7 +2688,7 @@ interactive_add_bookmark() {
         # Validate type or confirm custom type
         if ! is_valid_type "$type"; then
             echo -e "${YELLOW}Warning: '$type' is not in the list of standard types.${NC}"
-            echo -e "Standard types: ${CYAN}${VALID_TYPES[*]}${NC}"
+            echo -e "Standard types: ${CYAN}$(list_valid_types)${NC}"
             
             if ! get_user_confirmation "Do you want to continue with this custom type? (y/n): "; then
                 echo -e "${YELLOW}Operation cancelled.${NC}"
@@ -714,7 +2732,7 @@ format_bookmark_for_editor() {
     cat <<EOF
 # description
 $description
-# type (allowed: ${VALID_TYPES[*]})
+# type (allowed: $(list_valid_types))
 $type
 # command
 $command
@@ -839,14 +2857,10 @@ edit_bookmark() {
     # Write formatted bookmark to temp file
     format_bookmark_for_editor "$description" "$type" "$command" "$tags" "$notes" > "$tmpfile"
     
-    # Get editor command using pure function
-    local editor
-    editor=$(detect_editor)
-    
     echo -e "${BLUE}Opening editor to edit bookmark: ${CYAN}$description${NC}"
     
-    # Open editor
-    if ! "$editor" "$tmpfile"; then
+    # Open editor (a running editor server is reused)
+    if ! edit_file_and_wait "$tmpfile"; then
         echo -e "${RED}Editor exited with error${NC}" >&2
         rm -f "$tmpfile"
         exit 1
@@ -877,7 +2891,7 @@ edit_bookmark() {
     # Validate type
     if ! is_valid_type "$new_type"; then
         echo -e "${YELLOW}Warning: '$new_type' is not in the list of standard types.${NC}"
-        echo -e "Standard types: ${CYAN}${VALID_TYPES[*]}${NC}"
+        echo -e "Standard types: ${CYAN}$(list_valid_types)${NC}"
         
         if ! get_user_confirmation "Do you want to continue with this custom type? (y/n): "; then
             echo -e "${YELLOW}Operation cancelled.${NC}"
@@ -886,7 +2900,7 @@ edit_bookmark() {
     fi
     
     # Update the bookmark using internal function
-    _update_bookmark_fields "$id" "id" "$new_description" "$new_type" "$new_command" "$new_tags" "$new_notes"
+    _update_bookmark_fields "$id" "id" "$new_description" "$new_type" "$new_command" "$new_tags" "$new_notes" "edit"
     echo -e "${GREEN}Bookmark updated: ${CYAN}$new_description${NC}"
 }
 
@@ -927,14 +2941,10 @@ modify_add_bookmark() {
     # Write formatted bookmark to temp file
     format_bookmark_for_editor "$description" "$type" "$command" "$tags" "$notes" > "$tmpfile"
     
-    # Get editor command using pure function
-    local editor
-    editor=$(detect_editor)
-    
     echo -e "${BLUE}Opening editor to create new bookmark based on: ${CYAN}$description${NC}"
     
-    # Open editor
-    if ! "$editor" "$tmpfile"; then
+    # Open editor (a running editor server is reused)
+    if ! edit_file_and_wait "$tmpfile"; then
         echo -e "${RED}Editor exited with error${NC}" >&2
         rm -f "$tmpfile"
         exit 1
@@ -986,7 +2996,7 @@ modify_add_bookmark() {
     # Validate type
     if ! is_valid_type "$new_type"; then
         echo -e "${YELLOW}Warning: '$new_type' is not in the list of standard types.${NC}"
-        echo -e "Standard types: ${CYAN}${VALID_TYPES[*]}${NC}"
+        echo -e "Standard types: ${CYAN}$(list_valid_types)${NC}"
         
         if ! get_user_confirmation "Do you want to continue with this custom type? (y/n): "; then
             echo -e "${YELLOW}Operation cancelled.${NC}"
@@ -997,10 +3007,7 @@ modify_add_bookmark() {
     # Create and add the new bookmark
     local entry
     entry=$(create_bookmark_entry "$new_description" "$new_type" "$new_command" "$new_tags" "$new_notes")
-    
-    local updated_json
-    updated_json=$(jq --argjson entry "$entry" '.bookmarks += [$entry]' "$BOOKMARKS_FILE")
-    echo "$updated_json" > "$BOOKMARKS_FILE"
+    insert_bookmark_entry "$entry"
     
     echo -e "${GREEN}New bookmark created: ${CYAN}$new_description${NC}"
 }
@@ -1021,12 +3028,13 @@ format_bookmarks_for_display() {
     # Single jq call to get all necessary data, sort by frecency, and format it
     # Filter obsolete bookmarks unless explicitly included
     if [[ "$include_obsolete" == "true" ]]; then
-        jq -r '.bookmarks | sort_by(-.frecency_score // 0) | .[] | 
+        merge_archive_json "$BOOKMARKS_VIEW_FILE" "$ARCHIVE_FILE" | \
+        jq -r "${RANKING_JQ_ARGS[@]}" "$RANKING_JQ_DEFS"'.bookmarks | sort_by(-rank_score) | .[] | 
             (if .status == "obsolete" then "[OBSOLETE] " else "" end) + 
             "[" + .type + "] " + .description + 
             "|" + .id + 
             "|" + .command + 
-            "|" + .status' "$BOOKMARKS_FILE" | \
+            "|" + .status' | \
         while IFS="|" read -r display_line id command status; do
             if [[ "$status" == "obsolete" ]]; then
                 echo -e "${RED}$display_line${NC}"
@@ -1043,11 +3051,11 @@ format_bookmarks_for_display() {
         done
     else
         # Filter out obsolete bookmarks
-        jq -r '.bookmarks | sort_by(-.frecency_score // 0) | .[] | select(.status != "obsolete") | 
+        jq -r "${RANKING_JQ_ARGS[@]}" "$RANKING_JQ_DEFS"'.bookmarks | sort_by(-rank_score) | .[] | select(.status != "obsolete") | 
             "[" + .type + "] " + .description + 
             "|" + .id + 
             "|" + .command + 
-            "|" + .status' "$BOOKMARKS_FILE" | \
+            "|" + .status' "$BOOKMARKS_VIEW_FILE" | \
         while IFS="|" read -r display_line id command status; do
             # Extract type and description for coloring
             if [[ "$display_line" =~ ^\[([^\]]+)\]\ (.*)$ ]]; then
@@ -1087,7 +3095,7 @@ select_bookmark_with_fzf() {
     
     # Use fzf for interactive selection
     local selected
-    selected=$(echo "$formatted_bookmarks" | fzf --ansi --border --prompt="$prompt: ")
+    selected=$(fzf_select_ranked "$formatted_bookmarks" --ansi --border --tiebreak=index --prompt="$prompt: ")
     
     if [[ -z "$selected" ]]; then
         return 1
@@ -1113,9 +3121,9 @@ update_bookmark() {
     # Validate input parameters
     validate_bookmark_input "$description" "$type" "$command"
     
-    # Check bookmark existence and uniqueness
+    # Check bookmark existence and uniqueness (archived bookmarks included)
     local count
-    count=$(jq --arg desc "$description" '.bookmarks | map(select(.description == $desc)) | length' "$BOOKMARKS_FILE")
+    count=$(get_bookmark_by_id_or_desc "$description" | jq -s 'length')
     
     if [[ "$count" -eq 0 ]]; then
         echo -e "${RED}No bookmark found with description: $description${NC}" >&2
@@ -1131,6 +3139,126 @@ update_bookmark() {
     echo -e "${GREEN}Bookmark updated: ${CYAN}$description${NC}"
 }
 
+# Optional per-bookmark settings that `set` can change
+readonly BOOKMARK_SETTINGS="cache_ttl on_failure host_group"
+
+# Set or clear an optional bookmark setting
+# Args: $1 - ID or description, $2 - setting name, $3 - value ("off" clears it)
+set_bookmark_setting() {
+    local id_or_desc="$1"
+    local setting="$2"
+    local value="${3:-}"
+    
+    if [[ -z "$id_or_desc" || -z "$setting" || -z "$value" ]]; then
+        echo -e "${RED}Usage: $0 set \"Description or ID\" <setting> <value|off> (settings: $BOOKMARK_SETTINGS)${NC}" >&2
+        exit 1
+    fi
+    
+    # value_json is null when the setting is cleared
+    local value_json
+    case "$setting" in
+        cache_ttl)
+            if [[ "$value" == "off" || "$value" == "0" ]]; then
+                value_json="null"
+            elif [[ "$value" =~ ^[0-9]+$ ]]; then
+                value_json="$value"
+            else
+                echo -e "${RED}Error: cache_ttl expects a number of seconds or 'off'${NC}" >&2
+                exit 1
+            fi
+            ;;
+        on_failure)
+            if [[ "$value" == "off" || "$value" == "stop" ]]; then
+                value_json="null"
+            elif [[ "$value" == "continue" ]]; then
+                value_json='"continue"'
+            else
+                echo -e "${RED}Error: on_failure expects 'stop' or 'continue'${NC}" >&2
+                exit 1
+            fi
+            ;;
+        host_group)
+            if [[ "$value" == "off" ]]; then
+                value_json="null"
+            elif get_host_group "$value" > /dev/null; then
+                value_json=$(jq -n --arg group "$value" '$group')
+            else
+                echo -e "${RED}Error: No host group named $value (see '$0 hosts')${NC}" >&2
+                exit 1
+            fi
+            ;;
+        *)
+            echo -e "${RED}Error: Unknown setting: $setting (settings: $BOOKMARK_SETTINGS)${NC}" >&2
+            exit 1
+            ;;
+    esac
+    
+    validate_bookmarks_file || exit 1
+    
+    local matches count
+    matches=$(get_bookmark_by_id_or_desc "$id_or_desc")
+    count=$(jq -s 'length' <<< "$matches")
+    if [[ "$count" -eq 0 ]]; then
+        echo -e "${RED}No bookmark found with ID or description: $id_or_desc${NC}" >&2
+        exit 1
+    elif [[ "$count" -gt 1 ]]; then
+        echo -e "${RED}Multiple bookmarks found with description: $id_or_desc${NC}" >&2
+        echo -e "Please use the bookmark ID instead.${NC}" >&2
+        exit 1
+    fi
+    
+    local id description type
+    IFS=$'\t' read -r id description type < <(jq -r '[.id, .description, .type] | @tsv' <<< "$matches")
+    
+    # A host group fans out cmd and ssh bookmarks, which name the host as {host}
+    if [[ "$setting" == "host_group" && "$value_json" != "null" ]]; then
+        if [[ "$type" != "cmd" && "$type" != "ssh" ]]; then
+            echo -e "${RED}Error: Only cmd and ssh bookmarks can run on a host group${NC}" >&2
+            exit 1
+        elif ! jq -e '.command | contains("{host}")' <<< "$matches" > /dev/null; then
+            echo -e "${RED}Error: The command must contain {host} to run on a host group${NC}" >&2
+            exit 1
+        fi
+    fi
+    
+    write_bookmark_setting "$id" "$setting" "$value_json"
+    
+    if [[ "$value_json" == "null" ]]; then
+        echo -e "${GREEN}Cleared $setting: ${CYAN}$description${NC}"
+    else
+        echo -e "${GREEN}Set $setting to $value: ${CYAN}$description${NC}"
+    fi
+}
+
+# Change one setting of a bookmark under the store lock
+# Args: $1 - bookmark ID, $2 - setting name, $3 - JSON value (null clears it)
+write_bookmark_setting() {
+    [[ "$STORE_LOCK_HELD" == "true" ]] || { with_store_lock write_bookmark_setting "$@"; return; }
+    
+    local id="$1"
+    local setting="$2"
+    local value_json="$3"
+    
+    # Archived bookmarks are changed in the store; shared ones through a personal copy
+    ensure_hot_record "$id"
+    ensure_overlay_record "$id" "edit"
+    
+    local updated_json
+    updated_json=$(jq --arg id "$id" --arg setting "$setting" --argjson value "$value_json" \
+        --arg modified "$(date +"%Y-%m-%d %H:%M:%S")" '
+        .bookmarks |= map(if .id == $id
+            then (if $value == null then del(.[$setting]) else .[$setting] = $value end)
+                 | .modified = $modified
+            else . end)
+    ' "$BOOKMARKS_FILE") || return 1
+    
+    record_mutation "update" "$(jq -nc --arg id "$id" '[$id]')" "$updated_json"
+    if [[ -s "$ARCHIVE_FILE" ]]; then
+        updated_json=$(archive_obsolete_records <<< "$updated_json") || return 1
+    fi
+    commit_bookmarks_json "$updated_json" "$MUTATION_OP" "$MUTATION_IDS"
+}
+
 # Delete a bookmark with improved confirmation and error handling
 # Args: $1 - ID or description (optional, uses fzf if not provided)
 delete_bookmark() {
@@ -1157,30 +3285,59 @@ delete_bookmark() {
         exit 1
     fi
     
+    # Shared layers are read-only
+    local shared_record
+    shared_record=$(get_shared_only_bookmark "$id_or_desc")
+    if [[ -n "$shared_record" ]]; then
+        echo -e "${RED}Error: '$id_or_desc' belongs to the shared layer $(echo "$shared_record" | jq -r '.layer') and cannot be deleted.${NC}" >&2
+        echo -e "Use 'obsolete' to hide it from your own listings instead." >&2
+        exit 1
+    fi
+    
     # Extract description for confirmation
-    local description
+    local description base_layer
     description=$(echo "$bookmark" | jq -r '.description')
+    base_layer=$(echo "$bookmark" | jq -r '.base_layer // empty')
     
     echo -e "${YELLOW}You are about to delete the bookmark: ${CYAN}$description${NC}"
     
     if get_user_confirmation "Are you sure? (y/n): "; then
-        # Delete the bookmark (determine method based on ID format)
-        local updated_json
-        if [[ "$id_or_desc" =~ ^[0-9]{10,}_[a-zA-Z0-9]{6}$ ]]; then
-            # Delete by ID
-            updated_json=$(jq --arg id "$id_or_desc" '.bookmarks = [.bookmarks[] | select(.id != $id)]' "$BOOKMARKS_FILE")
+        remove_bookmark_records "$id_or_desc" "$(echo "$bookmark" | jq -sc 'map(.id)')"
+        if [[ -n "$base_layer" ]]; then
+            echo -e "${GREEN}Personal changes removed; shared bookmark from ${CYAN}$base_layer${GREEN} is used again${NC}"
         else
-            # Delete by description
-            updated_json=$(jq --arg desc "$id_or_desc" '.bookmarks = [.bookmarks[] | select(.description != $desc)]' "$BOOKMARKS_FILE")
+            echo -e "${GREEN}Bookmark deleted: ${CYAN}$description${NC}"
         fi
-        
-        echo "$updated_json" > "$BOOKMARKS_FILE"
-        echo -e "${GREEN}Bookmark deleted: ${CYAN}$description${NC}"
     else
         echo -e "${YELLOW}Deletion cancelled.${NC}"
     fi
 }
 
+# Remove bookmarks from the store under the store lock
+# Args: $1 - ID or description, $2 - JSON array of the IDs being removed
+remove_bookmark_records() {
+    [[ "$STORE_LOCK_HELD" == "true" ]] || { with_store_lock remove_bookmark_records "$@"; return; }
+    
+    local id_or_desc="$1"
+    local ids_json="$2"
+    
+    # Deleting from the store keeps the record in the journal for undo
+    ensure_hot_record "$id_or_desc"
+    
+    # Delete the bookmark (determine method based on ID format)
+    local updated_json
+    if [[ "$id_or_desc" =~ ^[0-9]{10,}_[a-zA-Z0-9]{6}$ ]]; then
+        # Delete by ID
+        updated_json=$(jq --arg id "$id_or_desc" '.bookmarks = [.bookmarks[] | select(.id != $id)]' "$BOOKMARKS_FILE") || return 1
+    else
+        # Delete by description
+        updated_json=$(jq --arg desc "$id_or_desc" '.bookmarks = [.bookmarks[] | select(.description != $desc)]' "$BOOKMARKS_FILE") || return 1
+    fi
+    
+    record_mutation "delete" "$ids_json" "$updated_json"
+    commit_bookmarks_json "$updated_json" "$MUTATION_OP" "$MUTATION_IDS"
+}
+
 # Toggle bookmark obsolete status with improved logic
 # Args: $1 - ID or description (optional, uses fzf if not provided)
 obsolete_bookmark() {
@@ -1236,27 +3393,66 @@ obsolete_bookmark() {
         fi
     fi
     
+    write_bookmark_status "$id_or_desc" "$new_status" "$(echo "$bookmark" | jq -sc 'map(.id)')"
+    echo -e "${GREEN}Bookmark $message: ${CYAN}$description${NC}"
+}
+
+# Set the status of bookmarks under the store lock
+# Args: $1 - ID or description, $2 - new status, $3 - JSON array of the IDs changed
+write_bookmark_status() {
+    [[ "$STORE_LOCK_HELD" == "true" ]] || { with_store_lock write_bookmark_status "$@"; return; }
+    
+    local id_or_desc="$1"
+    local new_status="$2"
+    local ids_json="$3"
+    
+    ensure_hot_record "$id_or_desc"
+    ensure_overlay_record "$id_or_desc" "edit"
+    
     # Update the bookmark status
     local updated_json
     if [[ "$id_or_desc" =~ ^[0-9]{10,}_[a-zA-Z0-9]{6}$ ]]; then
         # Update by ID
         updated_json=$(jq --arg id "$id_or_desc" --arg status "$new_status" \
-            '.bookmarks = [.bookmarks[] | if .id == $id then .status = $status else . end]' "$BOOKMARKS_FILE")
+            '.bookmarks = [.bookmarks[] | if .id == $id then .status = $status else . end]' "$BOOKMARKS_FILE") || return 1
     else
         # Update by description
         updated_json=$(jq --arg desc "$id_or_desc" --arg status "$new_status" \
-            '.bookmarks = [.bookmarks[] | if .description == $desc then .status = $status else . end]' "$BOOKMARKS_FILE")
+            '.bookmarks = [.bookmarks[] | if .description == $desc then .status = $status else . end]' "$BOOKMARKS_FILE") || return 1
     fi
     
-    echo "$updated_json" > "$BOOKMARKS_FILE"
-    echo -e "${GREEN}Bookmark $message: ${CYAN}$description${NC}"
+    local operation="obsolete"
+    [[ "$new_status" == "active" ]] && operation="restore"
+    record_mutation "$operation" "$ids_json" "$updated_json"
+    
+    # Obsolete records move to the archive so listings no longer parse them
+    if [[ "$new_status" == "obsolete" ]]; then
+        updated_json=$(archive_obsolete_records <<< "$updated_json") || return 1
+    fi
+    commit_bookmarks_json "$updated_json" "$MUTATION_OP" "$MUTATION_IDS"
 }
 
 # Execute a bookmark command based on its type
+# Args: $1 - type, $2 - command, $3 - description,
+#       $4 - output cache entry for cmd and script bookmarks with a cache_ttl (optional),
+#       $5 - host group a cmd or ssh bookmark fans out across (optional),
+#       $6 - bookmark ID, which workflows read their settings by
 execute_bookmark_by_type() {
     local type="$1"
     local command="$2"
     local description="$3"
+    local cache_entry="${4:-}"
+    local host_group="${5:-}"
+    local id="${6:-}"
+    
+    # Registered type handlers take precedence; only this type's handler is loaded
+    if has_type_handler "$type"; then
+        local handler_status=0
+        run_type_handler "$type" exec "$command" "$description" || handler_status=$?
+        if [[ "$handler_status" -ne 127 ]]; then
+            return "$handler_status"
+        fi
+    fi
     
     # Use pure function to detect system opener
     local open_cmd
@@ -1264,8 +3460,11 @@ execute_bookmark_by_type() {
     
     case "$type" in
         url|folder|file)
-            # Use system's default opener for these types
-            if [ -n "$open_cmd" ]; then
+            # Use system's default opener for these types, or BOOKMARKS_BROWSER for URLs
+            if [[ "$type" == "url" && -n "${BOOKMARKS_BROWSER:-}" ]]; then
+                echo -e "${GREEN}Opening with $BOOKMARKS_BROWSER: ${CYAN}$description${NC}"
+                eval "$BOOKMARKS_BROWSER $command & disown"
+            elif [ -n "$open_cmd" ]; then
                 echo -e "${GREEN}Opening with $open_cmd: ${CYAN}$description${NC}"
                 eval "$open_cmd $command & disown"
             else
@@ -1304,57 +3503,391 @@ execute_bookmark_by_type() {
             fi
             ;;
         edit)
-            # For edit type, use pure function to detect editor
+            # A running editor server opens the file without blocking;
+            # otherwise start the editor
+            edit_in_editor_server open "$command" && return 0
             local editor
             editor=$(detect_editor)
             echo -e "${GREEN}Opening with $editor: ${CYAN}$description${NC}"
             eval "$editor $command"
             ;;
-        script|ssh|app|cmd|custom|*)
-            # Direct execution for scripts, SSH connections, apps, commands, and custom types
+        script|cmd)
+            # Scripts and commands are timed for the run statistics and may
+            # have their output cached
+            if [[ -n "$host_group" && "$type" == "cmd" ]]; then
+                run_on_host_group "$command" "$description" "$host_group"
+            else
+                run_with_telemetry "$command" "$description" "$cache_entry"
+            fi
+            ;;
+        ssh)
+            # Reuse a pooled master connection to the target when there is one
+            command=$(ssh_pooled_command "$command")
+            if [[ -n "$host_group" ]]; then
+                run_on_host_group "$command" "$description" "$host_group"
+            else
+                run_with_telemetry "$command" "$description"
+            fi
+            ;;
+        workflow)
+            run_workflow "$command" "$id"
+            ;;
+        app|custom|*)
+            # Direct execution for apps and custom types
             eval "$command"
             ;;
     esac
 }
 
-#=============================================================================
-# BOOKMARK LISTING AND EXECUTION FUNCTIONS
-#=============================================================================
-
-# Execute a bookmark after validating its status
-# Args: $1 - bookmark JSON object, $2 - description
-execute_selected_bookmark() {
-    local bookmark="$1"
-    local description="$2"
+#=============================================================================
+# BOOKMARK LISTING AND EXECUTION FUNCTIONS
+#=============================================================================
+
+# Execute a bookmark after validating its status
+# Args: $1 - bookmark JSON object, $2 - description
+execute_selected_bookmark() {
+    local bookmark="$1"
+    local description="$2"
+    
+    # Extract command, type, status and output cache settings efficiently
+    local bookmark_data
+    bookmark_data=$(echo "$bookmark" | jq -r '[.command, .type, .status, .id, .cache_ttl // 0, .host_group // ""] | @tsv')
+    IFS=$'\t' read -r command type status id cache_ttl host_group <<< "$bookmark_data"
+    
+    # Check if bookmark is obsolete
+    if [[ "$status" == "obsolete" ]]; then
+        echo -e "${YELLOW}Warning: This bookmark is marked as obsolete.${NC}"
+        
+        if ! get_user_confirmation "Do you still want to execute it? (y/n): "; then
+            return
+        fi
+    fi
+    
+    echo -e "${GREEN}Executing: ${CYAN}$description${NC}"
+    echo -e "${BLUE}Type: ${NC}$type"
+    echo -e "${BLUE}Command: ${NC}$command"
+    
+    local ids_json
+    ids_json=$(jq -nc --arg id "$id" '[$id]')
+    
+    # Fresh cached output is replayed instead of running the command again
+    local cache_entry=""
+    if [[ "$cache_ttl" -gt 0 && -z "$host_group" && ( "$type" == "cmd" || "$type" == "script" ) ]]; then
+        cache_entry=$(output_cache_entry "$id" "$command")
+        if replay_cached_output "$cache_entry" "$cache_ttl"; then
+            update_bookmarks_access "$ids_json"
+            return 0
+        fi
+    fi
+    
+    # Untimed types count the access before they start
+    case "$type" in
+        script|cmd|ssh|workflow) ;;
+        *)
+            update_bookmarks_access "$ids_json"
+            execute_bookmark_by_type "$type" "$command" "$description" "$cache_entry" "$host_group" "$id"
+            return
+            ;;
+    esac
+    
+    # Timed types are measured first, then the access and the run go into one
+    # commit. The subshell keeps errexit working inside the run and hands back
+    # its exit status
+    local run_file exit_status
+    run_file=$(mktemp)
+    set +e
+    (
+        TELEMETRY_RESULT_FILE="$run_file"
+        execute_bookmark_by_type "$type" "$command" "$description" "$cache_entry" "$host_group" "$id"
+    )
+    exit_status=$?
+    set -e
+    
+    local run runs_json="{}"
+    run=$(< "$run_file")
+    rm -f "$run_file"
+    if [[ -n "$run" ]]; then
+        runs_json=$(jq -nc --arg id "$id" --argjson ms "${run%%$'\t'*}" --argjson status "${run##*$'\t'}" \
+            '{($id): {ms: $ms, status: $status}}')
+    fi
+    update_bookmarks_access "$ids_json" "$runs_json" \
+        || echo -e "${YELLOW}Warning: Could not record run statistics${NC}" >&2
+    return "$exit_status"
+}
+
+# Prefix every line of the input
+# Args: $1 - prefix
+prefix_lines() {
+    local prefix="$1" line
+    while IFS= read -r line || [[ -n "$line" ]]; do
+        printf '%b %s\n' "$prefix" "$line"
+    done
+}
+
+# Build the output prefixes of parallel jobs: descriptions padded to a common
+# width of at most 24 characters
+# Args: $1 - name of the array to fill, then the bookmark JSON objects
+build_job_labels() {
+    local -n job_labels="$1"
+    shift
+    local -a descriptions=()
+    local description width=0
+    readarray -t descriptions < <(printf '%s\n' "$@" | jq -r '.description')
+    for description in "${descriptions[@]}"; do
+        [[ ${#description} -le $width ]] || width=${#description}
+    done
+    [[ $width -le 24 ]] || width=24
+    job_labels=()
+    for description in "${descriptions[@]}"; do
+        printf -v description "%-${width}.${width}s" "$description"
+        job_labels+=("${CYAN}${description}${NC} |")
+    done
+}
+
+# Run one bookmark of a parallel run with its output prefixed by its label
+# Args: $1 - bookmark JSON object, $2 - label, $3 - result file prefix
+# Writes the exit status to <prefix>.status and, for timed types, the run to <prefix>.run
+run_bookmark_job() {
+    local bookmark="$1"
+    local label="$2"
+    local result="$3"
+    
+    # NUL-separated so multi-line commands survive
+    local -a fields=()
+    readarray -d '' fields < <(jq -j '.id, "\u0000", .type, "\u0000", .command, "\u0000",
+        .status, "\u0000", (.cache_ttl // 0), "\u0000", .description, "\u0000", .host_group // "", "\u0000"' <<< "$bookmark")
+    local id="${fields[0]}" type="${fields[1]}" command="${fields[2]}"
+    local status="${fields[3]}" cache_ttl="${fields[4]}" description="${fields[5]}" host_group="${fields[6]}"
+    
+    if [[ "$status" == "obsolete" && "$NON_INTERACTIVE" != "true" ]]; then
+        echo "skipped" > "$result.status"
+        printf '%b %s\n' "$label" "Skipped: bookmark is obsolete (use -y to run it anyway)"
+        return 0
+    fi
+    
+    local exit_status
+    set +e
+    (
+        exec < /dev/null
+        TELEMETRY_RESULT_FILE="$result.run"
+        cache_entry=""
+        if [[ "$cache_ttl" -gt 0 && -z "$host_group" && ( "$type" == "cmd" || "$type" == "script" ) ]]; then
+            cache_entry=$(output_cache_entry "$id" "$command")
+            replay_cached_output "$cache_entry" "$cache_ttl" && exit 0
+        fi
+        execute_bookmark_by_type "$type" "$command" "$description" "$cache_entry" "$host_group" "$id"
+    ) 2>&1 | prefix_lines "$label"
+    exit_status=${PIPESTATUS[0]}
+    set -e
+    echo "$exit_status" > "$result.status"
+}
+
+# Check whether a bookmark is opened by the system opener or browser, and can
+# therefore share one invocation with others
+# Args: $1 - bookmark JSON object
+# Returns: 0 for url, folder and file bookmarks without a type handler
+is_batch_openable() {
+    local type
+    type=$(jq -r '.type' <<< "$1")
+    [[ "$type" == "url" || "$type" == "folder" || "$type" == "file" ]] && ! has_type_handler "$type"
+}
+
+# Start a program in the background on batches of bookmark commands
+# Args: $1 - program, $2 - batch size, then the commands
+# Returns: the number of invocations on stdout
+invoke_in_batches() {
+    local program="$1"
+    local size="$2"
+    shift 2
+    local -a words=("$@")
+    local i invocations=0
+    for ((i = 0; i < ${#words[@]}; i += size)); do
+        eval "$program ${words[*]:i:size} & disown" > /dev/null
+        invocations=$((invocations + 1))
+    done
+    echo "$invocations"
+}
+
+# Open url, folder and file bookmarks with as few opener invocations as
+# possible: URLs go to BOOKMARKS_BROWSER when it is set, everything else to
+# the system opener. Each invocation gets at most OPEN_BATCH_SIZE bookmarks;
+# openers that take a single argument (xdg-open, start) get one each
+# Args: bookmark JSON objects
+open_bookmarks_in_batches() {
+    local batch_size="${OPEN_BATCH_SIZE:-$DEFAULT_OPEN_BATCH_SIZE}"
+    [[ "$batch_size" =~ ^[1-9][0-9]*$ ]] || batch_size="$DEFAULT_OPEN_BATCH_SIZE"
+    local open_cmd browser="${BOOKMARKS_BROWSER:-}"
+    open_cmd=$(detect_system_opener)
+    
+    # Commands are shell words (usually quoted paths or URLs), so a batch is
+    # the commands joined by spaces, evaluated as the single-bookmark path does
+    local -a browser_words=() opener_words=() fields=()
+    local bookmark
+    for bookmark in "$@"; do
+        readarray -d '' fields < <(jq -j '.type, "\u0000", (.command | gsub("\n"; " ")), "\u0000"' <<< "$bookmark")
+        if [[ "${fields[0]}" == "url" && -n "$browser" ]]; then
+            browser_words+=("${fields[1]}")
+        else
+            opener_words+=("${fields[1]}")
+        fi
+    done
+    
+    local invocations=0
+    if [[ ${#browser_words[@]} -gt 0 ]]; then
+        invocations=$(( invocations + $(invoke_in_batches "$browser" "$batch_size" "${browser_words[@]}") ))
+    fi
+    if [[ ${#opener_words[@]} -gt 0 && -n "$open_cmd" ]]; then
+        [[ "$open_cmd" == "open" ]] || batch_size=1
+        invocations=$(( invocations + $(invoke_in_batches "$open_cmd" "$batch_size" "${opener_words[@]}") ))
+    elif [[ ${#opener_words[@]} -gt 0 ]]; then
+        echo -e "${YELLOW}Warning: No system opener found (xdg-open, open, or start)${NC}"
+        echo -e "${BLUE}Falling back to direct execution${NC}"
+        local words
+        for words in "${opener_words[@]}"; do
+            eval "$words"
+        done
+    fi
+    [[ $invocations -eq 0 ]] || echo -e "${GREEN}Opened $# bookmarks with $invocations invocations${NC}"
+}
+
+# Open url, folder and file bookmarks together, by name or by tag
+# Access statistics of all of them are recorded in a single commit
+# Args: --tag TAG, or bookmark IDs or descriptions
+open_bookmarks() {
+    validate_bookmarks_file || exit 1
+    
+    local -a bookmarks=()
+    local bookmark arg
+    if [[ "${1:-}" == "--tag" || "${1:-}" == "-t" ]]; then
+        if [[ -z "${2:-}" ]]; then
+            echo -e "${RED}Usage: $0 open --tag TAG | \"Description or ID\"...${NC}" >&2
+            exit 1
+        fi
+        while IFS= read -r bookmark; do
+            is_batch_openable "$bookmark" && bookmarks+=("$bookmark")
+        done < <(filter_all_bookmarks | filter_active | filter_by_tag "$2")
+        if [[ ${#bookmarks[@]} -eq 0 ]]; then
+            echo -e "${YELLOW}No url, folder or file bookmarks tagged $2${NC}"
+            return 0
+        fi
+    elif [[ $# -gt 0 ]]; then
+        for arg in "$@"; do
+            bookmark=$(get_bookmark_by_id_or_desc "$arg" | jq -sc '.[0] // empty')
+            if [[ -z "$bookmark" ]]; then
+                echo -e "${RED}No bookmark found with ID or description: $arg${NC}" >&2
+                exit 1
+            elif ! is_batch_openable "$bookmark"; then
+                echo -e "${RED}Error: $arg is not a url, folder or file bookmark (use run instead)${NC}" >&2
+                exit 1
+            fi
+            bookmarks+=("$bookmark")
+        done
+    else
+        echo -e "${RED}Usage: $0 open --tag TAG | \"Description or ID\"...${NC}" >&2
+        exit 1
+    fi
+    
+    open_bookmarks_in_batches "${bookmarks[@]}"
+    update_bookmarks_access "$(printf '%s\n' "${bookmarks[@]}" | jq -sc 'map(.id) | unique')"
+}
+
+# Run several bookmarks at once, at most RUN_JOBS at a time
+# Output lines are prefixed with the bookmark they came from and a summary of
+# exit statuses follows. url, folder and file bookmarks are opened together
+# in batches instead. Access statistics and run times of all of them are
+# recorded in a single commit
+# Args: [-j N] bookmark IDs or descriptions
+# Returns: 0 if every bookmark succeeded, 1 otherwise
+run_bookmarks_parallel() {
+    local max_jobs="${RUN_JOBS:-$DEFAULT_RUN_JOBS}"
+    if [[ "${1:-}" == "-j" || "${1:-}" == "--jobs" ]]; then
+        max_jobs="${2:-}"
+        shift 2 || shift
+    fi
+    if [[ $# -eq 0 ]] || ! [[ "$max_jobs" =~ ^[1-9][0-9]*$ ]]; then
+        echo -e "${RED}Usage: $0 run [-j N] \"Description or ID\"...${NC}" >&2
+        exit 1
+    fi
     
-    # Extract command, type, and status efficiently
-    local bookmark_data
-    bookmark_data=$(echo "$bookmark" | jq -r '[.command, .type, .status] | @tsv')
-    IFS=$'\t' read -r command type status <<< "$bookmark_data"
+    validate_bookmarks_file || exit 1
     
-    # Check if bookmark is obsolete
-    if [[ "$status" == "obsolete" ]]; then
-        echo -e "${YELLOW}Warning: This bookmark is marked as obsolete.${NC}"
-        
-        if ! get_user_confirmation "Do you still want to execute it? (y/n): "; then
-            return
+    # Resolve everything before starting anything
+    local arg bookmark
+    local -a bookmarks=()
+    for arg in "$@"; do
+        bookmark=$(get_bookmark_by_id_or_desc "$arg" | jq -sc '.[0] // empty')
+        if [[ -z "$bookmark" ]]; then
+            echo -e "${RED}No bookmark found with ID or description: $arg${NC}" >&2
+            exit 1
         fi
-    fi
+        bookmarks+=("$bookmark")
+    done
     
-    echo -e "${GREEN}Executing: ${CYAN}$description${NC}"
-    echo -e "${BLUE}Type: ${NC}$type"
-    echo -e "${BLUE}Command: ${NC}$command"
+    local -a labels=()
+    local i
+    build_job_labels labels "${bookmarks[@]}"
+    
+    echo -e "${GREEN}Running ${#bookmarks[@]} bookmarks, at most $max_jobs at a time${NC}"
+    local results_dir
+    results_dir=$(mktemp -d)
+    
+    # Bookmarks for the opener are handed over together rather than one job each
+    local -a to_open=()
+    local -A opened=()
+    for i in "${!bookmarks[@]}"; do
+        is_batch_openable "${bookmarks[i]}" || continue
+        opened[$i]=1
+        if [[ "$NON_INTERACTIVE" != "true" ]] && jq -e '.status == "obsolete"' <<< "${bookmarks[i]}" > /dev/null; then
+            echo "skipped" > "$results_dir/$i.status"
+        else
+            echo "opened" > "$results_dir/$i.status"
+            to_open+=("${bookmarks[i]}")
+        fi
+    done
+    [[ ${#to_open[@]} -eq 0 ]] || open_bookmarks_in_batches "${to_open[@]}"
+    
+    for i in "${!bookmarks[@]}"; do
+        [[ -z "${opened[$i]:-}" ]] || continue
+        while [[ $(jobs -rp | wc -l) -ge $max_jobs ]]; do
+            wait -n || true
+        done
+        run_bookmark_job "${bookmarks[i]}" "${labels[i]}" "$results_dir/$i" &
+    done
+    wait
+    
+    # One record per bookmark: id, description, exit status and run time
+    local results
+    results=$(for i in "${!bookmarks[@]}"; do
+        jq -c --arg status "$(cat "$results_dir/$i.status" 2>/dev/null || echo 1)" \
+            --arg run "$(cat "$results_dir/$i.run" 2>/dev/null)" '
+            {id, description, status: $status,
+             run: ($run | if . == "" then null else split("\t") | {ms: (.[0] | tonumber), status: (.[1] | tonumber)} end)}
+        ' <<< "${bookmarks[i]}"
+    done | jq -s -c '.')
+    rm -rf "$results_dir"
     
-    # Update access statistics before executing
-    update_bookmark_access "$description"
+    echo ""
+    echo -e "${BLUE}Summary${NC}"
+    local failed=0 status duration
+    while IFS=$'\t' read -r status duration description; do
+        case "$status" in
+            0) printf "  ${GREEN}%-9s${NC} %10s  %s\n" "ok" "$duration" "$description" ;;
+            opened) printf "  ${GREEN}%-9s${NC} %10s  %s\n" "opened" "$duration" "$description" ;;
+            skipped) printf "  ${YELLOW}%-9s${NC} %10s  %s\n" "skipped" "$duration" "$description" ;;
+            *) printf "  ${RED}%-9s${NC} %10s  %s\n" "exit $status" "$duration" "$description"; failed=$((failed + 1)) ;;
+        esac
+    done < <(jq -r "$TELEMETRY_JQ_DEFS"'.[] | [.status, (.run.ms | if . == null then "-" else format_ms end), .description] | @tsv' <<< "$results")
     
-    # Recalculate all frecency scores in the background to avoid blocking
-    # This ensures scores stay up-to-date without slowing down execution
-    # Errors are logged to a file for debugging
-    (recalculate_all_frecency 2>> "$BOOKMARKS_DIR/frecency_errors.log" > /dev/null &)
+    local ids_json runs_json
+    ids_json=$(jq -c '[.[] | select(.status != "skipped") | .id] | unique' <<< "$results")
+    runs_json=$(jq -c 'reduce (.[] | select(.run)) as $r ({}; .[$r.id] = $r.run)' <<< "$results")
+    [[ "$ids_json" == "[]" ]] || update_bookmarks_access "$ids_json" "$runs_json"
     
-    # Execute the command based on bookmark type
-    execute_bookmark_by_type "$type" "$command" "$description"
+    if [[ $failed -gt 0 ]]; then
+        echo -e "${RED}$failed of ${#bookmarks[@]} bookmarks failed${NC}"
+        return 1
+    fi
+    return 0
 }
 
 # List and optionally execute bookmarks with fuzzy search
@@ -1377,14 +3910,25 @@ list_bookmarks() {
     # Select bookmark based on search term or interactively
     local selected
     if [[ -z "$search_term" ]]; then
+        # Connect to the likeliest ssh targets while the user is choosing
+        prewarm_ssh_masters "${SSH_PREWARM:-$DEFAULT_SSH_PREWARM}"
+        
         # No search term provided, use fzf for interactive selection
-        selected=$(echo "$formatted_bookmarks" | fzf --ansi --border)
+        # Several bookmarks can be picked with Tab to run them in parallel
+        selected=$(fzf_select_ranked "$formatted_bookmarks" --ansi --border --tiebreak=index --multi)
     else
         # Use the search term with fzf filter
-        selected=$(echo "$formatted_bookmarks" | fzf --ansi --filter="$search_term" | head -1)
+        selected=$(echo "$formatted_bookmarks" | fzf --ansi --tiebreak=index --filter="$search_term" | head -1)
     fi
     
-    if [[ -n "$selected" ]]; then
+    if [[ "$selected" == *$'\n'* ]]; then
+        local line
+        local -a descriptions=()
+        while IFS= read -r line; do
+            descriptions+=("$(extract_description_from_fzf_line "$line")")
+        done <<< "$selected"
+        run_bookmarks_parallel "${descriptions[@]}"
+    elif [[ -n "$selected" ]]; then
         # Extract the description from the formatted line
         local description
         description=$(extract_description_from_fzf_line "$selected")
@@ -1430,7 +3974,7 @@ list_bookmarks_with_details() {
                 --header="Select bookmark (obsolete bookmarks shown in red)")
     else
         # Use the search term with fzf filter
-        selected=$(echo "$formatted_bookmarks" | fzf --ansi --filter="$search_term" | head -1)
+        selected=$(echo "$formatted_bookmarks" | fzf --ansi --tiebreak=index --filter="$search_term" | head -1)
     fi
     
     if [[ -n "$selected" ]]; then
@@ -1476,6 +4020,8 @@ format_bookmark_details_for_preview() {
     access_count=$(echo "$bookmark" | jq -r '.access_count // 0')
     last_accessed=$(echo "$bookmark" | jq -r '.last_accessed // "null"')
     frecency_score=$(echo "$bookmark" | jq -r '.frecency_score // 0')
+    local layer
+    layer=$(echo "$bookmark" | jq -r 'if .overlay == "edit" then "\(.base_layer) (personal copy)" else .layer // "" end')
     
     # Format the output with clear labels using RST-style underlines
     echo "Bookmark Details"
@@ -1483,6 +4029,9 @@ format_bookmark_details_for_preview() {
     echo ""
     echo "Type:   $type"
     echo "Status: $status"
+    if [[ -n "$layer" ]]; then
+        echo "Layer:  $layer"
+    fi
     echo ""
     echo "Description"
     echo "-----------"
@@ -1518,6 +4067,9 @@ format_bookmark_details_for_preview() {
     if [[ -n "$modified" && "$modified" != "null" ]]; then
         echo "Modified:    $modified"
     fi
+    echo "$bookmark" | jq -r 'select(.cache_ttl) | "Cache TTL:   \(.cache_ttl)s"'
+    echo "$bookmark" | jq -r 'select(.type == "workflow") | "On Failure:  \(.on_failure // "stop")"'
+    echo "$bookmark" | jq -r 'select(.host_group) | "Host Group:  \(.host_group)"'
     echo ""
     echo "USAGE STATISTICS"
     echo "----------------"
@@ -1528,6 +4080,22 @@ format_bookmark_details_for_preview() {
         echo "Last Accessed:   N/A"
     fi
     echo "Frecency Score:  $frecency_score"
+    echo "$bookmark" | jq -r --argjson today "$CURRENT_LOCAL_DAY" "$USAGE_JQ_DEFS"'
+        select(.usage) | "Last 14 Days:    \(usage_days($today) | sparkline)", "By Hour (0-23):  \(usage_hours | sparkline)"'
+    echo "$bookmark" | jq -r "$TELEMETRY_JQ_DEFS"'
+        select(.runs) | "Runs:            \(.runs.count) (\(failure_rate | format_percent) failed, last exit \(.runs.last_status))",
+            "Duration:        p50 \(run_quantile(0.5) | format_ms), p95 \(run_quantile(0.95) | format_ms)"'
+    
+    # Append handler-provided preview for registered types
+    if has_type_handler "$type"; then
+        local handler_preview
+        if handler_preview=$(run_type_handler "$type" preview "$command" "$description" 2>/dev/null) && [[ -n "$handler_preview" ]]; then
+            echo ""
+            echo "Preview"
+            echo "-------"
+            echo "$handler_preview"
+        fi
+    fi
 }
 
 # Display bookmarks grouped by type with color coding
@@ -1540,7 +4108,7 @@ display_bookmarks_by_type() {
         .[] | 
         "Type: " + .[0].type + "\n" + 
         (map("  " + (if .status == "obsolete" then "🚫 " else "✅ " end) + .description) | join("\n")) + "\n"
-    ' "$BOOKMARKS_FILE" | \
+    ' "$BOOKMARKS_VIEW_FILE" | \
     while IFS= read -r line; do
         if [[ "$line" == Type:* ]]; then
             echo -e "${CYAN}$line${NC}"
@@ -1567,7 +4135,7 @@ display_detailed_bookmarks() {
         "Notes: " + (.notes // "") + "\n" +
         "Created: " + (.created // "") + "\n" +
         "Status: " + .status + "\n"
-    ' "$BOOKMARKS_FILE" | \
+    ' "$BOOKMARKS_VIEW_FILE" | \
     while IFS= read -r line; do
         case "$line" in
             Description:*) echo -e "${YELLOW}$line${NC}" ;;
@@ -1588,9 +4156,11 @@ display_detailed_bookmarks() {
 # List all bookmarks without executing them
 # Output format: [type] description | command | status | id | tags
 # Each bookmark is on a single line for easy processing with shell utilities
-# Args: $1 - show_details flag ("true" to show details, default "false")
+# Args: $1 - show_details flag ("true" to show details, default "false"),
+#       $2 - include_archive flag ("true" to include archived obsolete bookmarks)
 list_all_bookmarks() {
     local show_details="${1:-false}"
+    local include_archive="${2:-false}"
     
     # Validate JSON file first
     validate_bookmarks_file || return 1
@@ -1606,7 +4176,7 @@ list_all_bookmarks() {
     # Extract fields using jq and format with pipe separators
     local jq_query='
         .bookmarks | 
-        sort_by(-.frecency_score // 0) | 
+        sort_by(-rank_score) | 
         .[] | 
         "[" + .type + "] " + .description + " | " + 
         .command + " | " + 
@@ -1615,7 +4185,10 @@ list_all_bookmarks() {
         (.tags // "")
     '
     
-    jq -r "$jq_query" "$BOOKMARKS_FILE" | \
+    local archive_file=/dev/null
+    [[ "$include_archive" == "true" ]] && archive_file="$ARCHIVE_FILE"
+    
+    merge_archive_json "$BOOKMARKS_VIEW_FILE" "$archive_file" | jq -r "${RANKING_JQ_ARGS[@]}" "$RANKING_JQ_DEFS$jq_query" | \
     while IFS= read -r line; do
         if [[ "$use_colors" == "true" ]]; then
             # Color output for terminal viewing
@@ -1664,7 +4237,7 @@ search_by_tag() {
         select(.tags | contains($tag)) | 
         (if .status == "obsolete" then "[OBSOLETE] " else "" end) + 
         "[" + .type + "] " + .description
-    ' "$BOOKMARKS_FILE")
+    ' "$BOOKMARKS_VIEW_FILE")
     
     if [[ -z "$results" ]]; then
         echo -e "${YELLOW}No bookmarks found with tag: $tag${NC}"
@@ -1690,14 +4263,803 @@ search_by_tag() {
 
 
 
+#=============================================================================
+# WORKFLOWS
+#=============================================================================
+
+# A workflow bookmark runs other bookmarks as the steps of a DAG. Its command
+# lists step IDs, separated by newlines or ";", each with the steps it waits
+# for:
+#   1700000000_status; 1700000001_logs1 after 1700000000_status;
+#   1700000002_logs2 after 1700000000_status; 1700000003_board after 1700000001_logs1,1700000002_logs2
+# Steps whose dependencies have succeeded run concurrently, at most RUN_JOBS
+# at a time. When a step fails its dependents are skipped, and with the
+# default on_failure "stop" no further steps start; "continue" keeps running
+# every step that does not depend on the failure.
+
+# jq helpers that parse and check a workflow command
+readonly WORKFLOW_JQ_DEFS='
+def workflow_steps:
+    [splits("[;\n]") | sub("^\\s+"; "") | sub("\\s+$"; "") | select(length > 0)
+        | capture("^(?<id>[^\\s]+)(\\s+after\\s+(?<after>.+))?$")
+        | {id, after: [(.after // "") | splits("[,\\s]+") | select(length > 0)]}];
+# True if every step can be ordered after its dependencies
+def acyclic:
+    def settle:
+        . as $s
+        | [$s.left[] | select(all(.after[]; $s.done[.]))] as $ready
+        | if ($s.left | length) == 0 then true
+          elif ($ready | length) == 0 then false
+          else {done: ($s.done + (reduce $ready[] as $r ({}; .[$r.id] = true))),
+                left: [$s.left[] | select(all(.after[]; $s.done[.]) | not)]} | settle end;
+    {done: {}, left: .} | settle;
+'
+
+# Resolve the steps of a workflow against the store
+# Every step is looked up by ID in an index built in the same jq pass, so the
+# cost does not grow with the number of steps times the store size
+# Args: $1 - workflow command, $2 - workflow bookmark ID (optional)
+# Returns: with an ID, the workflow's on_failure setting from the same index
+#          first; then two lines per step, the indexes of the steps it waits
+#          for and the step's bookmark JSON; 1 with the problems on stderr if invalid
+resolve_workflow_steps() {
+    local spec="$1"
+    local workflow_id="${2:-}"
+    local resolved
+    resolved=$(merge_archive_json "$BOOKMARKS_VIEW_FILE" "$ARCHIVE_FILE" | \
+        jq -r --arg spec "$spec" --arg workflow "$workflow_id" "$WORKFLOW_JQ_DEFS"'
+        (reduce .bookmarks[] as $r ({}; .[$r.id] = $r)) as $by_id
+        | ($spec | workflow_steps) as $steps
+        | (reduce range($steps | length) as $i ({}; .[$steps[$i].id] = $i)) as $position
+        | [if ($steps | length) == 0 then "the workflow has no steps" else empty end,
+           ($steps | group_by(.id)[] | select(length > 1) | "step \(.[0].id) is listed more than once"),
+           ($steps[] | select($by_id[.id] == null) | "no bookmark with ID \(.id)"),
+           ($steps[] | select($by_id[.id].type == "workflow") | "step \(.id) is itself a workflow"),
+           ($steps[] | .id as $s | .after[] | select($position[.] == null) | "step \($s) waits for \(.), which is not a step")
+          ] as $errors
+        | if ($errors | length) > 0 then "!" + $errors[]
+          elif ($steps | acyclic | not) then "!the steps depend on each other in a cycle"
+          else (if $workflow != "" then $by_id[$workflow].on_failure // "stop" else empty end),
+               ($steps[] | ([.after[] | $position[.]] | map(tostring) | join(" ")), ($by_id[.id] | tojson))
+          end
+    ') || return 1
+    
+    if [[ "$resolved" == "!"* ]]; then
+        local problem
+        while IFS= read -r problem; do
+            echo -e "${RED}Error: Invalid workflow: ${problem#!}${NC}" >&2
+        done <<< "$resolved"
+        return 1
+    fi
+    echo "$resolved"
+}
+
+# Run a workflow: start every step whose dependencies have succeeded, up to
+# RUN_JOBS at a time, until nothing more can run. Access statistics and the
+# run time of every step and of the workflow are recorded in one commit
+# Args: $1 - workflow command, $2 - workflow bookmark ID
+# Returns: 0 if every step succeeded, 1 otherwise
+run_workflow() {
+    local command="$1"
+    local workflow_id="$2"
+    local max_jobs="${RUN_JOBS:-$DEFAULT_RUN_JOBS}"
+    
+    local resolved
+    resolved=$(resolve_workflow_steps "$command" "$workflow_id") || return 1
+    local -a lines=()
+    readarray -t lines <<< "$resolved"
+    
+    local on_failure="${lines[0]}"
+    local -a deps=() steps=() states=() labels=()
+    local i
+    for ((i = 1; i < ${#lines[@]}; i += 2)); do
+        deps+=("${lines[i]}")
+        steps+=("${lines[i + 1]}")
+        states+=("pending")
+    done
+    build_job_labels labels "${steps[@]}"
+    
+    echo -e "${GREEN}Running workflow with ${#steps[@]} steps, at most $max_jobs at a time (on failure: $on_failure)${NC}"
+    local results_dir started
+    results_dir=$(mktemp -d)
+    started=$(now_microseconds)
+    
+    local running=0 stopping=false settled dep ready
+    while true; do
+        # Steps waiting for a failed or skipped step are skipped
+        settled=false
+        while [[ "$settled" == "false" ]]; do
+            settled=true
+            for i in "${!steps[@]}"; do
+                [[ "${states[i]}" == "pending" ]] || continue
+                for dep in ${deps[i]}; do
+                    if [[ "${states[dep]}" == "failed" || "${states[dep]}" == "skipped" ]]; then
+                        states[i]="skipped"
+                        settled=false
+                        break
+                    fi
+                done
+            done
+        done
+        
+        if [[ "$stopping" == "false" ]]; then
+            for i in "${!steps[@]}"; do
+                [[ "${states[i]}" == "pending" && $running -lt $max_jobs ]] || continue
+                ready=true
+                for dep in ${deps[i]}; do
+                    [[ "${states[dep]}" == "ok" ]] || { ready=false; break; }
+                done
+                [[ "$ready" == "true" ]] || continue
+                states[i]="running"
+                running=$((running + 1))
+                (
+                    step_started=$(now_microseconds)
+                    run_bookmark_job "${steps[i]}" "${labels[i]}" "$results_dir/$i"
+                    echo $(( ($(now_microseconds) - step_started) / 1000 )) > "$results_dir/$i.ms"
+                    touch "$results_dir/$i.done"
+                ) &
+            done
+        fi
+        
+        [[ $running -gt 0 ]] || break
+        wait -n || true
+        
+        for i in "${!steps[@]}"; do
+            [[ "${states[i]}" == "running" && -f "$results_dir/$i.done" ]] || continue
+            running=$((running - 1))
+            case "$(< "$results_dir/$i.status")" in
+                0) states[i]="ok" ;;
+                skipped) states[i]="skipped" ;;
+                *)
+                    states[i]="failed"
+                    [[ "$on_failure" == "continue" ]] || stopping=true
+                    ;;
+            esac
+        done
+    done
+    local total_ms=$(( ($(now_microseconds) - started) / 1000 ))
+    
+    # Summary, then one commit for the steps that ran; the workflow's own run is
+    # reported through TELEMETRY_RESULT_FILE like any timed run
+    echo ""
+    echo -e "${BLUE}Workflow summary${NC}"
+    local failed=0 status duration ids_json="[]" runs_json="{}" step_id run
+    for i in "${!steps[@]}"; do
+        step_id=$(jq -r '.id' <<< "${steps[i]}")
+        duration="-"
+        case "${states[i]}" in
+            ok|failed)
+                status=$(< "$results_dir/$i.status")
+                duration=$(jq -r "$TELEMETRY_JQ_DEFS"'format_ms' < "$results_dir/$i.ms")
+                ids_json=$(jq -c --arg id "$step_id" '. + [$id]' <<< "$ids_json")
+                if [[ -f "$results_dir/$i.run" ]]; then
+                    run=$(< "$results_dir/$i.run")
+                    runs_json=$(jq -c --arg id "$step_id" --argjson ms "${run%%$'\t'*}" --argjson status "${run##*$'\t'}" \
+                        '.[$id] = {ms: $ms, status: $status}' <<< "$runs_json")
+                fi
+                ;;
+        esac
+        case "${states[i]}" in
+            ok) printf "  ${GREEN}%-11s${NC} %10s  %s\n" "ok" "$duration" "$(jq -r '.description' <<< "${steps[i]}")" ;;
+            failed)
+                printf "  ${RED}%-11s${NC} %10s  %s\n" "exit $status" "$duration" "$(jq -r '.description' <<< "${steps[i]}")"
+                failed=$((failed + 1))
+                ;;
+            skipped) printf "  ${YELLOW}%-11s${NC} %10s  %s\n" "skipped" "$duration" "$(jq -r '.description' <<< "${steps[i]}")" ;;
+            *) printf "  ${YELLOW}%-11s${NC} %10s  %s\n" "not started" "$duration" "$(jq -r '.description' <<< "${steps[i]}")" ;;
+        esac
+    done
+    rm -rf "$results_dir"
+    
+    local workflow_status=0
+    [[ $failed -eq 0 ]] && ! [[ " ${states[*]} " =~ " "(skipped|pending)" " ]] || workflow_status=1
+    if [[ -n "$TELEMETRY_RESULT_FILE" ]]; then
+        printf '%s\t%s\n' "$total_ms" "$workflow_status" > "$TELEMETRY_RESULT_FILE"
+    fi
+    if [[ "$ids_json" != "[]" ]]; then
+        update_bookmarks_access "$ids_json" "$runs_json" \
+            || echo -e "${YELLOW}Warning: Could not record workflow statistics${NC}" >&2
+    fi
+    
+    if [[ $workflow_status -ne 0 ]]; then
+        echo -e "${RED}Workflow did not complete: $failed failed${NC}"
+    fi
+    return "$workflow_status"
+}
+
+#=============================================================================
+# HOST GROUPS
+#=============================================================================
+
+# A cmd or ssh bookmark with a host_group runs once per host of the group,
+# with {host} in its command replaced by the host name:
+#   bookmark hosts web web-1 web-2 web-3
+#   bookmark add "Disk usage" ssh 'ssh {host} df -h /'
+#   bookmark set "Disk usage" host_group web
+# Groups are "name=host host ..." lines in HOST_GROUPS_FILE. Hosts run at
+# most HOST_JOBS at a time, each limited to HOST_TIMEOUT seconds.
+HOST_GROUPS_FILE="$BOOKMARKS_DIR/host_groups"
+
+# Get the hosts of a group
+# Args: $1 - group name
+# Returns: one host per line, 1 if there is no such group
+get_host_group() {
+    local group="$1"
+    local name hosts
+    [[ -f "$HOST_GROUPS_FILE" ]] || return 1
+    while IFS='=' read -r name hosts; do
+        if [[ "$name" == "$group" ]]; then
+            printf '%s\n' $hosts
+            return 0
+        fi
+    done < "$HOST_GROUPS_FILE"
+    return 1
+}
+
+# List, define or delete host groups
+# Args: none to list; a group name and its hosts to define or replace it;
+#       -d and a group name to delete it
+manage_host_groups() {
+    if [[ $# -eq 0 ]]; then
+        if [[ ! -s "$HOST_GROUPS_FILE" ]]; then
+            echo -e "${YELLOW}No host groups defined. Define one with: $0 hosts <group> <host>...${NC}"
+            return 0
+        fi
+        local name hosts
+        while IFS='=' read -r name hosts; do
+            printf "${CYAN}%-16s${NC} %s\n" "$name" "$hosts"
+        done < "$HOST_GROUPS_FILE"
+        return 0
+    fi
+    
+    local delete=false
+    if [[ "$1" == "-d" || "$1" == "--delete" ]]; then
+        delete=true
+        shift
+    fi
+    local group="${1:-}"
+    shift || true
+    if ! [[ "$group" =~ ^[A-Za-z0-9_.-]+$ ]] || [[ "$delete" == "true" && $# -gt 0 ]] || \
+        [[ "$delete" == "false" && $# -eq 0 ]]; then
+        echo -e "${RED}Usage: $0 hosts [<group> <host>... | -d <group>]${NC}" >&2
+        exit 1
+    fi
+    # Host names are substituted into commands unquoted, so keep them plain
+    local host
+    for host in "$@"; do
+        if ! [[ "$host" =~ ^[A-Za-z0-9_.@:-]+$ ]]; then
+            echo -e "${RED}Error: Invalid host name: $host${NC}" >&2
+            exit 1
+        fi
+    done
+    if [[ "$delete" == "true" ]] && ! get_host_group "$group" > /dev/null; then
+        echo -e "${RED}Error: No host group named $group${NC}" >&2
+        exit 1
+    fi
+    
+    local tmp_file
+    tmp_file=$(mktemp "$HOST_GROUPS_FILE.XXXXXX")
+    if [[ -f "$HOST_GROUPS_FILE" ]]; then
+        grep -v "^$group=" "$HOST_GROUPS_FILE" > "$tmp_file" || true
+    fi
+    [[ "$delete" == "true" ]] || echo "$group=$*" >> "$tmp_file"
+    mv "$tmp_file" "$HOST_GROUPS_FILE"
+    
+    if [[ "$delete" == "true" ]]; then
+        echo -e "${GREEN}Deleted host group: ${CYAN}$group${NC}"
+    else
+        echo -e "${GREEN}Host group ${CYAN}$group${GREEN}: $# hosts${NC}"
+    fi
+}
+
+# Run a command once per host of a group, at most HOST_JOBS at a time
+# Output lines are prefixed with their host and a table of each host's exit
+# status, run time and last output line follows. The fan-out is recorded as
+# one run of the bookmark, failed if any host failed
+# Args: $1 - command with {host}, $2 - description, $3 - group name
+# Returns: 0 if the command succeeded on every host, 1 otherwise
+run_on_host_group() {
+    local command="$1"
+    local description="$2"
+    local group="$3"
+    local max_jobs="${HOST_JOBS:-$DEFAULT_HOST_JOBS}"
+    local host_timeout="${HOST_TIMEOUT:-$DEFAULT_HOST_TIMEOUT}"
+    
+    local -a hosts=()
+    if ! readarray -t hosts < <(get_host_group "$group") || [[ ${#hosts[@]} -eq 0 ]]; then
+        echo -e "${RED}Error: Host group $group is not defined or has no hosts${NC}" >&2
+        return 1
+    fi
+    if [[ "$host_timeout" -gt 0 ]] && ! has_capability timeout; then
+        echo -e "${YELLOW}Warning: timeout is not installed, hosts run without a time limit${NC}" >&2
+        host_timeout=0
+    fi
+    
+    # Host names padded to a common width, as bookmark labels are for `run`
+    local -a labels=()
+    local i host width=0
+    for host in "${hosts[@]}"; do
+        [[ ${#host} -le $width ]] || width=${#host}
+    done
+    for host in "${hosts[@]}"; do
+        printf -v host "%-${width}s" "$host"
+        labels+=("${CYAN}${host}${NC} |")
+    done
+    
+    echo -e "${GREEN}Running on ${#hosts[@]} hosts of $group, at most $max_jobs at a time${NC}"
+    local results_dir started
+    results_dir=$(mktemp -d)
+    started=$(now_microseconds)
+    for i in "${!hosts[@]}"; do
+        while [[ $(jobs -rp | wc -l) -ge $max_jobs ]]; do
+            wait -n || true
+        done
+        (
+            host_started=$(now_microseconds)
+            host_command="${command//\{host\}/${hosts[i]}}"
+            set +e
+            if [[ "$host_timeout" -gt 0 ]]; then
+                timeout "$host_timeout" bash -ec "$host_command" < /dev/null 2>&1
+            else
+                bash -ec "$host_command" < /dev/null 2>&1
+            fi | tee "$results_dir/$i.out" | prefix_lines "${labels[i]}"
+            echo "${PIPESTATUS[0]}" > "$results_dir/$i.status"
+            echo $(( ($(now_microseconds) - host_started) / 1000 )) > "$results_dir/$i.ms"
+        ) &
+    done
+    wait
+    local total_ms=$(( ($(now_microseconds) - started) / 1000 ))
+    
+    echo ""
+    echo -e "${BLUE}Results for $group${NC}"
+    local failed=0 status result colour duration last_line
+    for i in "${!hosts[@]}"; do
+        status=$(cat "$results_dir/$i.status" 2>/dev/null || echo 1)
+        duration=$(jq -r "$TELEMETRY_JQ_DEFS"'format_ms' < "$results_dir/$i.ms")
+        last_line=$(tail -n 1 "$results_dir/$i.out")
+        colour="$RED"
+        case "$status" in
+            0) result="ok"; colour="$GREEN" ;;
+            124) [[ "$host_timeout" -gt 0 ]] && result="timeout" || result="exit 124" ;;
+            *) result="exit $status" ;;
+        esac
+        [[ "$status" -eq 0 ]] || failed=$((failed + 1))
+        printf "  %-${width}s  ${colour}%-9s${NC} %10s  %s\n" "${hosts[i]}" "$result" "$duration" "$last_line"
+    done
+    rm -rf "$results_dir"
+    
+    local group_status=0
+    if [[ $failed -gt 0 ]]; then
+        echo -e "${RED}Failed on $failed of ${#hosts[@]} hosts${NC}"
+        group_status=1
+    fi
+    if [[ -n "$TELEMETRY_RESULT_FILE" ]]; then
+        printf '%s\t%s\n' "$total_ms" "$group_status" > "$TELEMETRY_RESULT_FILE"
+    fi
+    return "$group_status"
+}
+
+#=============================================================================
+# SSH CONNECTION POOLING
+#=============================================================================
+
+# ssh bookmarks run through an OpenSSH master connection per target, so only
+# the first connection pays for the TCP and authentication handshake. The
+# sockets live in SSH_CONTROL_DIR, named user@host:port, and each master
+# exits after SSH_CONTROL_PERSIST idle seconds. With SSH_PREWARM=N the N
+# most frecent ssh bookmarks are connected in the background when the picker
+# opens. Commands that already set ControlMaster or ControlPath are left alone.
+SSH_CONTROL_DIR="$BOOKMARKS_DIR/ssh"
+
+# Control socket path for ssh -o ControlPath
+# Unix socket paths are limited to about 100 bytes, so deep BOOKMARKS_DIRs
+# fall back to ssh's fixed-length connection hash
+ssh_control_path() {
+    if [[ ${#SSH_CONTROL_DIR} -le 40 ]]; then
+        echo "$SSH_CONTROL_DIR/%r@%h:%p"
+    else
+        echo "$SSH_CONTROL_DIR/%C"
+    fi
+}
+
+# Add connection pooling options to an ssh command
+# Args: $1 - bookmark command
+# Returns: the command with master connection options after its leading ssh,
+#          or unchanged if it does not start with ssh or pooling is off
+ssh_pooled_command() {
+    local command="$1"
+    local persist="${SSH_CONTROL_PERSIST:-$DEFAULT_SSH_CONTROL_PERSIST}"
+    if [[ "$persist" == "0" || ! "$command" =~ ^[[:space:]]*ssh[[:space:]] || \
+        "$command" == *ControlMaster* || "$command" == *ControlPath* ]]; then
+        printf '%s\n' "$command"
+        return 0
+    fi
+    mkdir -p "$SSH_CONTROL_DIR"
+    chmod 700 "$SSH_CONTROL_DIR"
+    local options
+    printf -v options -- '-o ControlMaster=auto -o ControlPath=%q -o ControlPersist=%s' "$(ssh_control_path)" "$persist"
+    printf '%s\n' "${command/ssh/ssh $options}"
+}
+
+# Reduce an ssh command to the arguments of its connection: the options and
+# the destination, without the remote command
+# Args: $1 - bookmark command
+# Returns: the arguments on stdout, one per line; 1 if the command is not a
+#          plain ssh invocation (quotes, expansions or {host} placeholders)
+ssh_connection_words() {
+    local command="$1"
+    [[ "$command" =~ ^[[:space:]]*ssh[[:space:]] ]] || return 1
+    local special='['\''"$`\\;|&{}]'
+    [[ ! "$command" =~ $special ]] || return 1
+    local -a words=()
+    read -ra words <<< "$command"
+    local i=1
+    while [[ $i -lt ${#words[@]} ]]; do
+        case "${words[i]}" in
+            -[BbcDEeFIiJLlmOoPpQRSWw])
+                # Options that take an argument
+                printf '%s\n%s\n' "${words[i]}" "${words[i + 1]:-}"
+                i=$((i + 2))
+                ;;
+            -*)
+                echo "${words[i]}"
+                i=$((i + 1))
+                ;;
+            *)
+                echo "${words[i]}"
+                return 0
+                ;;
+        esac
+    done
+    return 1
+}
+
+# Open master connections for the most frecent ssh bookmarks in the
+# background, skipping targets that already have one
+# Args: $1 - number of bookmarks to connect
+prewarm_ssh_masters() {
+    local count="${1:-0}"
+    local persist="${SSH_CONTROL_PERSIST:-$DEFAULT_SSH_CONTROL_PERSIST}"
+    [[ "$count" =~ ^[1-9][0-9]*$ && "$persist" != "0" ]] || return 0
+    is_command_available ssh || return 0
+    
+    local -a commands=()
+    readarray -t commands < <(jq -r --argjson n "$count" '
+        [.bookmarks[] | select(.type == "ssh" and .status != "obsolete" and (.host_group | not))]
+        | sort_by(-(.frecency_score // 0)) | .[:$n][] | .command | gsub("\n"; " ")
+    ' "$BOOKMARKS_VIEW_FILE")
+    [[ ${#commands[@]} -gt 0 && -n "${commands[0]}" ]] || return 0
+    
+    mkdir -p "$SSH_CONTROL_DIR"
+    chmod 700 "$SSH_CONTROL_DIR"
+    local control_path
+    control_path=$(ssh_control_path)
+    (
+        local command connection
+        local -a args=()
+        for command in "${commands[@]}"; do
+            connection=$(ssh_connection_words "$command") || continue
+            readarray -t args <<< "$connection"
+            # An existing master answers -O check; otherwise start one that
+            # never prompts, since nobody can answer in the background
+            ssh -o ControlPath="$control_path" -O check "${args[@]}" 2>/dev/null && continue
+            ssh -f -N -o ControlMaster=auto -o ControlPath="$control_path" \
+                -o ControlPersist="$persist" -o BatchMode=yes -o ConnectTimeout=10 "${args[@]}" || true
+        done
+    ) < /dev/null > /dev/null 2>&1 &
+}
+
+# List, open or close pooled ssh master connections
+# Sockets whose master has gone away are removed while listing
+# Args: $1 - list, warm or stop; $2 - number of bookmarks for warm, or the
+#       target (user@host:port socket name) for stop; all targets by default
+manage_ssh_masters() {
+    local action="$1"
+    local argument="${2:-}"
+    
+    case "$action" in
+        list)
+            local socket live=0
+            for socket in "$SSH_CONTROL_DIR"/*; do
+                [[ -e "$socket" ]] || continue
+                local output
+                if output=$(ssh -o ControlPath="$socket" -O check master 2>&1); then
+                    live=$((live + 1))
+                    printf "${CYAN}%-40s${NC} %s, opened %ss ago\n" "$(basename "$socket")" \
+                        "$(grep -o 'pid=[0-9]*' <<< "$output" || echo running)" "$(file_age_seconds "$socket")"
+                else
+                    rm -f "$socket"
+                fi
+            done
+            [[ $live -gt 0 ]] || echo -e "${YELLOW}No live ssh master connections${NC}"
+            ;;
+        warm)
+            local count="${argument:-${SSH_PREWARM:-$DEFAULT_SSH_PREWARM}}"
+            [[ "$count" != "0" ]] || count=5
+            if ! [[ "$count" =~ ^[1-9][0-9]*$ ]]; then
+                echo -e "${RED}Usage: $0 masters warm [N]${NC}" >&2
+                exit 1
+            fi
+            prewarm_ssh_masters "$count"
+            wait
+            manage_ssh_masters list
+            ;;
+        stop)
+            local socket stopped=0
+            for socket in "$SSH_CONTROL_DIR"/*; do
+                [[ -e "$socket" ]] || continue
+                [[ -z "$argument" || "$(basename "$socket")" == "$argument" ]] || continue
+                ssh -o ControlPath="$socket" -O exit master > /dev/null 2>&1 && stopped=$((stopped + 1))
+                rm -f "$socket"
+            done
+            echo -e "${GREEN}Closed $stopped ssh master connections${NC}"
+            ;;
+        *)
+            echo -e "${RED}Usage: $0 masters [list | warm [N] | stop [target]]${NC}" >&2
+            exit 1
+            ;;
+    esac
+}
+
+#=============================================================================
+# EDITOR SERVERS
+#=============================================================================
+
+# Starting Neovim or Emacs with a large configuration can take a second or
+# more, so when one is already running as a server, files are opened in it:
+#   nvim   - nvim --server <socket> --remote; $NVIM inside Neovim, otherwise
+#            the newest nvim.<pid>.0 socket in the default locations
+#   emacs  - emacsclient -s <socket>; $EMACS_SOCKET_NAME or the default
+#            emacs/server socket
+# The socket found by a scan is cached in EDITOR_SERVER_FILE and reused while
+# it exists (checked with a builtin test). BOOKMARKS_EDITOR_SERVER=off always
+# starts a fresh editor; a socket path there is used as the server.
+EDITOR_SERVER_FILE="$BOOKMARKS_DIR/.editor_server"
+
+# Find a running server of the configured editor
+# Returns: "kind<TAB>socket" with kind nvim or emacs; 1 if none is running
+detect_editor_server() {
+    local setting="${BOOKMARKS_EDITOR_SERVER:-auto}"
+    [[ "$setting" != "off" ]] || return 1
+    
+    local editor kind
+    editor=$(detect_editor)
+    editor="${editor%% *}"
+    case "${editor##*/}" in
+        nvim) kind="nvim" ;;
+        emacs|emacsclient) kind="emacs" ;;
+        *) return 1 ;;
+    esac
+    
+    # Explicit and environment sockets are free to check
+    local socket
+    local -a candidates=()
+    [[ "$setting" == "auto" ]] || candidates+=("$setting")
+    if [[ "$kind" == "nvim" ]]; then
+        candidates+=("${NVIM:-}" "${NVIM_LISTEN_ADDRESS:-}")
+    else
+        candidates+=("${EMACS_SOCKET_NAME:-}")
+    fi
+    for socket in "${candidates[@]}"; do
+        if [[ -n "$socket" && -S "$socket" ]]; then
+            printf '%s\t%s\n' "$kind" "$socket"
+            return 0
+        fi
+    done
+    [[ "$setting" == "auto" ]] || return 1
+    
+    local cached_kind="" cached_socket=""
+    if [[ -f "$EDITOR_SERVER_FILE" ]]; then
+        IFS=$'\t' read -r cached_kind cached_socket < "$EDITOR_SERVER_FILE" || true
+        if [[ "$cached_kind" == "$kind" && -S "$cached_socket" ]]; then
+            printf '%s\t%s\n' "$kind" "$cached_socket"
+            return 0
+        fi
+    fi
+    
+    # Scan the default socket locations, newest first
+    local runtime_dir="${XDG_RUNTIME_DIR:-}"
+    local tmp_dir="${TMPDIR:-/tmp}"
+    candidates=()
+    if [[ "$kind" == "nvim" ]]; then
+        readarray -t candidates < <(ls -t ${runtime_dir:+"$runtime_dir"/nvim.*.0} \
+            "${tmp_dir%/}/nvim.${USER:-$(id -un)}"/*/nvim.*.0 2>/dev/null)
+    else
+        candidates=(${runtime_dir:+"$runtime_dir/emacs/server"} "${tmp_dir%/}/emacs$UID/server")
+    fi
+    for socket in "${candidates[@]}"; do
+        if [[ -S "$socket" ]]; then
+            printf '%s\t%s\n' "$kind" "$socket" > "$EDITOR_SERVER_FILE"
+            printf '%s\t%s\n' "$kind" "$socket"
+            return 0
+        fi
+    done
+    rm -f "$EDITOR_SERVER_FILE"
+    return 1
+}
+
+# Open files in a running editor server
+# Args: $1 - "open" to return at once, with $2 the files as shell words (as
+#       stored in edit bookmarks); "wait" to block until the file is closed,
+#       with $2 a file path
+# Returns: 0 if the server took the files, 1 if there is no usable server
+edit_in_editor_server() {
+    local mode="$1"
+    local target="$2"
+    local server kind socket
+    server=$(detect_editor_server) || return 1
+    IFS=$'\t' read -r kind socket <<< "$server"
+    
+    local files="$target"
+    [[ "$mode" == "open" ]] || printf -v files '%q' "$target"
+    echo -e "${GREEN}Opening in the running $kind: ${CYAN}$socket${NC}"
+    case "$kind" in
+        nvim)
+            eval "nvim --server $(printf '%q' "$socket") --remote $files" || return 1
+            [[ "$mode" == "wait" ]] || return 0
+            # Neovim has no --remote-wait; poll until no window shows the file
+            # (or the server has gone away)
+            local window
+            while window=$(nvim --server "$socket" --remote-expr "bufwinid('${target//\'/\'\'}')" 2>/dev/null) && \
+                [[ "$window" != "-1" ]]; do
+                sleep 0.2
+            done
+            ;;
+        emacs)
+            if [[ "$mode" == "wait" ]]; then
+                emacsclient -s "$socket" "$target" || return 1
+            else
+                eval "emacsclient -n -s $(printf '%q' "$socket") $files" || return 1
+            fi
+            ;;
+    esac
+}
+
+# Edit a file and return when the editing is done, in a running editor
+# server when there is one and in a new editor otherwise
+# Args: $1 - file path
+# Returns: the editor's exit status
+edit_file_and_wait() {
+    local file="$1"
+    edit_in_editor_server wait "$file" && return 0
+    local editor
+    editor=$(detect_editor)
+    "$editor" "$file"
+}
+
 #=============================================================================
 # BACKUP AND RESTORE FUNCTIONS
 #=============================================================================
 
-# Create a timestamped backup of the bookmarks file
+# Backups are content-addressed: each distinct store is kept once as
+# backups/objects/<sha256>.json (or .json.zst), and backups/manifest.tsv lists
+# the snapshots as "timestamp<TAB>sha256<TAB>generation<TAB>compression<TAB>archive"
+# lines, where archive names the object holding archive.json (omitted if none),
+# oldest first. Backing up an unchanged store adds nothing.
+BACKUP_DIR="$BOOKMARKS_DIR/backups"
+BACKUP_OBJECTS_DIR="$BACKUP_DIR/objects"
+BACKUP_MANIFEST="$BACKUP_DIR/manifest.tsv"
+
+# Compute the SHA-256 of a file
+# Args: $1 - file path
+# Returns: hex digest
+sha256_file() {
+    local digest
+    if has_capability sha256sum; then
+        digest=$(sha256sum "$1")
+    else
+        digest=$(shasum -a 256 "$1")
+    fi
+    echo "${digest%% *}"
+}
+
+# Get the path of a backup object
+# Args: $1 - sha256, $2 - compression ("zstd" or "none")
+# Returns: object file path
+backup_object_path() {
+    if [[ "$2" == "zstd" ]]; then
+        echo "$BACKUP_OBJECTS_DIR/$1.json.zst"
+    else
+        echo "$BACKUP_OBJECTS_DIR/$1.json"
+    fi
+}
+
+# Store a file as a backup object, sharing blocks with the source when possible
+# Store writes always replace bookmarks.json by rename, so a hard link keeps the
+# snapshot intact once the store moves on.
+# Args: $1 - source file, $2 - object path, $3 - compression ("zstd" or "none")
+store_backup_object() {
+    local source_file="$1"
+    local object_file="$2"
+    local compression="$3"
+    local tmp_file="$object_file.tmp.$$"
+    
+    if [[ "$compression" == "zstd" ]]; then
+        zstd -q -f "$source_file" -o "$tmp_file" && mv "$tmp_file" "$object_file"
+    elif cp --reflink=always "$source_file" "$tmp_file" 2>/dev/null \
+        || ln "$source_file" "$tmp_file" 2>/dev/null \
+        || cp "$source_file" "$tmp_file"; then
+        mv "$tmp_file" "$object_file"
+    else
+        rm -f "$tmp_file"
+        return 1
+    fi
+}
+
+# Import backups made before the manifest existed (backups/bookmarks_<date>.json)
+migrate_legacy_backups() {
+    local legacy_files=("$BACKUP_DIR"/bookmarks_*.json)
+    [[ -e "${legacy_files[0]}" ]] || return 0
+    
+    mkdir -p "$BACKUP_OBJECTS_DIR"
+    local legacy_file hash timestamp generation object_file
+    # Glob order is name order, which is chronological for these names
+    for legacy_file in "${legacy_files[@]}"; do
+        [[ "$(basename "$legacy_file")" =~ ^bookmarks_([0-9]{8}_[0-9]{6})\.json$ ]] || continue
+        timestamp="${BASH_REMATCH[1]}"
+        hash=$(sha256_file "$legacy_file")
+        generation=$(jq '.generation // 0' "$legacy_file" 2>/dev/null || echo 0)
+        object_file=$(backup_object_path "$hash" "none")
+        if [[ -f "$object_file" ]]; then
+            rm -f "$legacy_file"
+        else
+            mv "$legacy_file" "$object_file"
+        fi
+        printf '%s\t%s\t%s\t%s\n' "$timestamp" "$hash" "$generation" "none" >> "$BACKUP_MANIFEST"
+    done
+    
+    # Keep the manifest in time order when new backups were taken before the import
+    sort -t $'\t' -k1,1 -s -o "$BACKUP_MANIFEST" "$BACKUP_MANIFEST"
+}
+
+# Keep the last N manifest entries and delete objects no entry refers to
+# Args: $1 - number of snapshots to keep
+prune_backups() {
+    local retention_count="$1"
+    [[ -f "$BACKUP_MANIFEST" ]] || return 0
+    
+    local entry_count
+    entry_count=$(wc -l < "$BACKUP_MANIFEST")
+    if [[ "$entry_count" -gt "$retention_count" ]]; then
+        tail -n "$retention_count" "$BACKUP_MANIFEST" > "$BACKUP_MANIFEST.tmp.$$"
+        mv "$BACKUP_MANIFEST.tmp.$$" "$BACKUP_MANIFEST"
+    fi
+    
+    local -A referenced=()
+    local timestamp hash generation compression archive_object
+    while IFS=$'\t' read -r timestamp hash generation compression archive_object; do
+        referenced["$(basename "$(backup_object_path "$hash" "$compression")")"]=1
+        [[ -z "$archive_object" ]] || referenced["$archive_object"]=1
+    done < "$BACKUP_MANIFEST"
+    
+    # Snapshots taken for the journal stay until their entries are trimmed
+    local object_name
+    if [[ -s "$JOURNAL_FILE" ]]; then
+        while IFS= read -r object_name; do
+            referenced["$object_name"]=1
+        done < <(jq -r '.snapshots // {} | .[]' "$JOURNAL_FILE")
+    fi
+    
+    local object_file removed=0
+    for object_file in "$BACKUP_OBJECTS_DIR"/*; do
+        [[ -f "$object_file" ]] || continue
+        if [[ -z "${referenced["$(basename "$object_file")"]:-}" ]]; then
+            rm -f "$object_file"
+            removed=$((removed + 1))
+        fi
+    done
+    
+    if [[ "$removed" -gt 0 ]]; then
+        echo -e "${BLUE}Kept last $retention_count backups in ${CYAN}$BACKUP_DIR${NC}"
+    fi
+}
+
+# Create a snapshot of the bookmarks file
+# Unchanged stores are skipped; identical content is stored once. Set
+# BACKUP_COMPRESS=zstd (default when zstd is installed) or none.
 backup_bookmarks() {
-    local backup_dir="$BOOKMARKS_DIR/backups"
-    mkdir -p "$backup_dir"
+    mkdir -p "$BACKUP_OBJECTS_DIR"
+    migrate_legacy_backups
     
     # Validate JSON file before backup
     validate_bookmarks_file || {
@@ -1705,71 +5067,106 @@ backup_bookmarks() {
         return 1
     }
     
-    local timestamp
-    timestamp=$(date +"%Y%m%d_%H%M%S")
-    local backup_file="$backup_dir/bookmarks_$timestamp.json"
+    local hash
+    hash=$(sha256_file "$BOOKMARKS_FILE")
     
-    if cp "$BOOKMARKS_FILE" "$backup_file"; then
-        echo -e "${GREEN}Backup created: ${CYAN}$backup_file${NC}"
-        
-        # Clean up old backups - keep last N backups (configurable)
-        local retention_count="${BACKUP_RETENTION:-$DEFAULT_BACKUP_RETENTION}"
-        local old_backups
-        old_backups=$(ls -t "$backup_dir"/bookmarks_*.json 2>/dev/null | tail -n +$((retention_count + 1)))
-        
-        if [[ -n "$old_backups" ]]; then
-            echo "$old_backups" | xargs rm -f
-            echo -e "${BLUE}Kept last $retention_count backups in ${CYAN}$backup_dir${NC}"
+    # Archived bookmarks are kept alongside as their own object
+    local archive_object=""
+    if [[ -s "$ARCHIVE_FILE" ]]; then
+        archive_object=$(snapshot_store_file "$ARCHIVE_FILE") || {
+            echo -e "${RED}Failed to back up $ARCHIVE_FILE${NC}" >&2
+            return 1
+        }
+    fi
+    
+    local last_entry="" last_hash="" last_archive=""
+    if [[ -s "$BACKUP_MANIFEST" ]]; then
+        last_entry=$(tail -n 1 "$BACKUP_MANIFEST")
+        last_hash=$(cut -f2 <<< "$last_entry")
+        last_archive=$(cut -s -f5 <<< "$last_entry")
+    fi
+    if [[ "$hash" == "$last_hash" && "$archive_object" == "$last_archive" ]]; then
+        echo -e "${GREEN}Bookmarks unchanged since the last backup (${CYAN}$(format_backup_date "${last_entry%%$'\t'*}")${GREEN})${NC}"
+        return 0
+    fi
+    
+    local compression="${BACKUP_COMPRESS:-}"
+    if [[ -z "$compression" ]]; then
+        compression=none
+        has_capability zstd && compression=zstd
+    fi
+    if [[ "$compression" == "zstd" ]] && ! has_capability zstd; then
+        echo -e "${YELLOW}Warning: zstd not found, storing backup uncompressed${NC}" >&2
+        compression=none
+    fi
+    
+    # The same content may already be stored under either compression
+    local object_file
+    object_file=$(backup_object_path "$hash" "$compression")
+    if [[ ! -f "$object_file" ]]; then
+        local other="zstd"
+        [[ "$compression" == "zstd" ]] && other="none"
+        if [[ -f "$(backup_object_path "$hash" "$other")" ]]; then
+            compression="$other"
+            object_file=$(backup_object_path "$hash" "$other")
+        elif ! store_backup_object "$BOOKMARKS_FILE" "$object_file" "$compression"; then
+            echo -e "${RED}Failed to create backup${NC}" >&2
+            return 1
         fi
-    else
-        echo -e "${RED}Failed to create backup${NC}" >&2
-        return 1
     fi
+    
+    local timestamp
+    timestamp=$(date +"%Y%m%d_%H%M%S")
+    printf '%s\t%s\t%s\t%s%s\n' "$timestamp" "$hash" "$(get_store_generation)" "$compression" \
+        "${archive_object:+$'\t'$archive_object}" >> "$BACKUP_MANIFEST"
+    echo -e "${GREEN}Backup created: ${CYAN}$object_file${NC}"
+    
+    # Clean up old backups - keep last N backups (configurable)
+    prune_backups "${BACKUP_RETENTION:-$DEFAULT_BACKUP_RETENTION}"
 }
 
-# Format backup filename for display
-# Args: $1 - backup filename
+# Format a manifest timestamp for display
+# Args: $1 - backup timestamp (YYYYMMDD_HHMMSS)
 # Returns: formatted date string
 format_backup_date() {
-    local backup_file="$1"
-    local basename_file
-    basename_file=$(basename "$backup_file")
+    local timestamp="$1"
     
-    # Extract date components from filename
-    if [[ "$basename_file" =~ bookmarks_([0-9]{8})_([0-9]{6})\.json ]]; then
+    if [[ "$timestamp" =~ ^([0-9]{8})_([0-9]{6})$ ]]; then
         local date_part="${BASH_REMATCH[1]}"
         local time_part="${BASH_REMATCH[2]}"
         
         # Format as YYYY-MM-DD HH:MM:SS
         echo "${date_part:0:4}-${date_part:4:2}-${date_part:6:2} ${time_part:0:2}:${time_part:2:2}:${time_part:4:2}"
     else
-        echo "$basename_file"
+        echo "$timestamp"
     fi
 }
 
-# Restore bookmarks from a backup with improved validation
+# Restore bookmarks from a backup listed in the manifest
 restore_from_backup() {
-    local backup_dir="$BOOKMARKS_DIR/backups"
-    
-    if [[ ! -d "$backup_dir" ]]; then
+    if [[ ! -d "$BACKUP_DIR" ]]; then
         echo -e "${RED}No backups directory found.${NC}" >&2
         exit 1
     fi
     
-    # Get available backups sorted by modification time (newest first)
-    local backups
-    readarray -t backups < <(ls -t "$backup_dir"/bookmarks_*.json 2>/dev/null)
+    migrate_legacy_backups
+    
+    # Manifest entries, newest first
+    local backups=()
+    if [[ -f "$BACKUP_MANIFEST" ]]; then
+        readarray -t backups < <(tac "$BACKUP_MANIFEST")
+    fi
     
     if [[ ${#backups[@]} -eq 0 ]]; then
         echo -e "${RED}No backup files found.${NC}" >&2
         exit 1
     fi
     
+    local timestamp hash generation compression
     echo -e "${BLUE}Available backups:${NC}"
     for i in "${!backups[@]}"; do
-        local formatted_date
-        formatted_date=$(format_backup_date "${backups[i]}")
-        echo -e "  ${BLUE}$((i+1)))${NC} $formatted_date"
+        IFS=$'\t' read -r timestamp hash generation compression _ <<< "${backups[i]}"
+        echo -e "  ${BLUE}$((i+1)))${NC} $(format_backup_date "$timestamp")  (generation $generation)"
     done
     
     local selection="1"
@@ -1779,20 +5176,33 @@ restore_from_backup() {
     
     # Validate selection
     if [[ "$selection" =~ ^[0-9]+$ ]] && [[ "$selection" -ge 1 ]] && [[ "$selection" -le ${#backups[@]} ]]; then
-        local selected_backup="${backups[$((selection-1))]}"
+        local archive_object
+        IFS=$'\t' read -r timestamp hash generation compression archive_object <<< "${backups[$((selection-1))]}"
+        local object_file
+        object_file=$(backup_object_path "$hash" "$compression")
+        
+        local backup_json=""
+        if [[ -f "$object_file" ]]; then
+            backup_json=$(read_backup_object "$object_file" 2>/dev/null || true)
+        fi
         
-        # Validate the backup file before restoring
-        if ! jq empty "$selected_backup" 2>/dev/null; then
+        # Validate the backup before restoring
+        if [[ -z "$backup_json" ]] || ! jq empty <<< "$backup_json" 2>/dev/null; then
             echo -e "${RED}Selected backup file is corrupted or invalid${NC}" >&2
             exit 1
         fi
         
-        echo -e "${YELLOW}You are about to restore from: ${CYAN}$(basename "$selected_backup")${NC}"
+        echo -e "${YELLOW}You are about to restore from: ${CYAN}$(format_backup_date "$timestamp")${NC}"
         echo -e "${RED}This will overwrite your current bookmarks!${NC}"
         
         if get_user_confirmation "Continue? (y/n): "; then
-            if cp "$selected_backup" "$BOOKMARKS_FILE"; then
-                echo -e "${GREEN}Bookmarks restored from: ${CYAN}$(basename "$selected_backup")${NC}"
+            if commit_bookmarks_json "$backup_json" "restore-backup"; then
+                # Backups made before the archive partition carry no archive
+                if [[ -n "$archive_object" && -f "$BACKUP_OBJECTS_DIR/$archive_object" ]]; then
+                    read_backup_object "$BACKUP_OBJECTS_DIR/$archive_object" > "$ARCHIVE_FILE.tmp.$$" \
+                        && mv "$ARCHIVE_FILE.tmp.$$" "$ARCHIVE_FILE"
+                fi
+                echo -e "${GREEN}Bookmarks restored from: ${CYAN}$(format_backup_date "$timestamp")${NC}"
             else
                 echo -e "${RED}Failed to restore backup${NC}" >&2
                 exit 1
@@ -1805,21 +5215,878 @@ restore_from_backup() {
     fi
 }
 
+#=============================================================================
+# MUTATION JOURNAL AND POINT-IN-TIME RESTORE
+#=============================================================================
+
+# commit_bookmarks_stream appends one line per generation to journal.jsonl:
+#   {"generation","op","timestamp","ids","before":[...],"after":[...]}
+# holding the affected records on both sides of the write. Whole-store writes
+# (restore-backup, restore) reference snapshots in backups/objects instead.
+# migrate and rescore writes only touch default or derived fields and carry
+# no records; a rescore that ages access counts is committed as "age" and
+# references snapshots like other whole-store writes. `restore --at` rewinds
+# entries from the current store (or replays them from the nearest backup),
+# and `undo` reverts the latest operations.
+
+# jq helpers shared by the rewind, replay and undo programs
+readonly JOURNAL_JQ_DEFS='
+def by_id: reduce .[] as $r ({}; .[$r.id] = $r);
+def stats: {access_count, last_accessed, frecency_score, usage, runs} | with_entries(select(.value != null));
+# Set the records named in $ids to $records: replace in place, drop missing, append new
+def apply_records($ids; $records):
+    ($records | by_id) as $new
+    | (reduce $ids[] as $i ({}; .[$i] = true)) as $touched
+    | (reduce .bookmarks[] as $r ({}; .[$r.id] = true)) as $present
+    | .bookmarks = ([.bookmarks[] | if $touched[.id] then $new[.id] else . end | select(. != null)]
+        + [$records[] | select($present[.id] | not)]);
+'
+
+# Append the journal entry for a store write
+# Args: $1 - generation, $2 - operation, $3 - JSON array of IDs, $4 - file with the new store
+# Returns: 0 on success, 1 if the entry could not be written
+append_journal_entry() {
+    local generation="$1"
+    local operation="$2"
+    local ids_json="$3"
+    local new_file="$4"
+    
+    [[ "$JOURNAL_FILE" != "/dev/null" ]] || return 0
+    
+    local extra="$JOURNAL_EXTRA"
+    local records_file="$JOURNAL_RECORDS_FILE"
+    JOURNAL_EXTRA="{}"
+    JOURNAL_RECORDS_FILE=""
+    
+    if [[ "${ids_json//[[:space:]]/}" == '["*"]' ]]; then
+        case "$operation" in
+            migrate|rescore)
+                jq -nc --argjson generation "$generation" --arg op "$operation" \
+                    --argjson timestamp "$EPOCHSECONDS" --argjson extra "$extra" \
+                    '{generation: $generation, op: $op, timestamp: $timestamp, ids: ["*"]} + $extra' \
+                    >> "$JOURNAL_FILE"
+                return
+                ;;
+        esac
+        
+        local before_object after_object
+        before_object=$(snapshot_store_file "$BOOKMARKS_FILE") || return 1
+        after_object=$(snapshot_store_file "$new_file") || return 1
+        jq -nc --argjson generation "$generation" --arg op "$operation" \
+            --argjson timestamp "$EPOCHSECONDS" --argjson extra "$extra" \
+            --arg before "$before_object" --arg after "$after_object" \
+            '{generation: $generation, op: $op, timestamp: $timestamp, ids: ["*"],
+              snapshots: {before: $before, after: $after}} + $extra' >> "$JOURNAL_FILE"
+        return
+    fi
+    
+    if [[ -n "$records_file" ]]; then
+        jq -c --argjson generation "$generation" --arg op "$operation" \
+            --argjson timestamp "$EPOCHSECONDS" --argjson ids "$ids_json" --argjson extra "$extra" '
+            {generation: $generation, op: $op, timestamp: $timestamp, ids: $ids,
+             before: .before, after: .after} + $extra
+        ' "$records_file" >> "$JOURNAL_FILE"
+        return
+    fi
+    
+    jq -nc --slurpfile old "$BOOKMARKS_FILE" --slurpfile new "$new_file" \
+        --argjson generation "$generation" --arg op "$operation" \
+        --argjson timestamp "$EPOCHSECONDS" --argjson ids "$ids_json" --argjson extra "$extra" '
+        (reduce $ids[] as $i ({}; .[$i] = true)) as $want
+        | {generation: $generation, op: $op, timestamp: $timestamp, ids: $ids,
+           before: [$old[0].bookmarks[] | select($want[.id])],
+           after: [$new[0].bookmarks[] | select($want[.id])]} + $extra
+    ' >> "$JOURNAL_FILE"
+}
+
+# Keep a store file in the backup object store, reusing an existing object
+# Uncompressed objects are hard links where possible, so this is cheap
+# Args: $1 - store file
+# Returns: object file name (relative to backups/objects)
+snapshot_store_file() {
+    local hash object_file
+    hash=$(sha256_file "$1")
+    object_file=$(backup_object_path "$hash" zstd)
+    if [[ ! -f "$object_file" ]]; then
+        object_file=$(backup_object_path "$hash" none)
+        if [[ ! -f "$object_file" ]]; then
+            mkdir -p "$BACKUP_OBJECTS_DIR"
+            store_backup_object "$1" "$object_file" none || return 1
+        fi
+    fi
+    basename "$object_file"
+}
+
+# Print the contents of a backup object, decompressing if needed
+# Args: $1 - object file path
+read_backup_object() {
+    if [[ "$1" == *.zst ]]; then
+        zstd -q -dc "$1"
+    else
+        cat "$1"
+    fi
+}
+
+# Drop the oldest journal entries beyond the limit
+# Args: $1 - maximum number of entries to keep
+trim_journal() {
+    local max_entries="$1"
+    [[ -f "$JOURNAL_FILE" ]] || return 0
+    local line_count
+    line_count=$(wc -l < "$JOURNAL_FILE")
+    [[ "$line_count" -gt "$max_entries" ]] || return 0
+    
+    tail -n "$max_entries" "$JOURNAL_FILE" > "$JOURNAL_FILE.tmp.$$" \
+        && mv "$JOURNAL_FILE.tmp.$$" "$JOURNAL_FILE"
+}
+
+# Resolve a restore point to a store generation
+# Args: $1 - generation number, epoch seconds, or a date understood by `date -d`
+# Returns: generation on stdout; 1 if the point cannot be parsed
+resolve_restore_point() {
+    local point="$1"
+    
+    # Small numbers are generations; anything else is a point in time
+    if [[ "$point" =~ ^[0-9]+$ ]] && [[ ${#point} -lt 10 ]]; then
+        echo "$point"
+        return
+    fi
+    
+    local epoch
+    if [[ "$point" =~ ^[0-9]+$ ]]; then
+        epoch="$point"
+    elif ! epoch=$(date -d "$point" +%s 2>/dev/null); then
+        return 1
+    fi
+    
+    # Latest generation written at or before that time
+    jq -n --argjson t "$epoch" --argjson current "$(get_store_generation)" '
+        [inputs | {generation, timestamp}] as $entries
+        | ([$entries[] | select(.timestamp <= $t) | .generation] | max)
+          // (($entries[0].generation // ($current + 1)) - 1)
+    ' "$JOURNAL_FILE"
+}
+
+# Rebuild the store as it was at a generation
+# Rewinds journal entries from the current store when the journal reaches back
+# far enough, otherwise replays them forward from the newest older backup
+# Args: $1 - target generation
+# Returns: the rebuilt store on stdout; 1 if history does not cover the target
+build_store_at_generation() {
+    local target="$1"
+    local entries_file
+    entries_file=$(mktemp)
+    
+    local oldest
+    oldest=$(head -n 1 "$JOURNAL_FILE" | jq '.first_generation // .generation')
+    
+    if [[ "$oldest" -le $((target + 1)) ]]; then
+        jq -c --argjson t "$target" 'select(.generation > $t)' "$JOURNAL_FILE" > "$entries_file"
+        
+        # A whole-store write newer than the target gives its "before" state directly
+        local snapshot_gen snapshot_object base_file="$BOOKMARKS_FILE"
+        read -r snapshot_gen snapshot_object < <(jq -rn '
+            [inputs | select(.snapshots)] | min_by(.generation) // empty
+            | "\(.generation) \(.snapshots.before)"' "$entries_file") || true
+        if [[ -n "${snapshot_gen:-}" ]]; then
+            base_file=$(mktemp)
+            read_backup_object "$BACKUP_OBJECTS_DIR/$snapshot_object" > "$base_file"
+        fi
+        
+        jq --slurpfile entries "$entries_file" --argjson stop "${snapshot_gen:-0}" "$JOURNAL_JQ_DEFS"'
+            reduce ($entries | map(select($stop == 0 or .generation < $stop))
+                    | sort_by(-.generation)[] | select(.before)) as $e
+                (.; apply_records($e.ids; $e.before))
+        ' "$base_file"
+        local status=$?
+        [[ "$base_file" == "$BOOKMARKS_FILE" ]] || rm -f "$base_file"
+        rm -f "$entries_file"
+        return $status
+    fi
+    
+    # Journal was trimmed past the target: start from a backup and replay forward
+    local backup_entry=""
+    if [[ -f "$BACKUP_MANIFEST" ]]; then
+        backup_entry=$(awk -F'\t' -v t="$target" -v o="$oldest" \
+            '$3 <= t && $3 + 1 >= o { entry = $0 } END { print entry }' "$BACKUP_MANIFEST")
+    fi
+    if [[ -z "$backup_entry" ]]; then
+        rm -f "$entries_file"
+        return 1
+    fi
+    
+    local timestamp hash generation compression
+    IFS=$'\t' read -r timestamp hash generation compression _ <<< "$backup_entry"
+    jq -c --argjson from "$generation" --argjson t "$target" \
+        'select(.generation > $from and .generation <= $t)' "$JOURNAL_FILE" > "$entries_file"
+    
+    local base_file
+    base_file=$(mktemp)
+    read_backup_object "$(backup_object_path "$hash" "$compression")" > "$base_file"
+    
+    local snapshot_gen snapshot_object
+    read -r snapshot_gen snapshot_object < <(jq -rn '
+        [inputs | select(.snapshots)] | max_by(.generation) // empty
+        | "\(.generation) \(.snapshots.after)"' "$entries_file") || true
+    if [[ -n "${snapshot_gen:-}" ]]; then
+        read_backup_object "$BACKUP_OBJECTS_DIR/$snapshot_object" > "$base_file"
+    fi
+    
+    jq --slurpfile entries "$entries_file" --argjson start "${snapshot_gen:-0}" "$JOURNAL_JQ_DEFS"'
+        reduce ($entries | map(select(.generation > $start)) | sort_by(.generation)[]
+                | select(.after)) as $e
+            (.; apply_records($e.ids; $e.after))
+    ' "$base_file"
+    local status=$?
+    rm -f "$base_file" "$entries_file"
+    return $status
+}
+
+# Restore the store to a generation or point in time
+# Args: $1 - generation, epoch seconds, or date string
+restore_to_point() {
+    local point="$1"
+    
+    if [[ -z "$point" ]]; then
+        echo -e "${RED}Usage: $0 restore --at <generation|time>${NC}" >&2
+        exit 1
+    fi
+    if [[ ! -s "$JOURNAL_FILE" ]]; then
+        echo -e "${RED}No journal found; nothing to restore from${NC}" >&2
+        exit 1
+    fi
+    
+    local target current
+    if ! target=$(resolve_restore_point "$point"); then
+        echo -e "${RED}Cannot parse restore point: $point${NC}" >&2
+        exit 1
+    fi
+    current=$(get_store_generation)
+    
+    if [[ "$target" -ge "$current" ]]; then
+        echo -e "${GREEN}Bookmarks are already at generation $current${NC}"
+        return 0
+    fi
+    
+    local restored_file
+    restored_file=$(mktemp)
+    if ! build_store_at_generation "$target" > "$restored_file"; then
+        rm -f "$restored_file"
+        echo -e "${RED}History does not reach back to generation $target${NC}" >&2
+        exit 1
+    fi
+    
+    echo -e "${YELLOW}Rewinding $((current - target)) generations to generation ${CYAN}$target${NC}"
+    if get_user_confirmation "Continue? (y/n): "; then
+        if commit_bookmarks_stream "restore" < "$restored_file"; then
+            echo -e "${GREEN}Bookmarks restored to generation ${CYAN}$target${NC}"
+        else
+            rm -f "$restored_file"
+            echo -e "${RED}Failed to restore bookmarks${NC}" >&2
+            exit 1
+        fi
+    else
+        echo -e "${YELLOW}Restore cancelled.${NC}"
+    fi
+    rm -f "$restored_file"
+}
+
+# Revert the most recent operations
+# Access counts and scores recorded since are kept. Bookkeeping writes
+# (access, rescore, age, migrate, overlay, unarchive) and earlier undos are not counted.
+# Args: $1 - number of operations to undo (default 1)
+undo_operations() {
+    local count="${1:-1}"
+    
+    if ! [[ "$count" =~ ^[1-9][0-9]*$ ]]; then
+        echo -e "${RED}Usage: $0 undo [N]${NC}" >&2
+        exit 1
+    fi
+    
+    # The reverted store keeps current access counts, so read it under the lock
+    [[ "$STORE_LOCK_HELD" == "true" ]] || { with_store_lock undo_operations "$@"; return; }
+    
+    local entries_file
+    entries_file=$(mktemp)
+    if [[ -s "$JOURNAL_FILE" ]]; then
+        jq -cn --argjson n "$count" '
+            [inputs] as $all
+            | ([$all[] | .undoes // [] | .[]] | map({(tostring): true}) | add // {}) as $undone
+            | [$all[] | select((.op | IN("access", "rescore", "age", "migrate", "overlay", "unarchive", "undo") | not)
+                                and ($undone[.generation | tostring] | not))]
+            | reverse | .[:$n][]
+        ' "$JOURNAL_FILE" > "$entries_file"
+    fi
+    
+    if [[ ! -s "$entries_file" ]]; then
+        rm -f "$entries_file"
+        echo -e "${YELLOW}Nothing to undo${NC}"
+        return 0
+    fi
+    
+    # Revert newest first so each entry sees the state it produced
+    local store_file ids_file entry
+    store_file=$(mktemp)
+    ids_file=$(mktemp)
+    cp "$BOOKMARKS_FILE" "$store_file"
+    while IFS= read -r entry; do
+        local snapshot_object
+        snapshot_object=$(jq -r '.snapshots.before // empty' <<< "$entry")
+        if [[ -n "$snapshot_object" ]]; then
+            # Whole-store write: go back to its snapshot, keeping current stats
+            read_backup_object "$BACKUP_OBJECTS_DIR/$snapshot_object" \
+                | jq --slurpfile cur "$store_file" "$JOURNAL_JQ_DEFS"'
+                    ($cur[0].bookmarks | map({key: .id, value: stats}) | from_entries) as $s
+                    | .bookmarks |= map(. + ($s[.id] // {}))
+                ' > "$store_file.next"
+            echo '"*"' >> "$ids_file"
+        else
+            jq --argjson e "$entry" "$JOURNAL_JQ_DEFS"'
+                (reduce .bookmarks[] as $r ({}; .[$r.id] = ($r | stats))) as $s
+                | apply_records($e.ids; [$e.before[] | . + ($s[.id] // {})])
+            ' "$store_file" > "$store_file.next"
+            jq -c '.ids[]' <<< "$entry" >> "$ids_file"
+        fi
+        mv "$store_file.next" "$store_file"
+    done < "$entries_file"
+    
+    local ids_json generations summary
+    ids_json=$(jq -sc 'if index("*") then ["*"] else unique end' "$ids_file")
+    generations=$(jq -sc 'map(.generation)' "$entries_file")
+    summary=$(jq -r '"  \(.op) (generation \(.generation)): \(
+        [(.before // []) + (.after // []) | .[].description] | unique | join(", ")
+        | if . == "" then "all bookmarks" else . end)"' "$entries_file")
+    
+    JOURNAL_EXTRA=$(jq -nc --argjson g "$generations" '{undoes: $g}')
+    if commit_bookmarks_stream "undo" "$ids_json" < "$store_file"; then
+        echo -e "${GREEN}Undid:${NC}"
+        echo "$summary"
+    else
+        echo -e "${RED}Failed to undo${NC}" >&2
+        rm -f "$store_file" "$ids_file" "$entries_file"
+        exit 1
+    fi
+    rm -f "$store_file" "$ids_file" "$entries_file"
+}
+
+#=============================================================================
+# STORE MAINTENANCE
+#=============================================================================
+
+# `bookmark maintain` does the housekeeping that would otherwise slow down
+# everyday commands, in one locked pass that is safe to run from cron or a
+# systemd timer. Each phase reports what it changed and how long it took.
+
+# Microseconds since the epoch, from the bash clock (no subprocess)
+now_microseconds() {
+    local now="$EPOCHREALTIME"
+    echo "${now/[.,]/}"
+}
+
+# Print one line of the maintenance report
+# Args: $1 - phase name, $2 - summary, $3 - phase start in microseconds
+report_maintenance_phase() {
+    local elapsed_ms=$(( ($(now_microseconds) - $3) / 1000 ))
+    printf "  ${CYAN}%-10s${NC} %-58s ${BLUE}%6d ms${NC}\n" "$1" "$2" "$elapsed_ms"
+}
+
+# Retire bookmarks by age: mark unused ones obsolete and move obsolete ones
+# still in the store to the archive
+# Args: $1 - days unused before a bookmark is marked obsolete (0 disables),
+#       $2 - days unused before an obsolete bookmark is archived
+# Returns: summary line on stdout
+apply_retention_policies() {
+    [[ "$STORE_LOCK_HELD" == "true" ]] || { with_store_lock apply_retention_policies "$@"; return; }
+    
+    local obsolete_days="$1"
+    local archive_days="$2"
+    
+    # Dates are stored as local "YYYY-MM-DD HH:MM:SS", so cut-offs compare as strings
+    local obsolete_before="" archive_before
+    if [[ "$obsolete_days" -gt 0 ]]; then
+        obsolete_before=$(date -d "-$obsolete_days days" +"%Y-%m-%d %H:%M:%S")
+    fi
+    archive_before=$(date -d "-$archive_days days" +"%Y-%m-%d %H:%M:%S")
+    
+    # Line 1: IDs marked obsolete, line 2: IDs to archive, line 3: updated store
+    local result_file
+    result_file=$(mktemp)
+    jq -c --arg obsolete_before "$obsolete_before" --arg archive_before "$archive_before" '
+        def last_used: .last_accessed // .modified // .created // "";
+        # Records without any date (imports, older stores) are never retired
+        def personal: .overlay == null and .layer == null and last_used != "";
+        [.bookmarks[] | select(personal and .status != "obsolete" and $obsolete_before != ""
+            and last_used < $obsolete_before) | .id] as $expired
+        | (reduce $expired[] as $i ({}; .[$i] = true)) as $expiring
+        | .bookmarks |= map(if $expiring[.id] then .status = "obsolete" else . end)
+        | [.bookmarks[] | select(personal and .status == "obsolete" and last_used <= $archive_before) | .id] as $archived
+        | $expired, $archived, .
+    ' "$BOOKMARKS_FILE" > "$result_file" || { rm -f "$result_file"; return 1; }
+    
+    local expired archived
+    { read -r expired; read -r archived; } < "$result_file"
+    
+    if [[ "$expired" != "[]" || "$archived" != "[]" ]]; then
+        local ids_json
+        ids_json=$(jq -nc --argjson a "$expired" --argjson b "$archived" '$a + $b | unique')
+        sed -n 3p "$result_file" | archive_obsolete_records "$archive_before" \
+            | commit_bookmarks_stream "maintain" "$ids_json" || { rm -f "$result_file"; return 1; }
+    fi
+    rm -f "$result_file"
+    
+    echo "$(jq 'length' <<< "$expired") marked obsolete, $(jq 'length' <<< "$archived") archived"
+}
+
+# Compact the journal and change log
+# Rescore and migrate entries without records or snapshots are dropped; consecutive
+# access entries for the same bookmark are merged into one that spans their
+# generations. Both files are then trimmed to their limits
+# Returns: summary line on stdout
+compact_journal() {
+    local lock_file="$BOOKMARKS_DIR/.store.lock"
+    if ! try_lock "$lock_file" 10; then
+        echo "skipped (store is busy)"
+        return 0
+    fi
+    
+    local before_lines=0 after_lines=0
+    if [[ -s "$JOURNAL_FILE" ]]; then
+        before_lines=$(wc -l < "$JOURNAL_FILE")
+        if jq -cn '
+            reduce (inputs | select(.ids != ["*"] or .snapshots)) as $e ([];
+                (length - 1) as $last
+                | if $last >= 0 and $e.op == "access" and .[$last].op == "access" and .[$last].ids == $e.ids
+                  then .[$last] |= . + {generation: $e.generation, timestamp: $e.timestamp, after: $e.after,
+                                        first_generation: (.first_generation // .generation)}
+                  else . + [$e] end)
+            | .[]
+        ' "$JOURNAL_FILE" > "$JOURNAL_FILE.tmp.$$"; then
+            mv "$JOURNAL_FILE.tmp.$$" "$JOURNAL_FILE"
+        else
+            rm -f "$JOURNAL_FILE.tmp.$$"
+        fi
+        trim_journal "${JOURNAL_MAX_ENTRIES:-$DEFAULT_JOURNAL_MAX_ENTRIES}"
+        after_lines=$(wc -l < "$JOURNAL_FILE")
+    fi
+    
+    local log_before=0 log_after=0
+    if [[ -s "$CHANGE_LOG_FILE" ]]; then
+        log_before=$(wc -l < "$CHANGE_LOG_FILE")
+        trim_change_log "${CHANGE_LOG_MAX_ENTRIES:-$DEFAULT_CHANGE_LOG_MAX_ENTRIES}"
+        log_after=$(wc -l < "$CHANGE_LOG_FILE")
+    fi
+    
+    release_lock "$lock_file"
+    echo "journal $before_lines -> $after_lines entries, change log $log_before -> $log_after lines"
+}
+
+# Rebuild derived data: capability cache, layer caches, frecency scores,
+# the context index, and sync state for peers that no longer exist
+# Returns: summary line on stdout
+rebuild_caches() {
+    local -a rebuilt=()
+    
+    probe_capabilities
+    rebuilt+=("capabilities")
+    
+    if [[ ${#BOOKMARK_LAYERS[@]} -gt 0 ]]; then
+        build_shared_layer_cache && build_bookmarks_view && rebuilt+=("layer view")
+    fi
+    
+    if recalculate_all_frecency 2>> "$FRECENCY_ERROR_LOG" > /dev/null; then
+        rebuilt+=("frecency scores")
+    else
+        rebuilt+=("frecency scores FAILED (see $(basename "$FRECENCY_ERROR_LOG"))")
+    fi
+    
+    local live_ids=""
+    if [[ -d "$CONTEXT_DIR" || -d "$OUTPUT_CACHE_DIR" ]]; then
+        live_ids=$(merge_archive_json "$BOOKMARKS_VIEW_FILE" "$ARCHIVE_FILE" | jq -c '[.bookmarks[].id]')
+    fi
+    
+    if [[ -d "$CONTEXT_DIR" ]]; then
+        local contexts_removed
+        contexts_removed=$(prune_context_index "$live_ids")
+        rebuilt+=("context index ($contexts_removed stale contexts removed)")
+    fi
+    
+    if [[ -d "$OUTPUT_CACHE_DIR" ]]; then
+        local outputs_removed
+        outputs_removed=$(prune_output_cache "$live_ids")
+        rebuilt+=("output cache ($outputs_removed stale outputs removed)")
+    fi
+    
+    local state_file peer_path removed=0
+    for state_file in "$SYNC_DIR"/*.state; do
+        [[ -f "$state_file" ]] || continue
+        IFS=$'\t' read -r _ _ peer_path < "$state_file"
+        if [[ -n "$peer_path" && ! -e "$peer_path" ]]; then
+            rm -f "$state_file" "${state_file%.state}.base"
+            removed=$((removed + 1))
+        fi
+    done
+    [[ "$removed" -eq 0 ]] || rebuilt+=("$removed stale sync states removed")
+    
+    local summary="" item
+    for item in "${rebuilt[@]}"; do
+        summary+="${summary:+, }$item"
+    done
+    echo "$summary"
+}
+
+# Rotate the logs kept in the bookmarks directory
+# Returns: summary line on stdout
+rotate_logs() {
+    local max_bytes="${LOG_MAX_BYTES:-$DEFAULT_LOG_MAX_BYTES}"
+    local log_file rotated=()
+    for log_file in "$FRECENCY_ERROR_LOG" "$HOOK_LOG_FILE"; do
+        rotate_log "$log_file" "$max_bytes" && rotated+=("$(basename "$log_file")")
+    done
+    local pruned summary
+    pruned=$(prune_access_history "${HISTORY_RETENTION_DAYS:-$DEFAULT_HISTORY_RETENTION_DAYS}")
+    if [[ ${#rotated[@]} -eq 0 ]]; then
+        summary="nothing to rotate"
+    else
+        summary="rotated ${rotated[*]}"
+    fi
+    echo "$summary, $pruned history days pruned"
+}
+
+# Run every maintenance phase under the maintenance lock
+maintain_store() {
+    local lock_file="$BOOKMARKS_DIR/.maintain.lock"
+    if ! try_lock "$lock_file" 0; then
+        echo -e "${YELLOW}Maintenance is already running; skipped${NC}"
+        return 0
+    fi
+    
+    validate_bookmarks_file || { release_lock "$lock_file"; exit 1; }
+    
+    echo -e "${BLUE}Maintaining ${CYAN}$BOOKMARKS_DIR${NC}"
+    touch "$BACKGROUND_MAINTENANCE_STAMP"
+    local started phase_start summary
+    started=$(now_microseconds)
+    
+    phase_start=$(now_microseconds)
+    summary=$(apply_retention_policies \
+        "${MAINTAIN_OBSOLETE_AFTER_DAYS:-$DEFAULT_MAINTAIN_OBSOLETE_AFTER_DAYS}" \
+        "${MAINTAIN_ARCHIVE_AFTER_DAYS:-$DEFAULT_MAINTAIN_ARCHIVE_AFTER_DAYS}") || summary="FAILED"
+    report_maintenance_phase "retention" "$summary" "$phase_start"
+    
+    phase_start=$(now_microseconds)
+    summary=$(compact_journal)
+    report_maintenance_phase "journal" "$summary" "$phase_start"
+    
+    phase_start=$(now_microseconds)
+    summary=$(rebuild_caches)
+    report_maintenance_phase "caches" "$summary" "$phase_start"
+    
+    phase_start=$(now_microseconds)
+    summary=$(rotate_logs)
+    report_maintenance_phase "logs" "$summary" "$phase_start"
+    
+    phase_start=$(now_microseconds)
+    summary="no backups"
+    if [[ -d "$BACKUP_DIR" ]]; then
+        mkdir -p "$BACKUP_OBJECTS_DIR"
+        local objects_before objects_after
+        objects_before=$(find "$BACKUP_OBJECTS_DIR" -type f | wc -l)
+        migrate_legacy_backups
+        prune_backups "${BACKUP_RETENTION:-$DEFAULT_BACKUP_RETENTION}" > /dev/null
+        objects_after=$(find "$BACKUP_OBJECTS_DIR" -type f | wc -l)
+        summary="$((objects_before - objects_after)) objects removed, $objects_after kept"
+    fi
+    report_maintenance_phase "backups" "$summary" "$phase_start"
+    
+    release_lock "$lock_file"
+    echo -e "${GREEN}Maintenance finished in $(( ($(now_microseconds) - started) / 1000 )) ms${NC}"
+}
+
+# Background maintenance is debounced. Rather than rescoring after every
+# execution, the first invocation after the interval has passed claims the
+# slot by touching a stamp file and starts a single detached run; everything
+# else only pays for one stat of the stamp.
+
+# Seconds since a file was last modified
+# Args: $1 - file path
+# Returns: age in seconds on stdout, or nothing if the file does not exist
+file_age_seconds() {
+    local mtime
+    # Linux uses stat -c %Y, macOS uses stat -f %m
+    mtime=$(stat -c %Y "$1" 2>/dev/null || stat -f %m "$1" 2>/dev/null) || return 0
+    echo $(( $(date +%s) - mtime ))
+}
+
+# Rescore and compact the journal under the maintenance lock
+# Output and errors go to the frecency error log, rotated before each run
+run_background_maintenance() {
+    rotate_log "$FRECENCY_ERROR_LOG" "${LOG_MAX_BYTES:-$DEFAULT_LOG_MAX_BYTES}" || true
+    {
+        local lock_file="$BOOKMARKS_DIR/.maintain.lock"
+        try_lock "$lock_file" 0 || return 0
+        echo "[$(date '+%Y-%m-%d %H:%M:%S')] background maintenance started"
+        recalculate_all_frecency > /dev/null || echo "frecency recalculation failed"
+        echo "journal: $(compact_journal)"
+        release_lock "$lock_file"
+    } >> "$FRECENCY_ERROR_LOG" 2>&1
+}
+
+# Start background maintenance if the interval has passed since the last run
+# The first invocation in a fresh directory only starts the clock
+schedule_background_maintenance() {
+    local interval="${BACKGROUND_MAINTENANCE_INTERVAL:-$DEFAULT_BACKGROUND_MAINTENANCE_INTERVAL}"
+    [[ "$interval" -gt 0 && -f "$BOOKMARKS_FILE" ]] || return 0
+    
+    local age
+    age=$(file_age_seconds "$BACKGROUND_MAINTENANCE_STAMP")
+    if [[ -z "$age" ]]; then
+        touch "$BACKGROUND_MAINTENANCE_STAMP"
+        return 0
+    fi
+    [[ "$age" -ge "$interval" ]] || return 0
+    
+    # Claim the slot so concurrent invocations do not all start a run
+    local lock_file="$BACKGROUND_MAINTENANCE_STAMP.lock"
+    try_lock "$lock_file" 0 || return 0
+    age=$(file_age_seconds "$BACKGROUND_MAINTENANCE_STAMP")
+    if [[ "${age:-0}" -lt "$interval" ]]; then
+        release_lock "$lock_file"
+        return 0
+    fi
+    touch "$BACKGROUND_MAINTENANCE_STAMP"
+    release_lock "$lock_file"
+    
+    (run_background_maintenance < /dev/null > /dev/null 2>&1 &)
+}
+
 #=============================================================================
 # HOOK SYSTEM
 #=============================================================================
 
-# Execute a hook script if it exists
+# Hooks run asynchronously by default: run_hook drops an event into a spool
+# directory and a detached worker drains it. Bursts of events for the same
+# hook are coalesced into a single run. --sync-hooks restores foreground runs.
+HOOK_SPOOL_DIR="$BOOKMARKS_DIR/.hook_spool"
+HOOK_LOG_FILE="$BOOKMARKS_DIR/hooks.log"
+
+# List the executables that make up a hook: <hook>.sh, then hooks/<hook>.d/*
 # Args: $1 - hook name (without .sh extension)
-run_hook() {
+# Returns: script paths, one per line
+list_hook_scripts() {
     local hook_name="$1"
     local hook_script="$BOOKMARKS_DIR/hooks/$hook_name.sh"
     
     if [[ -f "$hook_script" ]] && [[ -x "$hook_script" ]]; then
-        echo -e "${BLUE}Running hook: ${CYAN}$hook_name${NC}"
-        if ! bash "$hook_script" "$BOOKMARKS_DIR" "$BOOKMARKS_FILE"; then
-            echo -e "${YELLOW}Warning: Hook $hook_name failed${NC}" >&2
+        echo "$hook_script"
+    fi
+    
+    local script
+    for script in "$BOOKMARKS_DIR/hooks/$hook_name.d"/*; do
+        if [[ -f "$script" ]] && [[ -x "$script" ]]; then
+            echo "$script"
+        fi
+    done
+}
+
+# Check whether any script is installed for a hook
+# An empty or non-executable <hook>.d/ does not count, so no event is spooled
+# Args: $1 - hook name (without .sh extension)
+# Returns: 0 if the hook has at least one executable script
+hook_exists() {
+    local hook_name="$1"
+    local hook_script="$BOOKMARKS_DIR/hooks/$hook_name.sh"
+    
+    [[ -f "$hook_script" && -x "$hook_script" ]] && return 0
+    
+    local script
+    for script in "$BOOKMARKS_DIR/hooks/$hook_name.d"/*; do
+        [[ -f "$script" && -x "$script" ]] && return 0
+    done
+    return 1
+}
+
+# Build the JSON event describing the last recorded mutation
+# Args: $1 - hook name
+# Returns: single-line JSON object
+build_hook_event() {
+    local hook_name="$1"
+    jq -nc \
+        --arg event "$hook_name" \
+        --arg operation "$MUTATION_OP" \
+        --argjson ids "$MUTATION_IDS" \
+        --argjson before "$MUTATION_BEFORE" \
+        --argjson after "$MUTATION_AFTER" \
+        --argjson generation "$(get_store_generation)" \
+        --arg timestamp "$(date +"%Y-%m-%d %H:%M:%S")" \
+        '{event: $event, operation: $operation, ids: $ids, before: $before, after: $after, generation: $generation, timestamp: $timestamp}'
+}
+
+# Run every script of a hook with the event stream on stdin
+# Scripts from hooks/<hook>.d/ run in parallel with each other and <hook>.sh.
+# <hook>.sh is run with bash as it always was; .d entries are executed
+# directly, so any shebang or native executable works. Each script gets the
+# JSON events on stdin, one per line, and is limited by
+# HOOK_TIMEOUT_<hook_name>, then HOOK_TIMEOUT, then the default.
+# Args: $1 - hook name, $2 - number of coalesced events (default 1)
+# Returns: 0 if every script succeeded, 1 otherwise
+run_hook_now() {
+    local hook_name="$1"
+    local event_count="${2:-1}"
+    local timeout_var="HOOK_TIMEOUT_$hook_name"
+    local hook_timeout="${!timeout_var:-${HOOK_TIMEOUT:-$DEFAULT_HOOK_TIMEOUT}}"
+    
+    # Every script reads the same events, so buffer stdin once
+    local payload_file
+    payload_file=$(mktemp "${TMPDIR:-/tmp}/bookmark_hook_XXXXXX")
+    cat > "$payload_file"
+    
+    local -a scripts=() pids=()
+    readarray -t scripts < <(list_hook_scripts "$hook_name")
+    
+    local script
+    local -a command=()
+    for script in "${scripts[@]}"; do
+        command=("$script")
+        [[ "$script" == "$BOOKMARKS_DIR/hooks/$hook_name.sh" ]] && command=(bash "$script")
+        if has_capability timeout; then
+            BOOKMARKS_HOOK_EVENT_COUNT="$event_count" \
+                timeout "$hook_timeout" "${command[@]}" "$BOOKMARKS_DIR" "$BOOKMARKS_FILE" < "$payload_file" &
+        else
+            BOOKMARKS_HOOK_EVENT_COUNT="$event_count" \
+                "${command[@]}" "$BOOKMARKS_DIR" "$BOOKMARKS_FILE" < "$payload_file" &
+        fi
+        pids+=("$!")
+    done
+    
+    local i status result=0
+    for i in "${!pids[@]}"; do
+        status=0
+        wait "${pids[i]}" || status=$?
+        if [[ "$status" -eq 124 ]]; then
+            echo -e "${YELLOW}Warning: Hook $(basename "${scripts[i]}") timed out after ${hook_timeout}s${NC}" >&2
+            result=1
+        elif [[ "$status" -ne 0 ]]; then
+            echo -e "${YELLOW}Warning: Hook $(basename "${scripts[i]}") failed${NC}" >&2
+            result=1
         fi
+    done
+    
+    rm -f "$payload_file"
+    return "$result"
+}
+
+# Drain the hook spool, running each hook once per burst of events
+# Only one worker runs at a time; the spool is re-checked after the lock is
+# released so an event queued during shutdown is never stranded
+process_hook_queue() {
+    local lock_file="$HOOK_SPOOL_DIR/.lock"
+    local events
+
+    while true; do
+        try_lock "$lock_file" || return 0
+
+        while true; do
+            # Give a burst of events time to land before taking a batch
+            sleep "${HOOK_COALESCE_DELAY:-$DEFAULT_HOOK_COALESCE_DELAY}"
+
+            events=("$HOOK_SPOOL_DIR"/*.event)
+            [[ -e "${events[0]}" ]] || break
+
+            # Group event files by hook name (file name: <time>_<pid>.<hook>.event)
+            local -A batches=()
+            local event hook_name
+            for event in "${events[@]}"; do
+                hook_name="${event%.event}"
+                hook_name="${hook_name##*.}"
+                batches["$hook_name"]+="$event"$'\n'
+            done
+
+            for hook_name in "${!batches[@]}"; do
+                local -a batch_files=()
+                readarray -t batch_files <<< "${batches[$hook_name]%$'\n'}"
+
+                if hook_exists "$hook_name"; then
+                    echo "[$(date +"%Y-%m-%d %H:%M:%S")] Running hook: $hook_name (${#batch_files[@]} event(s))"
+                    cat "${batch_files[@]}" | run_hook_now "$hook_name" "${#batch_files[@]}" || true
+                fi
+                rm -f "${batch_files[@]}"
+            done
+            unset batches
+        done
+
+        release_lock "$lock_file"
+
+        events=("$HOOK_SPOOL_DIR"/*.event)
+        [[ -e "${events[0]}" ]] || return 0
+    done
+}
+
+# Queue a hook event, or run the hook immediately with --sync-hooks
+# Hooks only fire when this invocation actually changed the store
+# Args: $1 - hook name (without .sh extension)
+run_hook() {
+    local hook_name="$1"
+    
+    [[ -n "$MUTATION_OP" ]] || return 0
+    hook_exists "$hook_name" || return 0
+    
+    if [[ "$SYNC_HOOKS" == "true" ]]; then
+        echo -e "${BLUE}Running hook: ${CYAN}$hook_name${NC}"
+        build_hook_event "$hook_name" | run_hook_now "$hook_name" || true
+        return 0
+    fi
+    
+    mkdir -p "$HOOK_SPOOL_DIR"
+    local event_file="$HOOK_SPOOL_DIR/${EPOCHREALTIME/./}_$$.$hook_name.event"
+    build_hook_event "$hook_name" > "$event_file.tmp" && mv "$event_file.tmp" "$event_file"
+    
+    # Detached worker; output goes to the hook log instead of the user's terminal
+    (process_hook_queue >> "$HOOK_LOG_FILE" 2>&1 < /dev/null &)
+}
+
+#=============================================================================
+# DIAGNOSTICS
+#=============================================================================
+
+# Refresh the capability cache and report what was found
+doctor() {
+    probe_capabilities
+
+    echo -e "${BLUE}Capability cache refreshed: ${CYAN}$CAPABILITIES_FILE${NC}"
+    echo ""
+
+    local group tool
+    for group in OPENERS VIEWERS EDITORS HELPERS; do
+        local -n tools="CAPABILITY_$group"
+        echo -e "${CYAN}${group,,}:${NC}"
+        for tool in "${tools[@]}"; do
+            if has_capability "$tool"; then
+                echo -e "  ${GREEN}✓${NC} $tool ${BLUE}(${CAPABILITIES["cap_$tool"]})${NC}"
+            else
+                echo -e "  ${YELLOW}✗${NC} $tool"
+            fi
+        done
+        unset -n tools
+    done
+
+    echo ""
+    if [[ -n "${CAPABILITIES[opener]}" ]]; then
+        echo -e "System opener: ${CYAN}${CAPABILITIES[opener]}${NC}"
+    else
+        echo -e "${YELLOW}System opener: none found (url/file/folder bookmarks run directly)${NC}"
+    fi
+    echo -e "Editor:        ${CYAN}$(detect_editor)${NC}"
+    local editor_server
+    if editor_server=$(detect_editor_server); then
+        echo -e "Editor server: ${CYAN}${editor_server/$'\t'/ at }${NC}"
+    fi
+    
+    local key handlers=()
+    for key in "${!CAPABILITIES[@]}"; do
+        [[ "$key" == type_* ]] && handlers+=("${key#type_} (${CAPABILITIES[$key]})")
+    done
+    if [[ ${#handlers[@]} -gt 0 ]]; then
+        echo -e "Type handlers: ${CYAN}${handlers[*]}${NC}"
     fi
 }
 
@@ -1836,23 +6103,45 @@ show_help() {
     echo "  update \"Description\" type \"command\" [tags] [notes] # Update a bookmark"
     echo "  delete [\"Description or ID\"]                 # Delete a bookmark (uses fzf if no argument)"
     echo "  obsolete [\"Description or ID\"]               # Mark a bookmark as obsolete (uses fzf if no argument)"
-    echo "  list                                      # List all bookmarks without executing"
+    echo "  list [--all]                              # List bookmarks without executing (--all includes archived)"
     echo "  details [search term]                     # Search and execute bookmarks with preview (includes obsolete)"
+    echo "  set \"Description or ID\" cache_ttl <seconds|off>  # Replay the output of a cmd or script bookmark for N seconds"
+    echo "  set \"Description or ID\" on_failure <stop|continue>  # What a workflow does when a step fails"
+    echo "  set \"Description or ID\" host_group <group|off>  # Run a cmd or ssh bookmark on every host of a group"
     echo "  tag \"tag\"                                # Search bookmarks by tag"
     echo "  backup                                    # Create a backup of bookmarks"
     echo "  restore                                   # Restore from a backup"
+    echo "  restore --at <generation|time>            # Rebuild the store as it was at a generation or time"
+    echo "  undo [N]                                  # Revert the last N operations (default 1)"
+    echo "  changes [--since N] [--follow]            # Show changes newer than store generation N"
+    echo "  sync <dir|file>                           # Merge with another bookmarks store in both directions"
+    echo "  maintain                                  # Retire unused bookmarks, compact logs, rebuild caches, prune backups"
+    echo "  tune [--dry-run]                          # Fit ranking weights to the selections logged with BOOKMARKS_LOG_SELECTIONS=true"
+    echo "  run [-j N] \"Description or ID\"...          # Run several bookmarks in parallel (default RUN_JOBS=4 at a time)"
+    echo "  open --tag TAG | \"Description or ID\"...    # Open url, folder and file bookmarks with one opener call per batch"
+    echo "  stats [description]                       # Show run durations (p50/p95) and failure rates"
+    echo "  hosts [group [host...] | -d group]        # List, define or delete host groups"
+    echo "  masters [warm [N] | stop [target]]        # List, open or close pooled ssh connections"
+    echo "  history [--since WHEN] [--until WHEN] [--type TYPE] [--tag TAG] [--json]  # Show accesses in a time range"
+    echo "  doctor                                    # Refresh and show the capability cache"
     echo "  help                                      # Show this help information"
     echo "  [search term]                             # Search and execute a bookmark"
     echo "  [no arguments]                            # Search bookmarks interactively"
     echo ""
     echo -e "${CYAN}Bookmark Types:${NC}"
-    for type in "${VALID_TYPES[@]}"; do
+    for type in $(list_valid_types); do
         echo "  $type"
     done
     echo ""
+    echo -e "${CYAN}Options:${NC}"
+    echo "  -y, --yes                                 # Non-interactive mode (assume yes)"
+    echo "  --sync-hooks                              # Run hooks in the foreground instead of queueing them"
+    echo "  --fresh                                   # Run bookmarks with a cache_ttl instead of replaying cached output"
+    echo ""
     echo -e "${CYAN}Editor Configuration:${NC}"
     echo "  Set BOOKMARKS_EDITOR or EDITOR environment variable to use your preferred editor"
     echo "  Default: vi"
+    echo "  A running nvim or emacs server is reused (BOOKMARKS_EDITOR_SERVER=off starts a new editor)"
 }
 
 # Check if hooks directory exists, create it if not
@@ -1870,11 +6159,16 @@ if [ ! -f "$BOOKMARKS_DIR/hooks/after_add.sh.example" ]; then
 # Arguments:
 # $1 - Bookmarks directory
 # $2 - Bookmarks file
+#
+# Standard input: one JSON event per line with the operation, affected ids,
+# before/after records and the new store generation
 
 BOOKMARKS_DIR="$1"
 BOOKMARKS_FILE="$2"
 
-echo "Bookmark was added!"
+while IFS= read -r event; do
+    echo "Bookmark was added: $(echo "$event" | jq -r '.after[].description')"
+done
 echo "You can add custom actions here, like syncing bookmarks to another location."
 EOF
     chmod +x "$BOOKMARKS_DIR/hooks/after_add.sh.example"
@@ -1888,6 +6182,14 @@ while [[ $# -gt 0 && "$1" == -* ]]; do
             NON_INTERACTIVE=true
             shift
             ;;
+        --sync-hooks)
+            SYNC_HOOKS=true
+            shift
+            ;;
+        --fresh)
+            OUTPUT_CACHE_FRESH=true
+            shift
+            ;;
         *)
             echo -e "${RED}Unknown option: $1${NC}"
             exit 1
@@ -1895,6 +6197,9 @@ while [[ $# -gt 0 && "$1" == -* ]]; do
     esac
 done
 
+# A full maintain run covers what the background run would do
+[[ "${1:-}" == "maintain" ]] || schedule_background_maintenance
+
 case "${1:-}" in
     "add")
         if [ $# -eq 1 ]; then
@@ -1935,11 +6240,19 @@ case "${1:-}" in
         run_hook "after_obsolete"
         ;;
     "list")
-        list_all_bookmarks "false"
+        if [[ "${2:-}" == "--all" ]]; then
+            list_all_bookmarks "false" "true"
+        else
+            list_all_bookmarks "false"
+        fi
         ;;
     "details")
         list_bookmarks_with_details "${2:-}"
         ;;
+    "set")
+        set_bookmark_setting "${2:-}" "${3:-}" "${4:-}"
+        run_hook "after_update"
+        ;;
     "tag")
         if [ $# -lt 2 ]; then
             echo -e "${RED}Usage: $0 tag \"tag\"${NC}"
@@ -1951,7 +6264,53 @@ case "${1:-}" in
         backup_bookmarks
         ;;
     "restore")
-        restore_from_backup
+        if [[ "${2:-}" == "--at" ]]; then
+            restore_to_point "${3:-}"
+        else
+            restore_from_backup
+        fi
+        ;;
+    "undo")
+        undo_operations "${2:-1}"
+        ;;
+    "changes")
+        shift
+        show_changes "$@"
+        ;;
+    "sync")
+        sync_bookmarks "${2:-}"
+        run_hook "after_sync"
+        ;;
+    "maintain")
+        maintain_store
+        ;;
+    "run")
+        shift
+        run_bookmarks_parallel "$@"
+        ;;
+    "open")
+        shift
+        open_bookmarks "$@"
+        ;;
+    "stats")
+        show_stats "${2:-}"
+        ;;
+    "hosts")
+        shift
+        manage_host_groups "$@"
+        ;;
+    "masters")
+        manage_ssh_masters "${2:-list}" "${3:-}"
+        ;;
+    "history")
+        shift
+        show_history "$@"
+        ;;
+    "tune")
+        tune_ranking_weights "${2:-}"
+        ;;
+    "doctor")
+        doctor
         ;;
     "help")
         show_help
@@ -1,6 +1,42 @@
 # Bash completion for Universal Bookmarks
 # Place this file in /etc/bash_completion.d/ or source it from your .bashrc
 
+# Print the context index file for a directory or repository, named as
+# bookmarks.sh names it (see context_index_file)
+_bookmark_context_file() {
+    local name="${2//%/%25}"
+    name="${name//\//%2F}"
+    if [[ ${#name} -gt 200 ]]; then
+        name="sum-$(printf '%s' "$2" | cksum | cut -d' ' -f1)"
+    fi
+    echo "$BOOKMARKS_DIR/contexts/$1-$name.json"
+}
+
+# Print bookmark descriptions in ranking order: the blend of frequency,
+# recency and context that bookmarks.sh uses (see rank_score), with the
+# weights saved by `bookmark tune`
+_bookmark_ranked_descriptions() {
+    local top="$PWD" dir_file git_file=/dev/null weights_file="$BOOKMARKS_DIR/ranking_weights"
+    while [[ -n "$top" && ! -e "$top/.git" ]]; do
+        top="${top%/*}"
+    done
+    dir_file=$(_bookmark_context_file dir "$PWD")
+    [[ -z "$top" ]] || git_file=$(_bookmark_context_file git "$top")
+    [[ -f "$dir_file" ]] || dir_file=/dev/null
+    [[ -f "$git_file" ]] || git_file=/dev/null
+    [[ -f "$weights_file" ]] || weights_file=/dev/null
+    jq -r --slurpfile dir "$dir_file" --slurpfile git "$git_file" --rawfile weights "$weights_file" '
+        ({frequency: 1, recency: 1, context: 9}
+         + ([$weights | split("\n")[] | select(test("^[a-z]+=[0-9.]+$")) | split("=") | {(.[0]): (.[1] | tonumber)}] | add // {})) as $w
+        | .bookmarks
+        | sort_by(((($dir[0].counts // {})[.id] // 0) + (($git[0].counts // {})[.id] // 0)) as $u
+                  | ([.access_count // 0, 1] | max) as $count | (.frecency_score // 0) as $score
+                  | -((if $score > 0 then ($count | log) * $w.frequency + ($score / (10000 * $count) | log) * $w.recency
+                       else -10 * ($w.frequency + $w.recency) end)
+                      + (1 + $w.context * $u / ($u + 2) | log)))
+        | .[].description' "$BOOKMARKS_DIR/bookmarks.json" 2>/dev/null
+}
+
 _bookmark_completion() {
     local cur prev opts commands types
     COMPREPLY=()
@@ -13,14 +49,14 @@ _bookmark_completion() {
     fi
     
     # Available commands
-    commands="add edit modify-add update delete obsolete list details tag backup restore help"
+    commands="add edit modify-add update delete obsolete list details tag backup restore doctor changes sync undo maintain tune history stats set run hosts masters open help"
     
     # Bookmark types
-    types="url pdf script ssh app cmd note folder file edit custom"
+    types="url pdf script ssh app cmd note folder file edit workflow custom"
     
-    # Handle flags
-    if [[ ${cur} == -* ]]; then
-        opts="-y --yes"
+    # Handle flags (history completes its own options)
+    if [[ ${cur} == -* && "${COMP_WORDS[1]}" != "history" ]]; then
+        opts="-y --yes --sync-hooks --fresh"
         COMPREPLY=( $(compgen -W "${opts}" -- ${cur}) )
         return 0
     fi
@@ -69,10 +105,10 @@ _bookmark_completion() {
             if [[ ${COMP_CWORD} -eq 2 ]]; then
                 # Complete with bookmark descriptions
                 if command -v jq >/dev/null 2>&1; then
-                    local descriptions=$(jq -r '.bookmarks[].description' "$BOOKMARKS_DIR/bookmarks.json" 2>/dev/null | tr '\n' '|')
-                    # Handle spaces in descriptions by using a different approach
+                    # Handle spaces in descriptions by splitting on newlines only
                     local IFS=$'\n'
-                    local desc_array=($(jq -r '.bookmarks[].description' "$BOOKMARKS_DIR/bookmarks.json" 2>/dev/null))
+                    local desc_array=($(_bookmark_ranked_descriptions))
+                    compopt -o nosort 2>/dev/null
                     COMPREPLY=( $(compgen -W "$(printf '%s\n' "${desc_array[@]}")" -- ${cur}) )
                 fi
             fi
@@ -84,7 +120,8 @@ _bookmark_completion() {
                     # Complete with bookmark descriptions
                     if command -v jq >/dev/null 2>&1; then
                         local IFS=$'\n'
-                        local desc_array=($(jq -r '.bookmarks[].description' "$BOOKMARKS_DIR/bookmarks.json" 2>/dev/null))
+                        local desc_array=($(_bookmark_ranked_descriptions))
+                        compopt -o nosort 2>/dev/null
                         COMPREPLY=( $(compgen -W "$(printf '%s\n' "${desc_array[@]}")" -- ${cur}) )
                     fi
                     return 0
@@ -113,6 +150,76 @@ _bookmark_completion() {
                     ;;
             esac
             ;;
+        set)
+            case ${COMP_CWORD} in
+                2)
+                    if command -v jq >/dev/null 2>&1; then
+                        local IFS=$'\n'
+                        local desc_array=($(_bookmark_ranked_descriptions))
+                        compopt -o nosort 2>/dev/null
+                        COMPREPLY=( $(compgen -W "$(printf '%s\n' "${desc_array[@]}")" -- ${cur}) )
+                    fi
+                    ;;
+                3)
+                    COMPREPLY=( $(compgen -W "cache_ttl on_failure host_group" -- ${cur}) )
+                    ;;
+                4)
+                    if [[ "${COMP_WORDS[3]}" == "on_failure" ]]; then
+                        COMPREPLY=( $(compgen -W "stop continue" -- ${cur}) )
+                    elif [[ "${COMP_WORDS[3]}" == "host_group" ]]; then
+                        COMPREPLY=( $(compgen -W "off $(cut -d= -f1 "$BOOKMARKS_DIR/host_groups" 2>/dev/null)" -- ${cur}) )
+                    else
+                        COMPREPLY=( $(compgen -W "60 300 3600 off" -- ${cur}) )
+                    fi
+                    ;;
+            esac
+            return 0
+            ;;
+        history)
+            case "${prev}" in
+                --type)
+                    COMPREPLY=( $(compgen -W "${types}" -- ${cur}) )
+                    ;;
+                --tag)
+                    if command -v jq >/dev/null 2>&1; then
+                        local tags=$(jq -r '.bookmarks[].tags' "$BOOKMARKS_DIR/bookmarks.json" 2>/dev/null | \
+                                   tr ' ' '\n' | grep -v '^$' | sort -u | tr '\n' ' ')
+                        COMPREPLY=( $(compgen -W "${tags}" -- ${cur}) )
+                    fi
+                    ;;
+                --since|--until)
+                    ;;
+                *)
+                    COMPREPLY=( $(compgen -W "--since --until --type --tag --json" -- ${cur}) )
+                    ;;
+            esac
+            return 0
+            ;;
+        open)
+            if [[ "${prev}" == "--tag" ]]; then
+                if command -v jq >/dev/null 2>&1; then
+                    local tags=$(jq -r '.bookmarks[].tags' "$BOOKMARKS_DIR/bookmarks.json" 2>/dev/null | \
+                               tr ' ' '\n' | grep -v '^$' | sort -u | tr '\n' ' ')
+                    COMPREPLY=( $(compgen -W "${tags}" -- ${cur}) )
+                fi
+            elif [[ ${COMP_CWORD} -eq 2 && "${cur}" == -* ]]; then
+                COMPREPLY=( $(compgen -W "--tag" -- ${cur}) )
+            elif [[ "${COMP_WORDS[2]}" != "--tag" ]] && command -v jq >/dev/null 2>&1; then
+                local IFS=$'\n'
+                local desc_array=($(_bookmark_ranked_descriptions))
+                compopt -o nosort 2>/dev/null
+                COMPREPLY=( $(compgen -W "$(printf '%s\n' "${desc_array[@]}")" -- ${cur}) )
+            fi
+            return 0
+            ;;
+        masters)
+            if [[ ${COMP_CWORD} -eq 2 ]]; then
+                COMPREPLY=( $(compgen -W "list warm stop" -- ${cur}) )
+            elif [[ ${COMP_CWORD} -eq 3 && "${COMP_WORDS[2]}" == "stop" ]]; then
+                COMPREPLY=( $(compgen -W "$(ls "$BOOKMARKS_DIR/ssh" 2>/dev/null)" -- ${cur}) )
+            fi
+            return 0
+            ;;
         tag)
             if [[ ${COMP_CWORD} -eq 2 ]]; then
                 # Complete with existing tags
@@ -128,7 +235,8 @@ _bookmark_completion() {
             # For search terms or default behavior, complete with bookmark descriptions
             if command -v jq >/dev/null 2>&1; then
                 local IFS=$'\n'
-                local desc_array=($(jq -r '.bookmarks[].description' "$BOOKMARKS_DIR/bookmarks.json" 2>/dev/null))
+                local desc_array=($(_bookmark_ranked_descriptions))
+                compopt -o nosort 2>/dev/null
                 COMPREPLY=( $(compgen -W "$(printf '%s\n' "${desc_array[@]}")" -- ${cur}) )
             fi
             return 0
@@ -30,6 +30,26 @@ TEST_FILES=(
     "test_special_chars.sh"
     "test_type_execution.sh"
     "test_composable_filters.sh"
+    "test_capabilities.sh"
+    "test_hooks.sh"
+    "test_changes.sh"
+    "test_sync.sh"
+    "test_layers.sh"
+    "test_backups.sh"
+    "test_undo.sh"
+    "test_archive.sh"
+    "test_maintain.sh"
+    "test_context.sh"
+    "test_ranking.sh"
+    "test_history.sh"
+    "test_telemetry.sh"
+    "test_output_cache.sh"
+    "test_parallel.sh"
+    "test_workflow.sh"
+    "test_host_groups.sh"
+    "test_ssh_pooling.sh"
+    "test_batch_open.sh"
+    "test_editor_server.sh"
 )
 
 # Global counters
@@ -0,0 +1,97 @@
+#!/bin/bash
+
+# Test suite for the archive partition
+# Obsolete bookmarks move to archive.json and are only read where needed
+
+# Source the shared test framework
+SCRIPT_DIR="$(cd "$(dirname "${BASH_SOURCE[0]}")" && pwd)"
+source "$SCRIPT_DIR/test_framework.sh"
+
+# Run the test suite
+run_test_suite() {
+    echo -e "${BLUE}Starting archive partition test suite${NC}"
+
+    local archive="$TEST_DIR/archive.json"
+
+    ../bookmarks.sh add 'Live Bookmark' cmd 'echo live' > /dev/null
+    ../bookmarks.sh add 'Stale Bookmark' cmd 'echo stale' > /dev/null
+
+    # Test 1: Marking obsolete moves the record out of the store
+    ../bookmarks.sh -y obsolete 'Stale Bookmark' > /dev/null
+    run_test "Obsolete bookmark leaves the store" \
+        "! jq -e '.bookmarks[] | select(.description == \"Stale Bookmark\")' '$TEST_BOOKMARKS_FILE' > /dev/null"
+    run_test "Obsolete bookmark is in the archive" \
+        "jq -e '.bookmarks[] | select(.description == \"Stale Bookmark\" and .status == \"obsolete\")' '$archive' > /dev/null"
+
+    # Test 2: Listings read the archive only when asked
+    run_test "List skips archived bookmarks" \
+        "! ../bookmarks.sh list | grep -q 'Stale Bookmark'"
+    run_test "List --all includes archived bookmarks" \
+        "../bookmarks.sh list --all | grep -q 'Stale Bookmark | echo stale | obsolete'"
+    run_test "Details preview finds archived bookmarks" \
+        "../bookmarks.sh _preview_details 'Stale Bookmark' | grep -q 'echo stale'"
+
+    # Test 3: Restoring to active moves the record back
+    ../bookmarks.sh -y obsolete 'Stale Bookmark' > /dev/null
+    run_test "Restored bookmark is back in the store" \
+        "jq -e '.bookmarks[] | select(.description == \"Stale Bookmark\" and .status == \"active\")' '$TEST_BOOKMARKS_FILE' > /dev/null"
+    run_test "Restored bookmark leaves the archive" \
+        "[ \$(jq '.bookmarks | length' '$archive') -eq 0 ]"
+
+    # Test 4: Editing or deleting an archived bookmark works on the store
+    ../bookmarks.sh -y obsolete 'Stale Bookmark' > /dev/null
+    run_test "Update of an archived bookmark is kept" \
+        "../bookmarks.sh update 'Stale Bookmark' cmd 'echo edited' > /dev/null && \
+         [ \"\$(../bookmarks.sh list --all | grep -c 'Stale Bookmark')\" -eq 1 ] && \
+         ../bookmarks.sh list --all | grep -q 'echo edited' && ! ../bookmarks.sh list | grep -q 'Stale Bookmark'"
+    ../bookmarks.sh -y obsolete 'Live Bookmark' > /dev/null
+    run_test "Delete removes an archived bookmark" \
+        "../bookmarks.sh -y delete 'Live Bookmark' > /dev/null && ! ../bookmarks.sh list --all | grep -q 'Live Bookmark'"
+
+    # Test 5: Sync does not treat archiving as a deletion
+    local peer_dir="$TEST_DIR/peer"
+    mkdir -p "$peer_dir"
+    ../bookmarks.sh add 'Synced Bookmark' cmd 'echo synced' > /dev/null
+    ../bookmarks.sh sync "$peer_dir" > /dev/null
+    ../bookmarks.sh -y obsolete 'Synced Bookmark' > /dev/null
+    ../bookmarks.sh sync "$peer_dir" > /dev/null
+    run_test "Sync carries the obsolete status to the peer archive" \
+        "jq -e '.bookmarks[] | select(.description == \"Synced Bookmark\" and .status == \"obsolete\")' '$peer_dir/archive.json' > /dev/null"
+
+    # Test 6: Running an archived bookmark records the access
+    ../bookmarks.sh add 'Archived Run' cmd 'echo archived run' > /dev/null
+    ../bookmarks.sh -y obsolete 'Archived Run' > /dev/null
+    local generation_before
+    generation_before=$(jq '.generation' "$TEST_BOOKMARKS_FILE")
+    ../bookmarks.sh -y run 'Archived Run' > "$TEST_DIR/archived-run.out" 2>&1
+    run_test "Archived bookmark runs" \
+        "grep -q 'archived run' '$TEST_DIR/archived-run.out'"
+    run_test "Its access is counted in the store in one commit" \
+        "jq -e '.bookmarks[] | select(.description == \"Archived Run\" and .access_count == 1)' '$TEST_BOOKMARKS_FILE' > /dev/null && \
+         [ \"\$(jq '.generation' '$TEST_BOOKMARKS_FILE')\" = '$((generation_before + 1))' ]"
+    run_test "It leaves the archive" \
+        "! jq -e '.bookmarks[] | select(.description == \"Archived Run\")' '$archive' > /dev/null"
+
+    # Summary
+    echo ""
+    echo -e "${BLUE}Test summary:${NC}"
+    echo -e "  ${GREEN}Tests passed: $TESTS_PASSED${NC}"
+    echo -e "  ${RED}Tests failed: $TESTS_FAILED${NC}"
+    echo -e "  Total tests: $TOTAL_TESTS"
+
+    if [ "$TESTS_FAILED" -eq 0 ]; then
+        echo -e "${GREEN}All archive tests passed! 🎉${NC}"
+        return 0
+    else
+        echo -e "${RED}Some tests failed.${NC}"
+        return 1
+    fi
+}
+
+# Main execution
+setup_test_env
+run_test_suite
+TEST_RESULT=$?
+cleanup_test_env
+
+exit $TEST_RESULT
@@ -0,0 +1,91 @@
+#!/bin/bash
+
+# Test suite for content-addressed backups
+# Covers the manifest, skipping unchanged stores, compression, retention,
+# legacy backup import and restore
+
+# Source the shared test framework
+SCRIPT_DIR="$(cd "$(dirname "${BASH_SOURCE[0]}")" && pwd)"
+source "$SCRIPT_DIR/test_framework.sh"
+
+# Run the test suite
+run_test_suite() {
+    echo -e "${BLUE}Starting backup test suite${NC}"
+
+    local backup_dir="$TEST_DIR/backups"
+    local manifest="$backup_dir/manifest.tsv"
+
+    # Test 1: Legacy backups are imported into the manifest
+    ../bookmarks.sh add 'Legacy' cmd 'echo legacy' > /dev/null
+    mkdir -p "$backup_dir"
+    cp "$TEST_BOOKMARKS_FILE" "$backup_dir/bookmarks_20240101_120000.json"
+    ../bookmarks.sh add 'First' cmd 'echo first' > /dev/null
+    BACKUP_COMPRESS=none ../bookmarks.sh backup > /dev/null
+    run_test "Legacy backups are imported" \
+        "[ ! -e '$backup_dir/bookmarks_20240101_120000.json' ] && grep -q '^20240101_120000' '$manifest'"
+
+    # Test 2: A backup adds a manifest entry and a content-addressed object
+    local hash
+    hash=$(sha256sum "$TEST_BOOKMARKS_FILE" | cut -d' ' -f1)
+    run_test "Backup object is named by its hash" \
+        "[ -f '$backup_dir/objects/$hash.json' ] && tail -n 1 '$manifest' | grep -q \"$hash\""
+
+    # Test 3: Backing up an unchanged store adds nothing
+    local entries
+    entries=$(wc -l < "$manifest")
+    ../bookmarks.sh backup > /dev/null
+    run_test "Unchanged store is not backed up again" \
+        "[ \$(wc -l < '$manifest') -eq $entries ]"
+
+    # Test 4: Compressed backups when zstd is available
+    if command -v zstd > /dev/null 2>&1; then
+        ../bookmarks.sh add 'Second' cmd 'echo second' > /dev/null
+        BACKUP_COMPRESS=zstd ../bookmarks.sh backup > /dev/null
+        run_test "zstd backups are compressed" \
+            "tail -n 1 '$manifest' | grep -qP '\tzstd$' && ls '$backup_dir/objects/'*.json.zst > /dev/null"
+
+        ../bookmarks.sh add 'After Compressed' cmd 'echo after' > /dev/null
+        ../bookmarks.sh -y restore > /dev/null
+        run_test "Restore from a compressed backup" \
+            "jq -e '[.bookmarks[].description] | index(\"Second\") != null and index(\"After Compressed\") == null' '$TEST_BOOKMARKS_FILE' > /dev/null"
+    fi
+
+    # Test 5: Retention prunes manifest entries and unreferenced objects
+    local i
+    for i in 1 2 3 4; do
+        ../bookmarks.sh add "Retention $i" cmd "echo $i" > /dev/null
+        BACKUP_RETENTION=2 BACKUP_COMPRESS=none ../bookmarks.sh backup > /dev/null
+    done
+    run_test "Manifest keeps the retention count" \
+        "[ \$(wc -l < '$manifest') -eq 2 ]"
+    # Objects still in use are the kept backups plus snapshots the journal refers to
+    run_test "Unreferenced objects are deleted" \
+        "[ \$(ls '$backup_dir/objects' | wc -l) -eq \$({ cut -f2 '$manifest' | sed 's/\$/.json/'; jq -r '.snapshots // {} | .[]' '$TEST_DIR/journal.jsonl'; } | sort -u | wc -l) ]"
+
+    # Test 6: Restore lists backups from the manifest, newest first
+    run_test "Restore lists manifest entries" \
+        "echo 0 | ../bookmarks.sh restore 2>&1 | grep -q '1).*(generation'"
+
+    # Summary
+    echo ""
+    echo -e "${BLUE}Test summary:${NC}"
+    echo -e "  ${GREEN}Tests passed: $TESTS_PASSED${NC}"
+    echo -e "  ${RED}Tests failed: $TESTS_FAILED${NC}"
+    echo -e "  Total tests: $TOTAL_TESTS"
+
+    if [ "$TESTS_FAILED" -eq 0 ]; then
+        echo -e "${GREEN}All backup tests passed! 🎉${NC}"
+        return 0
+    else
+        echo -e "${RED}Some tests failed.${NC}"
+        return 1
+    fi
+}
+
+# Main execution
+setup_test_env
+run_test_suite
+TEST_RESULT=$?
+cleanup_test_env
+
+exit $TEST_RESULT
@@ -0,0 +1,122 @@
+#!/bin/bash
+
+# Test suite for opening url, folder and file bookmarks in batches
+# Covers `open --tag`, OPEN_BATCH_SIZE, BOOKMARKS_BROWSER, single-argument
+# openers and multi-select, using stand-ins that log each invocation
+
+# Source the shared test framework
+SCRIPT_DIR="$(cd "$(dirname "${BASH_SOURCE[0]}")" && pwd)"
+source "$SCRIPT_DIR/test_framework.sh"
+
+# Install a browser and an xdg-open stand-in that log one line per invocation,
+# and an fzf stand-in: --filter greps, interactive runs pick lines matching the
+# extended regex $FZF_PICK
+install_opener_doubles() {
+    mkdir -p "$TEST_DIR/bin"
+    cat > "$TEST_DIR/bin/fzf" << 'FZF'
+#!/bin/bash
+filter=""
+for arg in "$@"; do
+    case "$arg" in
+        --filter=*) filter="${arg#--filter=}" ;;
+    esac
+done
+if [ -n "$filter" ]; then
+    grep -iF -- "$filter" || exit 1
+    exit 0
+fi
+grep -E -- "$FZF_PICK"
+FZF
+    chmod +x "$TEST_DIR/bin/fzf"
+    local tool
+    for tool in browser xdg-open; do
+        cat > "$TEST_DIR/bin/$tool" << OPENER
+#!/bin/bash
+echo "\$*" >> "$TEST_DIR/$tool.log"
+OPENER
+        chmod +x "$TEST_DIR/bin/$tool"
+    done
+}
+
+# Number of invocations a stand-in logged
+# Args: $1 - stand-in name
+invocations() {
+    sleep 0.2
+    cat "$TEST_DIR/$1.log" 2>/dev/null | wc -l
+}
+
+# Run the test suite
+run_test_suite() {
+    echo -e "${BLUE}Starting batch open test suite${NC}"
+
+    install_opener_doubles
+    export PATH="$TEST_DIR/bin:$PATH"
+    local n
+    for n in 1 2 3 4 5; do
+        ../bookmarks.sh add "Dashboard $n" url "\"https://grafana.example.com/d/$n\"" 'oncall' > /dev/null
+    done
+    mkdir -p "$TEST_DIR/runbooks"
+    ../bookmarks.sh add 'Runbooks' folder "\"$TEST_DIR/runbooks\"" 'oncall' > /dev/null
+    ../bookmarks.sh add 'Pager Script' cmd "touch '$TEST_DIR/paged'" 'oncall' > /dev/null
+    ../bookmarks.sh add 'Old Dashboard' url '"https://old.example.com"' 'oncall' > /dev/null
+    ../bookmarks.sh -y obsolete 'Old Dashboard' > /dev/null 2>&1
+
+    # Test 1: open --tag hands all URLs to one browser invocation
+    local generation_before
+    generation_before=$(jq '.generation' "$TEST_BOOKMARKS_FILE")
+    BOOKMARKS_BROWSER=browser ../bookmarks.sh open --tag oncall > "$TEST_DIR/out.txt" 2>&1
+    run_test "URLs are opened by one browser invocation" \
+        "[ \$(invocations browser) -eq 1 ] && grep -q 'https://grafana.example.com/d/1 .*https://grafana.example.com/d/5' '$TEST_DIR/browser.log'"
+    run_test "Folders still go to the system opener" \
+        "[ \$(invocations xdg-open) -eq 1 ] && grep -q '$TEST_DIR/runbooks' '$TEST_DIR/xdg-open.log'"
+    run_test "Other types and obsolete bookmarks are left out" \
+        "[ ! -f '$TEST_DIR/paged' ] && ! grep -q old.example '$TEST_DIR/browser.log'"
+    run_test "Access statistics are recorded in a single commit" \
+        "[ \$(jq '.generation' \"$TEST_BOOKMARKS_FILE\") -eq $((generation_before + 1)) ] && \
+         jq -e '[.bookmarks[] | select(.access_count == 1) | .description] | length == 6' \"$TEST_BOOKMARKS_FILE\" > /dev/null"
+
+    # Test 2: The batch size limits each invocation
+    rm -f "$TEST_DIR"/*.log
+    OPEN_BATCH_SIZE=2 BOOKMARKS_BROWSER=browser ../bookmarks.sh open --tag oncall > /dev/null 2>&1
+    run_test "OPEN_BATCH_SIZE splits the URLs into batches" \
+        "[ \$(invocations browser) -eq 3 ] && [ \$(awk '{ print NF }' '$TEST_DIR/browser.log' | sort -n | tail -n 1) -eq 2 ]"
+
+    # Test 3: Single-argument openers get one bookmark each
+    rm -f "$TEST_DIR"/*.log
+    ../bookmarks.sh open 'Dashboard 1' 'Dashboard 2' > /dev/null 2>&1
+    run_test "xdg-open is called once per bookmark" \
+        "[ \$(invocations xdg-open) -eq 2 ]"
+    run_test "open rejects bookmarks that are not opened" \
+        "../bookmarks.sh open 'Pager Script'" 1
+
+    # Test 4: Multi-select batches URLs and runs the rest
+    rm -f "$TEST_DIR"/*.log
+    BOOKMARKS_BROWSER=browser FZF_PICK="Dashboard [12]|Pager" ../bookmarks.sh > "$TEST_DIR/out.txt" 2>&1
+    run_test "Multi-selected URLs share one browser invocation" \
+        "[ \$(invocations browser) -eq 1 ] && grep -q 'opened .*Dashboard 1' '$TEST_DIR/out.txt'"
+    run_test "Other multi-selected bookmarks still run" \
+        "[ -f '$TEST_DIR/paged' ] && grep -q 'ok .*Pager Script' '$TEST_DIR/out.txt'"
+
+    # Summary
+    echo ""
+    echo -e "${BLUE}Test summary:${NC}"
+    echo -e "  ${GREEN}Tests passed: $TESTS_PASSED${NC}"
+    echo -e "  ${RED}Tests failed: $TESTS_FAILED${NC}"
+    echo -e "  Total tests: $TOTAL_TESTS"
+
+    if [ "$TESTS_FAILED" -eq 0 ]; then
+        echo -e "${GREEN}All batch open tests passed! 🎉${NC}"
+        return 0
+    else
+        echo -e "${RED}Some tests failed.${NC}"
+        return 1
+    fi
+}
+
+# Main execution
+setup_test_env
+run_test_suite
+TEST_RESULT=$?
+cleanup_test_env
+
+exit $TEST_RESULT
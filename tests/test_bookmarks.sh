@@ -151,7 +151,8 @@ run_test_suite() {
     # Test extraction with obsolete bookmark
     local obsolete_formatted_line="[OBSOLETE] [script] List Files"
     local obsolete_extracted_desc=$(echo "$obsolete_formatted_line" | sed -E 's/\x1B\[[0-9;]*[mK]//g' | sed -E 's/^\[OBSOLETE\] \[(.*)\] (.*)/\2/')
-    local obsolete_extracted_cmd=$(jq -r --arg desc "$obsolete_extracted_desc" '.bookmarks[] | select(.description == $desc) | .command' "$TEST_BOOKMARKS_FILE")
+    # Obsolete bookmarks are moved to the archive partition
+    local obsolete_extracted_cmd=$(jq -r --arg desc "$obsolete_extracted_desc" '.bookmarks[] | select(.description == $desc) | .command' "$TEST_DIR/archive.json")
     
     if [ "$obsolete_extracted_cmd" = "ls -la" ]; then
         echo -e "${GREEN}✓ Test passed: Extract command from obsolete formatted line${NC}"
@@ -299,7 +300,7 @@ EDITEOF
     ../bookmarks.sh -y obsolete "Obsolete Test Bookmark" > /dev/null 2>&1
     
     # Verify the bookmark was marked as obsolete
-    local obsolete_status=$(jq -r '.bookmarks[] | select(.description == "Obsolete Test Bookmark") | .status' "$TEST_BOOKMARKS_FILE")
+    local obsolete_status=$(jq -r '.bookmarks[] | select(.description == "Obsolete Test Bookmark") | .status' "$TEST_DIR/archive.json")
     
     if [ "$obsolete_status" = "obsolete" ]; then
         echo -e "${GREEN}✓ Test passed: Obsolete command with direct argument${NC}"
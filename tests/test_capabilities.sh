@@ -0,0 +1,76 @@
+#!/bin/bash
+
+# Test suite for the capability cache and doctor command
+# Verifies that tool probes are cached per $PATH and reused at execution time
+
+# Source the shared test framework
+SCRIPT_DIR="$(cd "$(dirname "${BASH_SOURCE[0]}")" && pwd)"
+source "$SCRIPT_DIR/test_framework.sh"
+
+# Run the test suite
+run_test_suite() {
+    echo -e "${BLUE}Starting capability cache test suite${NC}"
+
+    local cache_file="$TEST_DIR/.capabilities"
+
+    # Test 1: Any invocation creates the cache
+    run_test "Cache is created on first run" \
+        "../bookmarks.sh list > /dev/null && [ -f '$cache_file' ]"
+
+    # Test 2: Cache records helper tools
+    run_test "Cache records jq location" \
+        "grep -q '^cap_jq=/' '$cache_file'"
+
+    # Test 3: doctor refreshes the cache and reports tools
+    run_test "Doctor reports capabilities" \
+        "../bookmarks.sh doctor | grep -q 'jq'"
+
+    # Test 4: Cached opener is used for execution (no re-probe while PATH is unchanged)
+    local fake_opener="$TEST_DIR/fake-opener"
+    cat > "$fake_opener" << EOF
+#!/bin/bash
+echo "\$@" > "$TEST_DIR/opened.txt"
+EOF
+    chmod +x "$fake_opener"
+    sed -i "s|^opener=.*|opener=$fake_opener|" "$cache_file"
+
+    ../bookmarks.sh add "Cached Opener URL" url '"https://example.com"' > /dev/null 2>&1
+    ../bookmarks.sh "Cached Opener URL" > /dev/null 2>&1
+    sleep 0.2
+    run_test "Execution uses the cached opener" \
+        "grep -q 'https://example.com' '$TEST_DIR/opened.txt'"
+
+    # Test 5: A different PATH invalidates the cache
+    local old_path
+    old_path=$(grep '^path=' "$cache_file")
+    PATH="$PATH:$TEST_DIR" ../bookmarks.sh list > /dev/null 2>&1
+    run_test "Changing PATH triggers a re-probe" \
+        "[ \"\$(grep '^path=' '$cache_file')\" != '$old_path' ]"
+
+    # Test 6: Re-probe discards the injected opener
+    run_test "Re-probe replaces stale opener" \
+        "! grep -q '^opener=$fake_opener' '$cache_file'"
+
+    # Summary
+    echo ""
+    echo -e "${BLUE}Test summary:${NC}"
+    echo -e "  ${GREEN}Tests passed: $TESTS_PASSED${NC}"
+    echo -e "  ${RED}Tests failed: $TESTS_FAILED${NC}"
+    echo -e "  Total tests: $TOTAL_TESTS"
+
+    if [ "$TESTS_FAILED" -eq 0 ]; then
+        echo -e "${GREEN}All capability cache tests passed! 🎉${NC}"
+        return 0
+    else
+        echo -e "${RED}Some tests failed.${NC}"
+        return 1
+    fi
+}
+
+# Main execution
+setup_test_env
+run_test_suite
+TEST_RESULT=$?
+cleanup_test_env
+
+exit $TEST_RESULT
@@ -0,0 +1,114 @@
+#!/bin/bash
+
+# Test suite for store generations and the change feed
+# Covers generation stamping, the bounded change log, `changes --since/--follow`
+# and concurrent writers
+
+# Source the shared test framework
+SCRIPT_DIR="$(cd "$(dirname "${BASH_SOURCE[0]}")" && pwd)"
+source "$SCRIPT_DIR/test_framework.sh"
+
+# Run the test suite
+run_test_suite() {
+    echo -e "${BLUE}Starting change feed test suite${NC}"
+
+    local log_file="$TEST_DIR/changes.log"
+
+    # Test 1: Every commit stamps the next generation
+    ../bookmarks.sh add 'Gen One' cmd 'echo one' > /dev/null
+    run_test "First commit is generation 1" \
+        "[ \"\$(jq '.generation' '$TEST_BOOKMARKS_FILE')\" = '1' ]"
+
+    ../bookmarks.sh add 'Gen Two' cmd 'echo two' > /dev/null
+    run_test "Second commit is generation 2" \
+        "[ \"\$(jq '.generation' '$TEST_BOOKMARKS_FILE')\" = '2' ]"
+
+    # Test 2: The change log records generation, operation and id
+    local two_id
+    two_id=$(jq -r '.bookmarks[] | select(.description == "Gen Two") | .id' "$TEST_BOOKMARKS_FILE")
+    run_test "Change log records the added id" \
+        "grep -qP '^2\tadd\t$two_id\t[0-9]+$' '$log_file'"
+
+    # Test 3: --since only returns newer generations
+    run_test "changes --since filters older generations" \
+        "[ \"\$(../bookmarks.sh changes --since 1 | cut -f1 | sort -u)\" = '2' ]"
+
+    # Test 4: Deletes and executions show up in the feed
+    ../bookmarks.sh -y delete 'Gen One' > /dev/null
+    ../bookmarks.sh 'Gen Two' > /dev/null
+    run_test "Delete is logged" \
+        "../bookmarks.sh changes --since 2 | grep -qP '^3\tdelete\t'"
+    run_test "Execution is logged as access" \
+        "../bookmarks.sh changes --since 3 | grep -qP '^4\taccess\t$two_id\t'"
+
+    # Test 5: Writes are atomic and leave no temporary files behind
+    run_test "No temporary store files left behind" \
+        "! ls '$TEST_DIR'/bookmarks.json.tmp.* > /dev/null 2>&1"
+
+    # Test 6: The log is bounded and truncated history is reported
+    # The access above may also have committed a background rescore
+    local i base_generation
+    sleep 0.5
+    base_generation=$(jq '.generation' "$TEST_BOOKMARKS_FILE")
+    for i in 1 2 3 4 5 6 7 8; do
+        CHANGE_LOG_MAX_ENTRIES=4 ../bookmarks.sh add "Bulk $i" cmd "echo $i" > /dev/null
+    done
+    run_test "Change log is trimmed to its bound" \
+        "[ \$(wc -l < '$log_file') -le 5 ]"
+    run_test "Generations keep increasing after trimming" \
+        "[ \"\$(jq '.generation' '$TEST_BOOKMARKS_FILE')\" = '$((base_generation + 8))' ]"
+    run_test "Truncated history exits with status 2" \
+        "../bookmarks.sh changes --since 1 > /dev/null 2>&1" 2
+    run_test "Recent history is still complete" \
+        "../bookmarks.sh changes --since 11 | grep -qP '^12\tadd\t'"
+
+    # Test 7: --follow streams changes made after it started
+    local follow_out="$TEST_DIR/follow.out"
+    CHANGES_POLL_INTERVAL=0.2 timeout 4 ../bookmarks.sh changes --since 12 --follow > "$follow_out" 2>/dev/null &
+    local follow_pid=$!
+    sleep 1
+    ../bookmarks.sh add 'Followed' cmd 'echo followed' > /dev/null
+    wait "$follow_pid" 2>/dev/null || true
+    run_test "changes --follow streams new generations" \
+        "grep -qP '^13\tadd\t' '$follow_out'"
+
+    # Test 8: Concurrent writers never overwrite each other's changes
+    local two_count generation_before
+    two_count=$(jq '.bookmarks[] | select(.description == "Gen Two") | .access_count' "$TEST_BOOKMARKS_FILE")
+    generation_before=$(jq '.generation' "$TEST_BOOKMARKS_FILE")
+    for i in 1 2 3 4 5 6; do
+        BACKGROUND_MAINTENANCE_INTERVAL=0 ../bookmarks.sh add "Concurrent $i" cmd "echo $i" > /dev/null 2>&1 &
+        BACKGROUND_MAINTENANCE_INTERVAL=0 ../bookmarks.sh 'Gen Two' > /dev/null 2>&1 &
+    done
+    wait
+    run_test "Concurrent adds are all kept" \
+        "[ \$(jq '[.bookmarks[] | select(.description | startswith(\"Concurrent \"))] | length' '$TEST_BOOKMARKS_FILE') -eq 6 ]"
+    run_test "Concurrent accesses are all counted" \
+        "[ \$(jq '.bookmarks[] | select(.description == \"Gen Two\") | .access_count' '$TEST_BOOKMARKS_FILE') -eq $((two_count + 6)) ]"
+    run_test "Each concurrent write gets its own generation" \
+        "[ \"\$(jq '.generation' '$TEST_BOOKMARKS_FILE')\" = '$((generation_before + 12))' ] && \
+         [ \$(cut -f1 '$log_file' | uniq | sort | uniq -d | wc -l) -eq 0 ]"
+
+    # Summary
+    echo ""
+    echo -e "${BLUE}Test summary:${NC}"
+    echo -e "  ${GREEN}Tests passed: $TESTS_PASSED${NC}"
+    echo -e "  ${RED}Tests failed: $TESTS_FAILED${NC}"
+    echo -e "  Total tests: $TOTAL_TESTS"
+
+    if [ "$TESTS_FAILED" -eq 0 ]; then
+        echo -e "${GREEN}All change feed tests passed! 🎉${NC}"
+        return 0
+    else
+        echo -e "${RED}Some tests failed.${NC}"
+        return 1
+    fi
+}
+
+# Main execution
+setup_test_env
+run_test_suite
+TEST_RESULT=$?
+cleanup_test_env
+
+exit $TEST_RESULT
@@ -0,0 +1,91 @@
+#!/bin/bash
+
+# Test suite for working-directory and git-repository context boosting
+# Covers the per-context index, concurrent updates and its effect on listing,
+# search and completion
+
+# Source the shared test framework
+SCRIPT_DIR="$(cd "$(dirname "${BASH_SOURCE[0]}")" && pwd)"
+source "$SCRIPT_DIR/test_framework.sh"
+
+BOOKMARKS_SCRIPT="$SCRIPT_DIR/../bookmarks.sh"
+
+# Run the test suite
+run_test_suite() {
+    echo -e "${BLUE}Starting context boosting test suite${NC}"
+
+    local repo="$TEST_DIR/work/project"
+    local elsewhere="$TEST_DIR/work/other"
+    mkdir -p "$repo/.git" "$repo/src" "$elsewhere"
+
+    ../bookmarks.sh add 'Deploy Everywhere' cmd "echo everywhere > '$TEST_DIR/ran.txt'" > /dev/null
+    ../bookmarks.sh add 'Deploy Project' cmd "echo project > '$TEST_DIR/ran.txt'" > /dev/null
+    local project_id
+    project_id=$(jq -r '.bookmarks[] | select(.description == "Deploy Project") | .id' "$TEST_BOOKMARKS_FILE")
+
+    # Test 1: An access is counted against the directory and the repository
+    (cd "$repo/src" && "$BOOKMARKS_SCRIPT" 'Deploy Project' > /dev/null 2>&1)
+    run_test "Access is recorded for the working directory" \
+        "jq -e --arg id '$project_id' '.path == \"$repo/src\" and .counts[\$id] == 1' \"$TEST_DIR/contexts/dir-${repo//\//%2F}%2Fsrc.json\" > /dev/null"
+    run_test "Access is recorded for the git top level" \
+        "jq -e --arg id '$project_id' '.path == \"$repo\" and .counts[\$id] == 1' \"$TEST_DIR/contexts/git-${repo//\//%2F}.json\" > /dev/null"
+
+    # Give the other bookmark a clearly higher frecency
+    jq '.bookmarks |= map(if .description == "Deploy Everywhere" then .frecency_score = 150000
+                          else .frecency_score = 50000 end)' \
+        "$TEST_BOOKMARKS_FILE" > "$TEST_DIR/b.json" && mv "$TEST_DIR/b.json" "$TEST_BOOKMARKS_FILE"
+
+    # Test 2: Bookmarks used in the current repository are listed first
+    run_test "Context bookmark ranks first inside the repository" \
+        "(cd '$repo' && '$BOOKMARKS_SCRIPT' list | head -n 1 | grep -q 'Deploy Project')"
+    run_test "Frecency order applies elsewhere" \
+        "(cd '$elsewhere' && '$BOOKMARKS_SCRIPT' list | head -n 1 | grep -q 'Deploy Everywhere')"
+
+    # Test 3: Non-interactive search prefers the context bookmark
+    run_test "Search runs the context bookmark inside the repository" \
+        "(cd '$repo/src' && '$BOOKMARKS_SCRIPT' Deploy > /dev/null 2>&1) && grep -q project '$TEST_DIR/ran.txt'"
+
+    # Test 4: Completion uses the same order
+    run_test "Completion lists the context bookmark first" \
+        "(source '$SCRIPT_DIR/../completions/bookmark-completion.bash' && cd '$repo' && \
+          [ \"\$(_bookmark_ranked_descriptions | head -n 1)\" = 'Deploy Project' ])"
+
+    # Test 5: maintain drops contexts whose directory is gone
+    rm -rf "$repo/src"
+    ../bookmarks.sh maintain > /dev/null 2>&1
+    run_test "Contexts of removed directories are pruned" \
+        "[ ! -f \"$TEST_DIR/contexts/dir-${repo//\//%2F}%2Fsrc.json\" ] && [ -f \"$TEST_DIR/contexts/git-${repo//\//%2F}.json\" ]"
+
+    # Test 6: Overlapping accesses do not lose context counts
+    local everywhere_id i
+    everywhere_id=$(jq -r '.bookmarks[] | select(.description == "Deploy Everywhere") | .id' "$TEST_BOOKMARKS_FILE")
+    for i in 1 2 3 4 5 6 7 8; do
+        (cd "$elsewhere" && "$BOOKMARKS_SCRIPT" 'Deploy Everywhere' > /dev/null 2>&1) &
+    done
+    wait
+    run_test "Concurrent accesses are all counted" \
+        "jq -e --arg id '$everywhere_id' '.counts[\$id] == 8' \"$TEST_DIR/contexts/dir-${elsewhere//\//%2F}.json\" > /dev/null"
+
+    # Summary
+    echo ""
+    echo -e "${BLUE}Test summary:${NC}"
+    echo -e "  ${GREEN}Tests passed: $TESTS_PASSED${NC}"
+    echo -e "  ${RED}Tests failed: $TESTS_FAILED${NC}"
+    echo -e "  Total tests: $TOTAL_TESTS"
+
+    if [ "$TESTS_FAILED" -eq 0 ]; then
+        echo -e "${GREEN}All context boosting tests passed! 🎉${NC}"
+        return 0
+    else
+        echo -e "${RED}Some tests failed.${NC}"
+        return 1
+    fi
+}
+
+# Main execution
+setup_test_env
+run_test_suite
+TEST_RESULT=$?
+cleanup_test_env
+
+exit $TEST_RESULT
@@ -0,0 +1,158 @@
+#!/bin/bash
+
+# Test suite for reusing a running editor server
+# Covers Neovim and Emacs server detection, the cached socket, non-blocking
+# edit bookmarks and the blocking edit flow, using editor stand-ins
+
+# Source the shared test framework
+SCRIPT_DIR="$(cd "$(dirname "${BASH_SOURCE[0]}")" && pwd)"
+source "$SCRIPT_DIR/test_framework.sh"
+
+# Create a Unix socket at a path
+# Args: $1 - socket path
+make_socket() {
+    mkdir -p "$(dirname "$1")"
+    python3 -c 'import socket, sys; socket.socket(socket.AF_UNIX).bind(sys.argv[1])' "$1"
+}
+
+# Install nvim and emacsclient stand-ins that log each call to editor.log
+# Files are "edited" by replacing "original" with "changed". For a remote
+# nvim the change is made at the first --remote-expr poll, as if the user
+# saved then, and the window closes at the second
+install_editor_doubles() {
+    mkdir -p "$TEST_DIR/bin"
+    cat > "$TEST_DIR/bin/nvim" << NVIM
+#!/bin/bash
+log="$TEST_DIR/editor.log"
+if [ "\$1" != "--server" ]; then
+    echo "fresh \$*" >> "\$log"
+    sed -i 's/original/changed/' "\$1"
+    exit 0
+fi
+case "\$3" in
+    --remote)
+        shift 3
+        echo "remote \$*" >> "\$log"
+        printf '%s\n' "\$@" > "$TEST_DIR/remote_files"
+        rm -f "$TEST_DIR/polls"
+        ;;
+    --remote-expr)
+        echo poll >> "$TEST_DIR/polls"
+        echo "poll" >> "\$log"
+        if [ \$(wc -l < "$TEST_DIR/polls") -eq 1 ]; then
+            sed -i 's/original/changed/' "\$(cat "$TEST_DIR/remote_files")"
+            echo 1000
+        else
+            echo -1
+        fi
+        ;;
+esac
+NVIM
+    cat > "$TEST_DIR/bin/emacsclient" << EMACS
+#!/bin/bash
+if [ "\$1" = "-n" ]; then
+    echo "emacs-nowait \$*" >> "$TEST_DIR/editor.log"
+else
+    echo "emacs-wait \$*" >> "$TEST_DIR/editor.log"
+    sed -i 's/original/changed/' "\${@: -1}"
+fi
+EMACS
+    chmod +x "$TEST_DIR/bin/nvim" "$TEST_DIR/bin/emacsclient"
+}
+
+# Command stored for a bookmark
+# Args: $1 - description
+command_of() {
+    jq -r --arg d "$1" '.bookmarks[] | select(.description == $d) | .command' "$TEST_BOOKMARKS_FILE"
+}
+
+# Run the test suite
+run_test_suite() {
+    echo -e "${BLUE}Starting editor server test suite${NC}"
+
+    install_editor_doubles
+    export PATH="$TEST_DIR/bin:$PATH"
+    export EDITOR=nvim XDG_RUNTIME_DIR="$TEST_DIR/run"
+    unset NVIM NVIM_LISTEN_ADDRESS BOOKMARKS_EDITOR EMACS_SOCKET_NAME
+    mkdir -p "$XDG_RUNTIME_DIR"
+    ../bookmarks.sh add 'Deploy' cmd "echo original" > /dev/null
+    ../bookmarks.sh add 'Todo' edit "'$TEST_DIR/todo.txt'" > /dev/null
+
+    # Test 1: Without a server the editor is started as before
+    ../bookmarks.sh edit 'Deploy' > /dev/null 2>&1
+    run_test "A fresh editor is started when no server runs" \
+        "grep -q '^fresh ' '$TEST_DIR/editor.log' && [ \"\$(command_of Deploy)\" = 'echo changed' ]"
+
+    # Test 2: The edit flow uses a running Neovim and waits for the file
+    ../bookmarks.sh update 'Deploy' cmd "echo original" > /dev/null
+    rm -f "$TEST_DIR/editor.log"
+    make_socket "$TEST_DIR/nvim-inside.sock"
+    NVIM="$TEST_DIR/nvim-inside.sock" ../bookmarks.sh edit 'Deploy' > /dev/null 2>&1
+    run_test "The edit flow opens the file in the running Neovim" \
+        "grep -q '^remote /tmp/bookmark_edit_' '$TEST_DIR/editor.log' && ! grep -q '^fresh' '$TEST_DIR/editor.log'"
+    run_test "The edit flow waits until the file is closed" \
+        "[ \$(grep -c '^poll' '$TEST_DIR/editor.log') -eq 2 ] && [ \"\$(command_of Deploy)\" = 'echo changed' ]"
+
+    # Test 3: edit bookmarks open in the server without blocking
+    rm -f "$TEST_DIR/editor.log"
+    NVIM="$TEST_DIR/nvim-inside.sock" ../bookmarks.sh 'Todo' > /dev/null 2>&1
+    run_test "edit bookmarks do not wait for the editor" \
+        "grep -q \"^remote $TEST_DIR/todo.txt\" '$TEST_DIR/editor.log' && ! grep -q '^poll' '$TEST_DIR/editor.log'"
+
+    # Test 4: A scanned socket is cached and dropped once it is gone
+    rm -f "$TEST_DIR/editor.log"
+    make_socket "$XDG_RUNTIME_DIR/nvim.4242.0"
+    ../bookmarks.sh 'Todo' > /dev/null 2>&1
+    run_test "Default socket locations are scanned and cached" \
+        "grep -q '^remote' '$TEST_DIR/editor.log' && [ \"\$(cut -f 1 '$TEST_DIR/.editor_server')\" = nvim ] && \
+         [ \"\$(cut -f 2 '$TEST_DIR/.editor_server')\" = '$XDG_RUNTIME_DIR/nvim.4242.0' ]"
+    rm -f "$XDG_RUNTIME_DIR/nvim.4242.0" "$TEST_DIR/editor.log"
+    ../bookmarks.sh 'Todo' > /dev/null 2>&1
+    run_test "A vanished server falls back to a fresh editor" \
+        "grep -q '^fresh' '$TEST_DIR/editor.log' && [ ! -f '$TEST_DIR/.editor_server' ]"
+
+    # Test 5: BOOKMARKS_EDITOR_SERVER=off never uses a server
+    rm -f "$TEST_DIR/editor.log"
+    BOOKMARKS_EDITOR_SERVER=off NVIM="$TEST_DIR/nvim-inside.sock" ../bookmarks.sh 'Todo' > /dev/null 2>&1
+    run_test "BOOKMARKS_EDITOR_SERVER=off starts a fresh editor" \
+        "grep -q '^fresh' '$TEST_DIR/editor.log' && ! grep -q '^remote' '$TEST_DIR/editor.log'"
+
+    # Test 6: emacsclient blocks only for the edit flow
+    rm -f "$TEST_DIR/editor.log"
+    make_socket "$XDG_RUNTIME_DIR/emacs/server"
+    ../bookmarks.sh update 'Deploy' cmd "echo original" > /dev/null
+    EDITOR=emacsclient ../bookmarks.sh edit 'Deploy' > /dev/null 2>&1
+    EDITOR=emacsclient ../bookmarks.sh 'Todo' > /dev/null 2>&1
+    run_test "The edit flow waits for emacsclient" \
+        "grep -q \"^emacs-wait -s $XDG_RUNTIME_DIR/emacs/server /tmp/bookmark_edit_\" '$TEST_DIR/editor.log' && \
+         [ \"\$(command_of Deploy)\" = 'echo changed' ]"
+    run_test "edit bookmarks use emacsclient -n" \
+        "grep -q \"^emacs-nowait -n -s $XDG_RUNTIME_DIR/emacs/server $TEST_DIR/todo.txt\" '$TEST_DIR/editor.log'"
+
+    # Test 7: doctor reports the server
+    run_test "doctor shows the editor server" \
+        "EDITOR=emacsclient ../bookmarks.sh doctor | grep -q 'Editor server: .*emacs at $XDG_RUNTIME_DIR/emacs/server'"
+
+    # Summary
+    echo ""
+    echo -e "${BLUE}Test summary:${NC}"
+    echo -e "  ${GREEN}Tests passed: $TESTS_PASSED${NC}"
+    echo -e "  ${RED}Tests failed: $TESTS_FAILED${NC}"
+    echo -e "  Total tests: $TOTAL_TESTS"
+
+    if [ "$TESTS_FAILED" -eq 0 ]; then
+        echo -e "${GREEN}All editor server tests passed! 🎉${NC}"
+        return 0
+    else
+        echo -e "${RED}Some tests failed.${NC}"
+        return 1
+    fi
+}
+
+# Main execution
+setup_test_env
+run_test_suite
+TEST_RESULT=$?
+cleanup_test_env
+
+exit $TEST_RESULT
@@ -89,6 +89,49 @@ OLDFORMAT
          score=\$(jq -r '.bookmarks[0].frecency_score' \$TEST_BOOKMARKS_FILE) && \
          [ \"\$score\" != 'null' ]"
     
+    # Test 11: Counts are aged once their total passes the maximum rank
+    jq '.bookmarks |= map(.access_count = 0 | .last_accessed = null)
+        | .bookmarks[0] += {access_count: 150, last_accessed: "2025-10-26 23:00:00"}
+        | .bookmarks[1] += {access_count: 1, last_accessed: "2025-10-26 23:00:00"}' \
+        "$TEST_BOOKMARKS_FILE" > "$TEST_BOOKMARKS_FILE.tmp" && mv "$TEST_BOOKMARKS_FILE.tmp" "$TEST_BOOKMARKS_FILE"
+    FRECENCY_MAX_RANK=100 ../bookmarks.sh maintain > /dev/null 2>&1
+    run_test "Counts are scaled down past the maximum rank" \
+        "[ \"\$(jq '.bookmarks[0].access_count' \$TEST_BOOKMARKS_FILE)\" = '89.4' ]"
+    run_test "Counts below 1 drop out of the ranking" \
+        "jq -e '.bookmarks[1] | .access_count == 0 and .frecency_score == 0' \$TEST_BOOKMARKS_FILE > /dev/null"
+    run_test "Aged counts keep increasing on access" \
+        "../bookmarks.sh \"\$(jq -r '.bookmarks[0].description' \$TEST_BOOKMARKS_FILE)\" > /dev/null 2>&1 && \
+         [ \"\$(jq '.bookmarks[0].access_count' \$TEST_BOOKMARKS_FILE)\" = '90.4' ]"
+
+    # Test 12: Accesses fill the usage histogram
+    ../bookmarks.sh add 'Usage Test' cmd 'echo usage' > /dev/null
+    ../bookmarks.sh 'Usage Test' > /dev/null 2>&1
+    ../bookmarks.sh 'Usage Test' > /dev/null 2>&1
+    run_test "Access updates hour-of-week and daily buckets" \
+        "jq -e '.bookmarks[] | select(.description == \"Usage Test\") | .usage
+                | ([.week[]] | add) == 2 and (.days | length) == 14 and (.days | add) == 2' \$TEST_BOOKMARKS_FILE > /dev/null"
+
+    # Test 13: Days older than the ring are forgotten
+    jq '.bookmarks |= map(if .description == "Usage Test" then .usage.day -= 20 else . end)' \
+        "$TEST_BOOKMARKS_FILE" > "$TEST_BOOKMARKS_FILE.tmp" && mv "$TEST_BOOKMARKS_FILE.tmp" "$TEST_BOOKMARKS_FILE"
+    ../bookmarks.sh 'Usage Test' > /dev/null 2>&1
+    run_test "Daily ring drops days older than two weeks" \
+        "jq -e '.bookmarks[] | select(.description == \"Usage Test\") | .usage | (.days | add) == 1 and ([.week[]] | add) == 3' \$TEST_BOOKMARKS_FILE > /dev/null"
+
+    # Test 14: The preview shows usage sparklines
+    run_test "Preview shows usage sparklines" \
+        "../bookmarks.sh _preview_details 'Usage Test' | grep -q '^Last 14 Days: .*█'"
+
+    # Test 15: Time-aware ranking favours bookmarks used at this time of week
+    jq '.bookmarks |= map(if .description == "Usage Test" then .frecency_score = 1000
+                          elif .description == "Calc Test" then .frecency_score = 2000 | .usage = {week: {"-1": 5}} else .frecency_score = 0 end)' \
+        "$TEST_BOOKMARKS_FILE" > "$TEST_BOOKMARKS_FILE.tmp" && mv "$TEST_BOOKMARKS_FILE.tmp" "$TEST_BOOKMARKS_FILE"
+    # Listed from a directory with no context history, so context boosting stays out
+    run_test "Default ranking uses frecency alone" \
+        "(cd '$TEST_DIR' && '$SCRIPT_DIR/../bookmarks.sh' list | head -n 1 | grep -q 'Calc Test')"
+    run_test "Time-aware ranking boosts usage at this hour" \
+        "(cd '$TEST_DIR' && BOOKMARKS_RANKING=time '$SCRIPT_DIR/../bookmarks.sh' list | head -n 1 | grep -q 'Usage Test')"
+
     echo ""
     echo -e "${BLUE}Test summary:${NC}"
     echo -e "  ${GREEN}Tests passed: $TESTS_PASSED${NC}"
@@ -0,0 +1,99 @@
+#!/bin/bash
+
+# Test suite for the access history and `bookmark history`
+# Covers the day-bucketed log, range and filter queries, JSON output and retention
+
+# Source the shared test framework
+SCRIPT_DIR="$(cd "$(dirname "${BASH_SOURCE[0]}")" && pwd)"
+source "$SCRIPT_DIR/test_framework.sh"
+
+# Write a history entry into the bucket for its local day
+# Args: $1 - epoch seconds, $2 - description, $3 - type, $4 - tags
+add_history_entry() {
+    local day
+    printf -v day '%(%Y-%m-%d)T' "$1"
+    mkdir -p "$TEST_DIR/history"
+    jq -nc --argjson t "$1" --arg d "$2" --arg type "$3" --arg tags "$4" \
+        '{t: $t, id: "old", description: $d, type: $type, tags: $tags, command: "true", cwd: "/"}' \
+        >> "$TEST_DIR/history/$day.jsonl"
+}
+
+# Run the test suite
+run_test_suite() {
+    echo -e "${BLUE}Starting access history test suite${NC}"
+
+    ../bookmarks.sh add 'Restart API' cmd "echo restart > /dev/null" 'ops incident' > /dev/null
+    ../bookmarks.sh add 'Status Page' cmd "echo status > /dev/null" 'web' > /dev/null
+
+    # Test 1: Executing a bookmark appends to today's bucket
+    ../bookmarks.sh 'Restart API' > /dev/null 2>&1
+    local today
+    printf -v today '%(%Y-%m-%d)T' -1
+    run_test "Access is appended to today's bucket" \
+        "jq -e -s 'length == 1 and .[0].description == \"Restart API\" and .[0].command == \"echo restart > /dev/null\"' \"$TEST_DIR/history/$today.jsonl\" > /dev/null"
+    run_test "Recent accesses are listed by default" \
+        "../bookmarks.sh history | grep -q 'Restart API'"
+
+    # Test 2: Ranges only cover the requested window
+    local day_ago=$((EPOCHSECONDS - 86400)) month_ago=$((EPOCHSECONDS - 30 * 86400))
+    add_history_entry "$day_ago" 'Yesterday Check' cmd 'ops'
+    add_history_entry "$month_ago" 'Incident Rollback' cmd 'ops incident'
+    run_test "Default range skips older history" \
+        "! ../bookmarks.sh history | grep -q 'Incident Rollback'"
+    run_test "--since and --until select a window" \
+        "out=\$(../bookmarks.sh history --since $((month_ago - 60)) --until $((day_ago + 60))) && \
+         echo \"\$out\" | grep -q 'Incident Rollback' && echo \"\$out\" | grep -q 'Yesterday Check' && \
+         ! echo \"\$out\" | grep -q 'Restart API'"
+    run_test "Dates understood by date -d are accepted" \
+        "../bookmarks.sh history --since '40 days ago' --until '20 days ago' | grep -q 'Incident Rollback'"
+
+    # Test 3: Buckets outside the range are never opened
+    echo 'not json' > "$TEST_DIR/history/2000-01-01.jsonl"
+    run_test "Range queries only read buckets in range" \
+        "../bookmarks.sh history --since '2 days ago' > /dev/null"
+
+    # Test 4: Type and tag filters
+    run_test "--tag filters entries" \
+        "out=\$(../bookmarks.sh history --since '40 days ago' --tag incident) && \
+         echo \"\$out\" | grep -q 'Incident Rollback' && ! echo \"\$out\" | grep -q 'Yesterday Check'"
+    run_test "--type filters entries" \
+        "! ../bookmarks.sh history --since '40 days ago' --type url | grep -q 'Restart API'"
+
+    # Test 5: JSON output for timelines
+    run_test "--json prints one object per access, oldest first" \
+        "../bookmarks.sh history --since '40 days ago' --json | \
+         jq -e -s 'map(.description) == [\"Incident Rollback\", \"Yesterday Check\", \"Restart API\"] and all(.[]; .time and .t)' > /dev/null"
+
+    # Test 6: Bad bounds are rejected
+    run_test "Unparseable bounds are rejected" \
+        "../bookmarks.sh history --since 'not a date'" 1
+
+    # Test 7: maintain drops buckets past the retention period
+    HISTORY_RETENTION_DAYS=7 ../bookmarks.sh maintain > /dev/null 2>&1
+    run_test "Old history buckets are pruned by maintain" \
+        "[ ! -f \"$TEST_DIR/history/2000-01-01.jsonl\" ] && [ -f \"$TEST_DIR/history/$today.jsonl\" ] && \
+         ! ../bookmarks.sh history --since '40 days ago' | grep -q 'Incident Rollback'"
+
+    # Summary
+    echo ""
+    echo -e "${BLUE}Test summary:${NC}"
+    echo -e "  ${GREEN}Tests passed: $TESTS_PASSED${NC}"
+    echo -e "  ${RED}Tests failed: $TESTS_FAILED${NC}"
+    echo -e "  Total tests: $TOTAL_TESTS"
+
+    if [ "$TESTS_FAILED" -eq 0 ]; then
+        echo -e "${GREEN}All access history tests passed! 🎉${NC}"
+        return 0
+    else
+        echo -e "${RED}Some tests failed.${NC}"
+        return 1
+    fi
+}
+
+# Main execution
+setup_test_env
+run_test_suite
+TEST_RESULT=$?
+cleanup_test_env
+
+exit $TEST_RESULT
@@ -0,0 +1,160 @@
+#!/bin/bash
+
+# Test suite for the hook system
+# Covers the asynchronous hook queue, coalescing, timeouts and --sync-hooks
+
+# Source the shared test framework
+SCRIPT_DIR="$(cd "$(dirname "${BASH_SOURCE[0]}")" && pwd)"
+source "$SCRIPT_DIR/test_framework.sh"
+
+# Wait until the hook spool is drained and no worker holds the lock
+# Args: $1 - maximum seconds to wait (default 10)
+wait_for_hooks() {
+    local max_wait="${1:-10}"
+    local waited=0
+    while [ "$waited" -lt $((max_wait * 10)) ]; do
+        if ! ls "$TEST_DIR/.hook_spool/"*.event > /dev/null 2>&1 && \
+           flock -n "$TEST_DIR/.hook_spool/.lock" true 2>/dev/null; then
+            return 0
+        fi
+        sleep 0.1
+        waited=$((waited + 1))
+    done
+    return 1
+}
+
+# Install a hook script
+# Args: $1 - hook name, $2 - script body
+install_hook() {
+    printf '#!/bin/bash\n%s\n' "$2" > "$TEST_DIR/hooks/$1.sh"
+    chmod +x "$TEST_DIR/hooks/$1.sh"
+}
+
+# Run the test suite
+run_test_suite() {
+    echo -e "${BLUE}Starting hook system test suite${NC}"
+
+    mkdir -p "$TEST_DIR/hooks"
+    local runs_file="$TEST_DIR/runs.txt"
+
+    # Test 1: --sync-hooks runs the hook before the command returns
+    install_hook after_add "echo \"sync \$BOOKMARKS_HOOK_EVENT_COUNT\" >> \"\$1/runs.txt\""
+    run_test "Sync hooks run in the foreground" \
+        "../bookmarks.sh --sync-hooks add 'Sync Hook' cmd 'echo sync' > /dev/null && grep -q '^sync 1' '$runs_file'"
+    rm -f "$runs_file"
+
+    # Test 2: Default mode returns before a slow hook finishes
+    install_hook after_add "sleep 2; echo \"async \$BOOKMARKS_HOOK_EVENT_COUNT\" >> \"\$1/runs.txt\""
+    local start end
+    start=$(date +%s)
+    ../bookmarks.sh add 'Async Hook' cmd 'echo async' > /dev/null
+    end=$(date +%s)
+    run_test "Async hooks do not block the command" \
+        "[ $((end - start)) -lt 2 ]"
+
+    run_test "Async hook eventually runs" \
+        "wait_for_hooks && grep -q '^async' '$runs_file'"
+    rm -f "$runs_file"
+
+    # Test 3: A burst of events is coalesced into fewer hook runs
+    install_hook after_add "sleep 1; echo \"burst \$BOOKMARKS_HOOK_EVENT_COUNT\" >> \"\$1/runs.txt\""
+    local i
+    for i in 1 2 3 4; do
+        ../bookmarks.sh add "Burst $i" cmd "echo $i" > /dev/null
+    done
+    wait_for_hooks 15
+    run_test "Burst of events is coalesced" \
+        "[ \$(wc -l < '$runs_file') -lt 4 ]"
+    run_test "Coalesced runs account for every event" \
+        "[ \$(awk '{s += \$2} END {print s}' '$runs_file') -eq 4 ]"
+    rm -f "$runs_file"
+
+    # Test 4: Hooks exceeding their timeout are killed and logged
+    install_hook after_add "sleep 5; echo late >> \"\$1/runs.txt\""
+    HOOK_TIMEOUT_after_add=1 ../bookmarks.sh add 'Timeout Hook' cmd 'echo timeout' > /dev/null
+    wait_for_hooks 10
+    run_test "Hook timeout is enforced" \
+        "[ ! -f '$runs_file' ] && grep -q 'timed out' '$TEST_DIR/hooks.log'"
+
+    rm -f "$TEST_DIR/hooks/after_add.sh"
+
+    # Test 5: Hooks receive a JSON event with before/after records on stdin
+    local target_id
+    target_id=$(jq -r '.bookmarks[] | select(.description == "Sync Hook") | .id' "$TEST_BOOKMARKS_FILE")
+    ../bookmarks.sh update 'Sync Hook' cmd 'echo changed' > /dev/null
+    install_hook after_update "cat > \"\$1/event.json\""
+    ../bookmarks.sh --sync-hooks update 'Sync Hook' cmd 'echo changed again' > /dev/null
+    run_test "Event names the operation and affected ids" \
+        "jq -e --arg id '$target_id' '.operation == \"update\" and .ids == [\$id]' '$TEST_DIR/event.json' > /dev/null"
+    run_test "Event carries before and after records" \
+        "jq -e '.before[0].command == \"echo changed\" and .after[0].command == \"echo changed again\"' '$TEST_DIR/event.json' > /dev/null"
+    run_test "Event carries the store generation" \
+        "jq -e '.generation | type == \"number\"' '$TEST_DIR/event.json' > /dev/null"
+
+    # Test 6: Deletions put the removed record in "before"
+    install_hook after_delete "cat > \"\$1/event.json\""
+    ../bookmarks.sh --sync-hooks -y delete 'Burst 1' > /dev/null
+    run_test "Delete event lists the removed record" \
+        "jq -e '.before[0].description == \"Burst 1\" and .after == []' '$TEST_DIR/event.json' > /dev/null"
+
+    # Test 7: Scripts in hooks/<event>.d/ run in parallel, each with the event
+    mkdir -p "$TEST_DIR/hooks/after_add.d"
+    local n
+    for n in 1 2 3; do
+        printf '#!/bin/bash\nsleep 2\njq -r ".after[0].description" > "$1/d%s.out"\n' "$n" > "$TEST_DIR/hooks/after_add.d/$n.sh"
+        chmod +x "$TEST_DIR/hooks/after_add.d/$n.sh"
+    done
+    start=$(date +%s)
+    ../bookmarks.sh --sync-hooks add 'Parallel Hooks' cmd 'echo parallel' > /dev/null
+    end=$(date +%s)
+    run_test "Every .d script receives the event" \
+        "grep -q 'Parallel Hooks' '$TEST_DIR/d1.out' && grep -q 'Parallel Hooks' '$TEST_DIR/d2.out' && grep -q 'Parallel Hooks' '$TEST_DIR/d3.out'"
+    run_test ".d scripts run in parallel" \
+        "[ $((end - start)) -lt 5 ]"
+
+    # Test 8: .d entries are executed directly, whatever their interpreter
+    rm -rf "$TEST_DIR/hooks/after_add.d"
+    mkdir -p "$TEST_DIR/hooks/after_add.d"
+    printf '#!/usr/bin/env perl\nmy $line = <STDIN>;\nopen(my $out, ">", "$ARGV[0]/perl.out");\nprint $out $line;\n' \
+        > "$TEST_DIR/hooks/after_add.d/10-perl"
+    chmod +x "$TEST_DIR/hooks/after_add.d/10-perl"
+    ../bookmarks.sh --sync-hooks add 'Perl Hook' cmd 'echo perl' > /dev/null 2>&1
+    run_test "A .d script runs with its own interpreter" \
+        "grep -q 'Perl Hook' '$TEST_DIR/perl.out'"
+
+    # Test 9: An empty .d directory does not queue events
+    rm -rf "$TEST_DIR/hooks/after_add.d" "$TEST_DIR/.hook_spool"
+    mkdir -p "$TEST_DIR/hooks/after_obsolete.d"
+    ../bookmarks.sh -y obsolete 'Perl Hook' > /dev/null 2>&1
+    run_test "Empty hook directory queues nothing" \
+        "[ ! -d '$TEST_DIR/.hook_spool' ]"
+
+    # Test 10: No hook fires when nothing changed
+    rm -f "$TEST_DIR/event.json"
+    ../bookmarks.sh --sync-hooks delete 'Parallel Hooks' > /dev/null 2>&1 <<< 'n'
+    run_test "Cancelled operation does not fire hooks" \
+        "[ ! -f '$TEST_DIR/event.json' ]"
+
+    # Summary
+    echo ""
+    echo -e "${BLUE}Test summary:${NC}"
+    echo -e "  ${GREEN}Tests passed: $TESTS_PASSED${NC}"
+    echo -e "  ${RED}Tests failed: $TESTS_FAILED${NC}"
+    echo -e "  Total tests: $TOTAL_TESTS"
+
+    if [ "$TESTS_FAILED" -eq 0 ]; then
+        echo -e "${GREEN}All hook tests passed! 🎉${NC}"
+        return 0
+    else
+        echo -e "${RED}Some tests failed.${NC}"
+        return 1
+    fi
+}
+
+# Main execution
+setup_test_env
+run_test_suite
+TEST_RESULT=$?
+cleanup_test_env
+
+exit $TEST_RESULT
@@ -0,0 +1,112 @@
+#!/bin/bash
+
+# Test suite for host groups
+# Covers `hosts`, the host_group setting, fan-out with {host}, the job limit,
+# timeouts and the result table, using an ssh stand-in
+
+# Source the shared test framework
+SCRIPT_DIR="$(cd "$(dirname "${BASH_SOURCE[0]}")" && pwd)"
+source "$SCRIPT_DIR/test_framework.sh"
+
+# Install an ssh stand-in: skips -o options, runs the command locally, hangs on slow-* hosts,
+# refuses bad-* hosts and logs how many hosts were busy when each started
+install_ssh_double() {
+    mkdir -p "$TEST_DIR/bin" "$TEST_DIR/busy"
+    cat > "$TEST_DIR/bin/ssh" << SSH
+#!/bin/bash
+while [ "\$1" = "-o" ]; do
+    shift 2
+done
+host="\$1"
+shift
+touch "$TEST_DIR/busy/\$host"
+ls "$TEST_DIR/busy" | wc -l >> "$TEST_DIR/concurrency"
+case "\$host" in
+    slow-*) sleep 5 ;;
+    bad-*) echo "\$host: connection refused" >&2; rm -f "$TEST_DIR/busy/\$host"; exit 255 ;;
+esac
+sleep 0.3
+rm -f "$TEST_DIR/busy/\$host"
+echo "\$host: \$(eval "\$*")"
+SSH
+    chmod +x "$TEST_DIR/bin/ssh"
+}
+
+# Run the test suite
+run_test_suite() {
+    echo -e "${BLUE}Starting host group test suite${NC}"
+
+    install_ssh_double
+    export PATH="$TEST_DIR/bin:$PATH"
+
+    # Test 1: Groups are defined, listed and validated
+    run_test "Host groups can be defined" \
+        "../bookmarks.sh hosts web web-1 web-2 web-3 web-4 > /dev/null && ../bookmarks.sh hosts | grep -q 'web .*web-1 web-2 web-3 web-4'"
+    run_test "Host names with shell characters are rejected" \
+        "../bookmarks.sh hosts evil 'web-1;reboot'" 1
+    run_test "Redefining a group replaces its hosts" \
+        "../bookmarks.sh hosts db db-1 > /dev/null && ../bookmarks.sh hosts db db-1 db-2 > /dev/null && \
+         [ \$(grep -c '^db=' '$TEST_DIR/host_groups') -eq 1 ] && grep -q '^db=db-1 db-2$' '$TEST_DIR/host_groups'"
+
+    # Test 2: The host_group setting is checked
+    ../bookmarks.sh add 'Disk Usage' ssh 'ssh {host} echo disk fine' > /dev/null
+    ../bookmarks.sh add 'Plain Login' ssh 'ssh web-1' > /dev/null
+    run_test "Unknown groups are rejected" \
+        "../bookmarks.sh set 'Disk Usage' host_group nowhere" 1
+    run_test "Commands without {host} are rejected" \
+        "../bookmarks.sh set 'Plain Login' host_group web" 1
+    run_test "host_group is stored" \
+        "../bookmarks.sh set 'Disk Usage' host_group web > /dev/null && \
+         jq -e '.bookmarks[] | select(.description == \"Disk Usage\") | .host_group == \"web\"' \"$TEST_BOOKMARKS_FILE\" > /dev/null"
+
+    # Test 3: One execution fans out across the group
+    HOST_JOBS=2 ../bookmarks.sh 'Disk Usage' > "$TEST_DIR/out.txt" 2>&1
+    run_test "Every host runs the command with {host} substituted" \
+        "[ \$(grep -c 'web-[1-4].* | web-[1-4]: disk fine' '$TEST_DIR/out.txt') -eq 4 ]"
+    run_test "No more than HOST_JOBS hosts run at once" \
+        "[ \$(sort -n '$TEST_DIR/concurrency' | tail -n 1) -eq 2 ]"
+    run_test "Result table lists each host" \
+        "grep -q '^  web-3 .*ok .* ms  web-3: disk fine' '$TEST_DIR/out.txt'"
+    run_test "The fan-out is recorded as one run" \
+        "jq -e '.bookmarks[] | select(.description == \"Disk Usage\") | .runs.count == 1 and .runs.last_status == 0' \"$TEST_BOOKMARKS_FILE\" > /dev/null"
+
+    # Test 4: Failures and timeouts are reported per host
+    ../bookmarks.sh hosts mixed web-1 bad-2 slow-3 > /dev/null
+    ../bookmarks.sh set 'Disk Usage' host_group mixed > /dev/null
+    run_test "A failing host fails the execution" \
+        "HOST_TIMEOUT=1 ../bookmarks.sh 'Disk Usage' > '$TEST_DIR/out.txt' 2>&1" 1
+    run_test "Timeouts and exit statuses are shown per host" \
+        "grep -q 'bad-2 .*exit 255' '$TEST_DIR/out.txt' && grep -q 'slow-3 .*timeout' '$TEST_DIR/out.txt' && \
+         grep -q 'web-1 .*ok' '$TEST_DIR/out.txt' && grep -q 'Failed on 2 of 3 hosts' '$TEST_DIR/out.txt'"
+
+    # Test 5: Deleting groups and clearing the setting
+    run_test "Groups can be deleted" \
+        "../bookmarks.sh hosts -d db > /dev/null && ! grep -q '^db=' '$TEST_DIR/host_groups'"
+    run_test "host_group off runs the command as is" \
+        "../bookmarks.sh set 'Disk Usage' host_group off > /dev/null && \
+         ../bookmarks.sh update 'Disk Usage' ssh 'ssh web-9 echo single' > /dev/null && \
+         ../bookmarks.sh 'Disk Usage' 2>&1 | grep -q '^web-9: single'"
+
+    # Summary
+    echo ""
+    echo -e "${BLUE}Test summary:${NC}"
+    echo -e "  ${GREEN}Tests passed: $TESTS_PASSED${NC}"
+    echo -e "  ${RED}Tests failed: $TESTS_FAILED${NC}"
+    echo -e "  Total tests: $TOTAL_TESTS"
+
+    if [ "$TESTS_FAILED" -eq 0 ]; then
+        echo -e "${GREEN}All host group tests passed! 🎉${NC}"
+        return 0
+    else
+        echo -e "${RED}Some tests failed.${NC}"
+        return 1
+    fi
+}
+
+# Main execution
+setup_test_env
+run_test_suite
+TEST_RESULT=$?
+cleanup_test_env
+
+exit $TEST_RESULT
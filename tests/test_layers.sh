@@ -0,0 +1,98 @@
+#!/bin/bash
+
+# Test suite for layered stores (BOOKMARKS_PATH)
+# Covers merged listing, read-only shared layers, personal overlays and caching
+
+# Source the shared test framework
+SCRIPT_DIR="$(cd "$(dirname "${BASH_SOURCE[0]}")" && pwd)"
+source "$SCRIPT_DIR/test_framework.sh"
+
+# Run the test suite
+run_test_suite() {
+    echo -e "${BLUE}Starting layered store test suite${NC}"
+
+    local shared_dir="$TEST_DIR/shared"
+    mkdir -p "$shared_dir"
+    BOOKMARKS_DIR="$shared_dir" ../bookmarks.sh add 'Team Runbook' cmd 'echo runbook' 'ops' > /dev/null
+    BOOKMARKS_DIR="$shared_dir" ../bookmarks.sh add 'Team Deploy' cmd 'echo deploy' 'ops' > /dev/null
+    local shared_before
+    shared_before=$(sha256sum "$shared_dir/bookmarks.json")
+
+    export BOOKMARKS_PATH="$shared_dir"
+    ../bookmarks.sh add 'Personal' cmd 'echo personal' > /dev/null
+
+    # Test 1: Listing and search merge both layers
+    run_test "List shows personal and shared bookmarks" \
+        "../bookmarks.sh list | grep -q 'Personal' && ../bookmarks.sh list | grep -q 'Team Runbook'"
+    run_test "Tag search includes shared bookmarks" \
+        "../bookmarks.sh tag ops | grep -q 'Team Deploy'"
+
+    # Test 2: Executing a shared bookmark records stats in the overlay only
+    local generation_before
+    generation_before=$(jq '.generation' "$TEST_BOOKMARKS_FILE")
+    run_test "Shared bookmark executes" \
+        "../bookmarks.sh 'Team Runbook' | grep -q 'runbook'"
+    run_test "Access stats are kept in the personal overlay" \
+        "jq -e '.bookmarks[] | select(.description == \"Team Runbook\") | .overlay == \"stats\" and .access_count == 1' '$TEST_BOOKMARKS_FILE' > /dev/null"
+    run_test "The overlay is created in the access commit" \
+        "[ \"\$(jq '.generation' '$TEST_BOOKMARKS_FILE')\" = '$((generation_before + 1))' ]"
+    run_test "Shared layer is never written" \
+        "[ \"\$(sha256sum '$shared_dir/bookmarks.json')\" = '$shared_before' ]"
+
+    # Test 3: Stats overlays follow later changes to the shared record
+    BOOKMARKS_PATH="" BOOKMARKS_DIR="$shared_dir" ../bookmarks.sh update 'Team Runbook' cmd 'echo runbook v2' 'ops' > /dev/null
+    shared_before=$(sha256sum "$shared_dir/bookmarks.json")
+    run_test "Shared updates show through a stats overlay" \
+        "../bookmarks.sh _preview_details 'Team Runbook' | grep -q 'echo runbook v2'"
+
+    # Test 4: Editing a shared bookmark creates a personal copy
+    ../bookmarks.sh update 'Team Deploy' cmd 'echo my deploy' 'ops' > /dev/null
+    run_test "Personal edit overrides the shared record" \
+        "../bookmarks.sh _preview_details 'Team Deploy' | grep -q 'echo my deploy'"
+    run_test "Shared layer is unchanged by personal edits" \
+        "[ \"\$(sha256sum '$shared_dir/bookmarks.json')\" = '$shared_before' ]"
+
+    # Test 5: Shared records cannot be deleted; overrides can be dropped
+    run_test "Deleting a shared-only bookmark is refused" \
+        "../bookmarks.sh -y delete 'Team Runbook' > /dev/null 2>&1" 1
+    ../bookmarks.sh -y delete 'Team Deploy' > /dev/null
+    run_test "Deleting an override restores the shared record" \
+        "../bookmarks.sh _preview_details 'Team Deploy' | grep -q 'echo deploy'"
+
+    # Test 6: The merged view is reused while nothing changes
+    ../bookmarks.sh list > /dev/null
+    touch "$TEST_DIR/view.marker"
+    sleep 1
+    ../bookmarks.sh list > /dev/null
+    run_test "Unchanged layers reuse the cached view" \
+        "[ ! '$TEST_DIR/cache/view.json' -nt '$TEST_DIR/view.marker' ]"
+
+    unset BOOKMARKS_PATH
+
+    # Test 7: Without BOOKMARKS_PATH only the personal store is visible
+    run_test "Shared bookmarks disappear without BOOKMARKS_PATH" \
+        "! ../bookmarks.sh list | grep -q 'Team Deploy'"
+
+    # Summary
+    echo ""
+    echo -e "${BLUE}Test summary:${NC}"
+    echo -e "  ${GREEN}Tests passed: $TESTS_PASSED${NC}"
+    echo -e "  ${RED}Tests failed: $TESTS_FAILED${NC}"
+    echo -e "  Total tests: $TOTAL_TESTS"
+
+    if [ "$TESTS_FAILED" -eq 0 ]; then
+        echo -e "${GREEN}All layered store tests passed! 🎉${NC}"
+        return 0
+    else
+        echo -e "${RED}Some tests failed.${NC}"
+        return 1
+    fi
+}
+
+# Main execution
+setup_test_env
+run_test_suite
+TEST_RESULT=$?
+cleanup_test_env
+
+exit $TEST_RESULT
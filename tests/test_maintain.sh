@@ -0,0 +1,147 @@
+#!/bin/bash
+
+# Test suite for the maintain command
+# Covers retention policies, journal compaction, log rotation, locking and
+# the debounced background maintenance run
+
+# Source the shared test framework
+SCRIPT_DIR="$(cd "$(dirname "${BASH_SOURCE[0]}")" && pwd)"
+source "$SCRIPT_DIR/test_framework.sh"
+
+# Print the status of the bookmark with the given description in a store file
+# Args: $1 - store file, $2 - description
+status_in() {
+    jq -r --arg d "$2" '.bookmarks[] | select(.description == $d) | .status' "$1"
+}
+
+# Run the test suite
+run_test_suite() {
+    echo -e "${BLUE}Starting maintenance test suite${NC}"
+
+    local archive="$TEST_DIR/archive.json"
+    local journal="$TEST_DIR/journal.jsonl"
+
+    ../bookmarks.sh add 'Fresh Bookmark' cmd 'echo fresh' > /dev/null
+    ../bookmarks.sh add 'Old Bookmark' cmd 'echo old' > /dev/null
+    ../bookmarks.sh add 'Old Obsolete' cmd 'echo gone' > /dev/null
+
+    # Backdate two bookmarks; one is obsolete but still in the store, as
+    # stores from older versions are
+    jq '.bookmarks |= map(if .description != "Fresh Bookmark" then .created = "2020-01-01 00:00:00" else . end
+                          | if .description == "Old Obsolete" then .status = "obsolete" else . end)' \
+        "$TEST_BOOKMARKS_FILE" > "$TEST_DIR/backdated.json" && mv "$TEST_DIR/backdated.json" "$TEST_BOOKMARKS_FILE"
+
+    local i
+    for i in 1 2 3; do
+        ../bookmarks.sh 'Fresh Bookmark' > /dev/null 2>&1
+    done
+    head -c 70000 /dev/zero > "$TEST_DIR/hooks.log"
+
+    local output
+    output=$(../bookmarks.sh maintain 2>&1)
+
+    # Test 1: Retention policies
+    run_test "Unused bookmark is retired to the archive" \
+        "[ \"\$(status_in '$archive' 'Old Bookmark')\" = 'obsolete' ] && [ -z \"\$(status_in '$TEST_BOOKMARKS_FILE' 'Old Bookmark')\" ]"
+    run_test "Obsolete bookmark in the store is archived" \
+        "[ \"\$(status_in '$archive' 'Old Obsolete')\" = 'obsolete' ]"
+    run_test "Recently used bookmark is kept" \
+        "[ \"\$(status_in '$TEST_BOOKMARKS_FILE' 'Fresh Bookmark')\" = 'active' ]"
+    run_test "Retention can be disabled" \
+        "../bookmarks.sh add 'Kept Forever' cmd 'echo kept' > /dev/null && \
+         jq '.bookmarks |= map(if .description == \"Kept Forever\" then .created = \"2020-01-01 00:00:00\" else . end)' '$TEST_BOOKMARKS_FILE' > '$TEST_DIR/b.json' && \
+         mv '$TEST_DIR/b.json' '$TEST_BOOKMARKS_FILE' && \
+         MAINTAIN_OBSOLETE_AFTER_DAYS=0 ../bookmarks.sh maintain > /dev/null && \
+         [ \"\$(status_in '$TEST_BOOKMARKS_FILE' 'Kept Forever')\" = 'active' ]"
+
+    run_test "Bookmark without any date is kept" \
+        "jq '.bookmarks += [{id: \"undated_1\", description: \"Undated\", type: \"cmd\", command: \"echo undated\", status: \"active\"}]' '$TEST_BOOKMARKS_FILE' > '$TEST_DIR/b.json' && \
+         mv '$TEST_DIR/b.json' '$TEST_BOOKMARKS_FILE' && \
+         ../bookmarks.sh maintain > /dev/null && \
+         [ \"\$(status_in '$TEST_BOOKMARKS_FILE' 'Undated')\" = 'active' ]"
+
+    # Test 2: Journal compaction merges runs of access entries
+    run_test "Access entries are merged" \
+        "[ \$(jq -c 'select(.op == \"access\")' '$journal' | wc -l) -eq 1 ] && \
+         jq -e -s 'map(select(.op == \"access\"))[0] | .first_generation < .generation and .before[0].access_count == 0 and .after[0].access_count == 3' '$journal' > /dev/null"
+    # At most the rescore written by the last run's cache phase is left
+    run_test "Record-less entries are dropped" \
+        "[ \$(jq -c 'select(.op == \"rescore\")' '$journal' | wc -l) -le 1 ]"
+
+    # Test 3: Logs past the size limit are rotated
+    run_test "Large logs are rotated" \
+        "[ -f '$TEST_DIR/hooks.log.1' ] && [ ! -f '$TEST_DIR/hooks.log' ]"
+
+    # Test 4: The report names every phase with a timing
+    run_test "Report lists each phase with its duration" \
+        "for phase in retention journal caches logs backups; do echo \"\$output\" | grep -qE \"\$phase .* [0-9]+ ms\" || exit 1; done"
+
+    # Test 5: A run is skipped while another holds the maintenance lock
+    if command -v flock > /dev/null 2>&1; then
+        run_test "Concurrent maintenance is skipped" \
+            "flock '$TEST_DIR/.maintain.lock' ../bookmarks.sh maintain | grep -q 'already running'"
+    fi
+
+    # Test 6: Background maintenance runs at most once per interval
+    local stamp="$TEST_DIR/.background_maintenance"
+    local log="$TEST_DIR/frecency_errors.log"
+    rm -f "$log"
+    ../bookmarks.sh 'Fresh Bookmark' > /dev/null 2>&1
+    sleep 0.5
+    run_test "Execution within the interval starts no background run" \
+        "[ ! -f '$log' ] && ! grep -qP '\trescore\t' <(tail -n 1 '$TEST_DIR/changes.log')"
+
+    touch -d '-2 hours' "$stamp"
+    ../bookmarks.sh list > /dev/null
+    ../bookmarks.sh list > /dev/null
+    for i in $(seq 1 50); do
+        grep -q '^journal:' "$log" 2>/dev/null && break
+        sleep 0.1
+    done
+    run_test "Next invocation after the interval starts one background run" \
+        "[ \$(grep -c 'background maintenance started' '$log') -eq 1 ] && grep -q '^journal: journal' '$log'"
+
+    # Test 7: A background rescore reads the store only once it holds the lock
+    if command -v flock > /dev/null 2>&1; then
+        rm -f "$log"
+        touch -d '-2 hours' "$stamp"
+        (
+            exec 9>> "$TEST_DIR/.store.lock"
+            flock 9
+            FRECENCY_MAX_RANK=1 ../bookmarks.sh list > /dev/null 9>&-
+            sleep 1
+            jq '(.bookmarks[] | select(.description == "Fresh Bookmark")).marker = "kept"' \
+                "$TEST_BOOKMARKS_FILE" > "$TEST_DIR/locked.json" && mv "$TEST_DIR/locked.json" "$TEST_BOOKMARKS_FILE"
+        )
+        for i in $(seq 1 50); do
+            grep -q '^journal:' "$log" 2>/dev/null && break
+            sleep 0.1
+        done
+        run_test "Background rescore keeps a write made while it waited" \
+            "grep -qP '\tage\t' <(tail -n 1 '$TEST_DIR/changes.log') && \
+             [ \"\$(jq -r '.bookmarks[] | select(.description == \"Fresh Bookmark\") | .marker' '$TEST_BOOKMARKS_FILE')\" = 'kept' ]"
+    fi
+
+    # Summary
+    echo ""
+    echo -e "${BLUE}Test summary:${NC}"
+    echo -e "  ${GREEN}Tests passed: $TESTS_PASSED${NC}"
+    echo -e "  ${RED}Tests failed: $TESTS_FAILED${NC}"
+    echo -e "  Total tests: $TOTAL_TESTS"
+
+    if [ "$TESTS_FAILED" -eq 0 ]; then
+        echo -e "${GREEN}All maintenance tests passed! 🎉${NC}"
+        return 0
+    else
+        echo -e "${RED}Some tests failed.${NC}"
+        return 1
+    fi
+}
+
+# Main execution
+setup_test_env
+run_test_suite
+TEST_RESULT=$?
+cleanup_test_env
+
+exit $TEST_RESULT
@@ -0,0 +1,116 @@
+#!/bin/bash
+
+# Test suite for cached output of bookmarks with a cache_ttl
+# Covers `set`, replay within the TTL, --fresh, invalidation and LRU eviction
+
+# Source the shared test framework
+SCRIPT_DIR="$(cd "$(dirname "${BASH_SOURCE[0]}")" && pwd)"
+source "$SCRIPT_DIR/test_framework.sh"
+
+# Number of times a counting bookmark actually ran
+# Args: $1 - counter name
+run_count() {
+    cat "$TEST_DIR/$1.count" 2>/dev/null | wc -l
+}
+
+# Run the test suite
+run_test_suite() {
+    echo -e "${BLUE}Starting output cache test suite${NC}"
+
+    ../bookmarks.sh add 'Cluster Status' cmd "echo run >> '$TEST_DIR/status.count'; echo all nodes ready" > /dev/null
+    ../bookmarks.sh add 'Flaky Query' cmd "echo run >> '$TEST_DIR/flaky.count'; echo partial; exit 1" > /dev/null
+
+    # Test 1: set validates its input
+    run_test "set rejects a non-numeric TTL" \
+        "../bookmarks.sh set 'Cluster Status' cache_ttl soon" 1
+    run_test "set rejects unknown settings" \
+        "../bookmarks.sh set 'Cluster Status' colour blue" 1
+    run_test "set stores cache_ttl" \
+        "../bookmarks.sh set 'Cluster Status' cache_ttl 300 > /dev/null && \
+         jq -e '.bookmarks[] | select(.description == \"Cluster Status\") | .cache_ttl == 300' \"$TEST_BOOKMARKS_FILE\" > /dev/null"
+
+    # Test 2: Output is replayed within the TTL
+    ../bookmarks.sh 'Cluster Status' > /dev/null 2>&1
+    run_test "Second run within the TTL replays the output" \
+        "out=\$(../bookmarks.sh 'Cluster Status' 2>/dev/null) && echo \"\$out\" | grep -q 'all nodes ready' && [ \$(run_count status) -eq 1 ]"
+    run_test "Replays still count as accesses" \
+        "jq -e '.bookmarks[] | select(.description == \"Cluster Status\") | .access_count == 2' \"$TEST_BOOKMARKS_FILE\" > /dev/null"
+
+    # Test 3: --fresh bypasses the cache
+    ../bookmarks.sh --fresh 'Cluster Status' > /dev/null 2>&1
+    run_test "--fresh runs the command again" \
+        "[ \$(run_count status) -eq 2 ]"
+
+    # Test 4: Expired output is not replayed
+    touch -d '-10 minutes' "$TEST_DIR"/output_cache/*.out
+    ../bookmarks.sh 'Cluster Status' > /dev/null 2>&1
+    run_test "Output older than the TTL is refreshed" \
+        "[ \$(run_count status) -eq 3 ]"
+
+    # Test 5: Failed runs are never cached
+    ../bookmarks.sh set 'Flaky Query' cache_ttl 300 > /dev/null
+    ../bookmarks.sh 'Flaky Query' > /dev/null 2>&1
+    ../bookmarks.sh 'Flaky Query' > /dev/null 2>&1
+    run_test "Failed runs are not replayed" \
+        "[ \$(run_count flaky) -eq 2 ]"
+
+    # Test 6: Changing the command invalidates the cached output
+    ../bookmarks.sh update 'Cluster Status' cmd "echo run >> '$TEST_DIR/status.count'; echo degraded" > /dev/null
+    run_test "Edited command is not served from the old output" \
+        "../bookmarks.sh 'Cluster Status' 2>/dev/null | grep -q degraded && [ \$(run_count status) -eq 4 ]"
+
+    # Test 7: Clearing the TTL turns caching off
+    ../bookmarks.sh set 'Cluster Status' cache_ttl off > /dev/null
+    ../bookmarks.sh 'Cluster Status' > /dev/null 2>&1
+    run_test "cache_ttl off runs every time" \
+        "[ \$(run_count status) -eq 5 ] && \
+         jq -e '.bookmarks[] | select(.description == \"Cluster Status\") | has(\"cache_ttl\") | not' \"$TEST_BOOKMARKS_FILE\" > /dev/null"
+
+    # Test 8: The least recently used output is evicted first
+    rm -rf "$TEST_DIR/output_cache"
+    local name
+    for name in One Two Three; do
+        ../bookmarks.sh add "Report $name" cmd "printf '%0100d' 0" > /dev/null
+        ../bookmarks.sh set "Report $name" cache_ttl 300 > /dev/null
+    done
+    OUTPUT_CACHE_MAX_BYTES=250 ../bookmarks.sh 'Report One' > /dev/null 2>&1
+    sleep 1
+    OUTPUT_CACHE_MAX_BYTES=250 ../bookmarks.sh 'Report Two' > /dev/null 2>&1
+    sleep 1
+    OUTPUT_CACHE_MAX_BYTES=250 ../bookmarks.sh 'Report One' > /dev/null 2>&1
+    sleep 1
+    OUTPUT_CACHE_MAX_BYTES=250 ../bookmarks.sh 'Report Three' > /dev/null 2>&1
+    local two_id
+    two_id=$(jq -r '.bookmarks[] | select(.description == "Report Two") | .id' "$TEST_BOOKMARKS_FILE")
+    run_test "Cache is kept under its size limit by LRU eviction" \
+        "[ \$(ls '$TEST_DIR/output_cache' | grep -c '\\.out$') -eq 2 ] && ! ls '$TEST_DIR/output_cache' | grep -q '^$two_id-'"
+
+    # Test 9: maintain drops outputs of deleted bookmarks
+    ../bookmarks.sh -y delete 'Report One' > /dev/null 2>&1
+    ../bookmarks.sh maintain > /dev/null 2>&1
+    run_test "Outputs of deleted bookmarks are pruned" \
+        "[ \$(ls '$TEST_DIR/output_cache' | grep -c '\\.out$') -eq 1 ]"
+
+    # Summary
+    echo ""
+    echo -e "${BLUE}Test summary:${NC}"
+    echo -e "  ${GREEN}Tests passed: $TESTS_PASSED${NC}"
+    echo -e "  ${RED}Tests failed: $TESTS_FAILED${NC}"
+    echo -e "  Total tests: $TOTAL_TESTS"
+
+    if [ "$TESTS_FAILED" -eq 0 ]; then
+        echo -e "${GREEN}All output cache tests passed! 🎉${NC}"
+        return 0
+    else
+        echo -e "${RED}Some tests failed.${NC}"
+        return 1
+    fi
+}
+
+# Main execution
+setup_test_env
+run_test_suite
+TEST_RESULT=$?
+cleanup_test_env
+
+exit $TEST_RESULT
@@ -0,0 +1,111 @@
+#!/bin/bash
+
+# Test suite for running several bookmarks in parallel
+# Covers `run`, the job limit, prefixed output, the summary and multi-select
+
+# Source the shared test framework
+SCRIPT_DIR="$(cd "$(dirname "${BASH_SOURCE[0]}")" && pwd)"
+source "$SCRIPT_DIR/test_framework.sh"
+
+# Install an fzf stand-in: --filter greps, interactive runs pick every line matching $FZF_PICK
+install_fzf_double() {
+    mkdir -p "$TEST_DIR/bin"
+    cat > "$TEST_DIR/bin/fzf" << 'FZF'
+#!/bin/bash
+filter=""
+for arg in "$@"; do
+    case "$arg" in
+        --filter=*) filter="${arg#--filter=}" ;;
+    esac
+done
+if [ -n "$filter" ]; then
+    grep -iF -- "$filter" || exit 1
+    exit 0
+fi
+grep -F -- "$FZF_PICK"
+FZF
+    chmod +x "$TEST_DIR/bin/fzf"
+}
+
+# Run the test suite
+run_test_suite() {
+    echo -e "${BLUE}Starting parallel execution test suite${NC}"
+
+    install_fzf_double
+    mkdir -p "$TEST_DIR/running"
+    # Each check records how many checks were running when it started
+    local probe="touch '$TEST_DIR/running/'\$BASHPID; ls '$TEST_DIR/running' | wc -l >> '$TEST_DIR/concurrency'; sleep 0.5; rm -f '$TEST_DIR/running/'\$BASHPID"
+    local name
+    for name in East West North South; do
+        ../bookmarks.sh add "Check $name" cmd "$probe; echo $name ok" > /dev/null
+    done
+    ../bookmarks.sh add 'Check Broken' cmd "echo broken; exit 4" > /dev/null
+
+    # Test 1: Arguments are validated before anything runs
+    run_test "Unknown bookmarks abort the run" \
+        "../bookmarks.sh run 'Check East' 'No Such Check'" 1
+    run_test "Nothing ran after a failed lookup" \
+        "[ ! -f '$TEST_DIR/concurrency' ]"
+    run_test "Job limit must be a positive number" \
+        "../bookmarks.sh run -j 0 'Check East'" 1
+
+    # Test 2: Output is prefixed with the bookmark it came from
+    local generation_before
+    generation_before=$(jq '.generation' "$TEST_BOOKMARKS_FILE")
+    ../bookmarks.sh run -j 2 'Check East' 'Check West' 'Check North' 'Check South' > "$TEST_DIR/out.txt" 2>&1
+    run_test "Output lines are prefixed per bookmark" \
+        "grep -q 'Check East.*| East ok' '$TEST_DIR/out.txt' && grep -q 'Check South.*| South ok' '$TEST_DIR/out.txt'"
+
+    # Test 3: The job limit is respected and jobs overlap
+    run_test "No more than the job limit run at once" \
+        "[ \$(sort -n '$TEST_DIR/concurrency' | tail -n 1) -le 2 ]"
+    run_test "Bookmarks run concurrently" \
+        "[ \$(sort -n '$TEST_DIR/concurrency' | tail -n 1) -eq 2 ]"
+
+    # Test 4: Access statistics and runs are recorded in one commit
+    run_test "All accesses are recorded in a single commit" \
+        "[ \$(jq '.generation' \"$TEST_BOOKMARKS_FILE\") -eq $((generation_before + 1)) ]"
+    run_test "Every bookmark has its access and run recorded" \
+        "jq -e '[.bookmarks[] | select(.description | test(\"East|West|North|South\"))]
+                | length == 4 and all(.access_count == 1 and .runs.count == 1 and .runs.last_ms >= 500)' \"$TEST_BOOKMARKS_FILE\" > /dev/null"
+
+    # Test 5: Failures show up in the summary and the exit status
+    run_test "A failing bookmark fails the run" \
+        "../bookmarks.sh run 'Check East' 'Check Broken' > '$TEST_DIR/out.txt' 2>&1" 1
+    run_test "Summary lists each exit status" \
+        "grep -q 'exit 4.*Check Broken' '$TEST_DIR/out.txt' && grep -q 'ok .*Check East' '$TEST_DIR/out.txt' && \
+         grep -q '1 of 2 bookmarks failed' '$TEST_DIR/out.txt'"
+
+    # Test 6: Picking several bookmarks in fzf runs them in parallel
+    rm -f "$TEST_DIR/concurrency"
+    PATH="$TEST_DIR/bin:$PATH" FZF_PICK="Check North" ../bookmarks.sh > "$TEST_DIR/out.txt" 2>&1
+    run_test "A single pick still runs directly" \
+        "grep -q '^North ok' '$TEST_DIR/out.txt' && \
+         jq -e '.bookmarks[] | select(.description == \"Check North\") | .access_count == 2' \"$TEST_BOOKMARKS_FILE\" > /dev/null"
+    PATH="$TEST_DIR/bin:$PATH" FZF_PICK="Check " ../bookmarks.sh > "$TEST_DIR/out.txt" 2>&1
+    run_test "Multi-select runs every picked bookmark" \
+        "grep -q 'Running 5 bookmarks' '$TEST_DIR/out.txt' && grep -q 'exit 4.*Check Broken' '$TEST_DIR/out.txt'"
+
+    # Summary
+    echo ""
+    echo -e "${BLUE}Test summary:${NC}"
+    echo -e "  ${GREEN}Tests passed: $TESTS_PASSED${NC}"
+    echo -e "  ${RED}Tests failed: $TESTS_FAILED${NC}"
+    echo -e "  Total tests: $TOTAL_TESTS"
+
+    if [ "$TESTS_FAILED" -eq 0 ]; then
+        echo -e "${GREEN}All parallel execution tests passed! 🎉${NC}"
+        return 0
+    else
+        echo -e "${RED}Some tests failed.${NC}"
+        return 1
+    fi
+}
+
+# Main execution
+setup_test_env
+run_test_suite
+TEST_RESULT=$?
+cleanup_test_env
+
+exit $TEST_RESULT
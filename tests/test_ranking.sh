@@ -0,0 +1,116 @@
+#!/bin/bash
+
+# Test suite for the selection log and ranking weight tuning
+# Uses a scripted fzf stand-in that picks a fixed line and prints the query
+
+# Source the shared test framework
+SCRIPT_DIR="$(cd "$(dirname "${BASH_SOURCE[0]}")" && pwd)"
+source "$SCRIPT_DIR/test_framework.sh"
+
+# Install an fzf stand-in: --filter greps (its options are appended to
+# $FZF_FILTER_LOG), interactive runs pick $FZF_PICK
+install_fzf_double() {
+    mkdir -p "$TEST_DIR/bin"
+    cat > "$TEST_DIR/bin/fzf" << 'FZF'
+#!/bin/bash
+filter="" print_query=false
+for arg in "$@"; do
+    case "$arg" in
+        --filter=*) filter="${arg#--filter=}" ;;
+        --print-query) print_query=true ;;
+    esac
+done
+if [ -n "$filter" ]; then
+    [ -z "${FZF_FILTER_LOG:-}" ] || echo "$*" >> "$FZF_FILTER_LOG"
+    grep -iF -- "$filter" || exit 1
+    exit 0
+fi
+$print_query && echo "${FZF_QUERY:-}"
+grep -F -- "$FZF_PICK" | head -n 1
+FZF
+    chmod +x "$TEST_DIR/bin/fzf"
+}
+
+# Run the test suite
+run_test_suite() {
+    echo -e "${BLUE}Starting ranking test suite${NC}"
+
+    install_fzf_double
+    local log="$TEST_DIR/selections.jsonl"
+    local i
+    for i in 1 2 3 4; do
+        ../bookmarks.sh add "Deploy $i" cmd "echo $i" > /dev/null
+    done
+
+    # Test 1: Selections are only logged when enabled
+    PATH="$TEST_DIR/bin:$PATH" FZF_PICK="Deploy 3" ../bookmarks.sh > /dev/null 2>&1
+    run_test "Selections are not logged by default" \
+        "[ ! -f '$log' ]"
+
+    # Test 2: The log records query, position, candidate count and features
+    PATH="$TEST_DIR/bin:$PATH" BOOKMARKS_LOG_SELECTIONS=true FZF_PICK="Deploy 2" FZF_QUERY="deploy" \
+        ../bookmarks.sh > /dev/null 2>&1
+    run_test "Selection is logged with its position among matches" \
+        "jq -e -s '.[-1] | .q == \"deploy\" and .n == 4 and .pos >= 2 and (.c | length) == 4 and (.o | length) == 3' '$log' > /dev/null"
+
+    # Test 3: Positions come from the same score-sorted order the picker showed
+    PATH="$TEST_DIR/bin:$PATH" BOOKMARKS_LOG_SELECTIONS=true FZF_PICK="Deploy 2" FZF_QUERY="deploy" \
+        FZF_FILTER_LOG="$TEST_DIR/filter_args" ../bookmarks.sh > /dev/null 2>&1
+    run_test "Matches are listed with the picker's sort options" \
+        "grep -q -- '--tiebreak=index' '$TEST_DIR/filter_args' && ! grep -q -- '--no-sort' '$TEST_DIR/filter_args'"
+
+    # Test 4: tune needs a history
+    rm -f "$log"
+    run_test "tune without a log fails" \
+        "../bookmarks.sh tune > /dev/null 2>&1" 1
+
+    # Test 5: tune fits weights that put the chosen items first
+    # Chosen items are used less often but in the current context
+    for i in $(seq 1 12); do
+        echo '{"t":1,"q":"","n":3,"pos":2,"hidden":0,"c":[0,0.5,0.3,0],"o":[[2,0.5,0,0],[0.5,0.4,0,0]]}'
+    done > "$log"
+    local output
+    output=$(../bookmarks.sh tune --dry-run)
+    run_test "Dry run reports before and after metrics" \
+        "echo \"\$output\" | grep -qE 'mean position +2 +-> 1' && echo \"\$output\" | grep -q 'top-1 rate'"
+    run_test "Dry run does not save weights" \
+        "[ ! -f '$TEST_DIR/ranking_weights' ]"
+    run_test "tune saves the fitted weights" \
+        "../bookmarks.sh tune > /dev/null && grep -qE '^(frequency|context)=' '$TEST_DIR/ranking_weights'"
+
+    # Test 6: Saved weights change the listing order
+    # Deploy 1 was used recently, Deploy 4 more often but longer ago
+    jq '.bookmarks |= map(if .description == "Deploy 1" then .access_count = 1 | .frecency_score = 20000
+                          elif .description == "Deploy 4" then .access_count = 8 | .frecency_score = 16000
+                          else .frecency_score = 0 end)' \
+        "$TEST_BOOKMARKS_FILE" > "$TEST_DIR/b.json" && mv "$TEST_DIR/b.json" "$TEST_BOOKMARKS_FILE"
+    rm -f "$TEST_DIR/ranking_weights"
+    run_test "Default weights order by frecency" \
+        "(cd '$TEST_DIR' && '$SCRIPT_DIR/../bookmarks.sh' list | head -n 1 | grep -q 'Deploy 1')"
+    printf 'frequency=1\nrecency=0\ncontext=9\n' > "$TEST_DIR/ranking_weights"
+    run_test "Weights are read from ranking_weights" \
+        "(cd '$TEST_DIR' && '$SCRIPT_DIR/../bookmarks.sh' list | head -n 1 | grep -q 'Deploy 4')"
+
+    # Summary
+    echo ""
+    echo -e "${BLUE}Test summary:${NC}"
+    echo -e "  ${GREEN}Tests passed: $TESTS_PASSED${NC}"
+    echo -e "  ${RED}Tests failed: $TESTS_FAILED${NC}"
+    echo -e "  Total tests: $TOTAL_TESTS"
+
+    if [ "$TESTS_FAILED" -eq 0 ]; then
+        echo -e "${GREEN}All ranking tests passed! 🎉${NC}"
+        return 0
+    else
+        echo -e "${RED}Some tests failed.${NC}"
+        return 1
+    fi
+}
+
+# Main execution
+setup_test_env
+run_test_suite
+TEST_RESULT=$?
+cleanup_test_env
+
+exit $TEST_RESULT
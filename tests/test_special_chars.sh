@@ -16,12 +16,14 @@ test_bookmark_exists() {
 }
 
 # Test that a bookmark with a specific property value exists
+# Args: $1 - description, $2 - property, $3 - expected value, $4 - store file (default bookmarks.json)
 test_bookmark_property() {
     local description="$1"
     local property="$2"
     local expected_value="$3"
+    local store_file="${4:-$TEST_BOOKMARKS_FILE}"
     local actual_value
-    actual_value=$(jq -r --arg desc "$description" --arg prop "$property" '.bookmarks[] | select(.description == $desc) | .[$prop]' "$TEST_BOOKMARKS_FILE")
+    actual_value=$(jq -r --arg desc "$description" --arg prop "$property" '.bookmarks[] | select(.description == $desc) | .[$prop]' "$store_file")
     [ "$actual_value" = "$expected_value" ]
 }
 
@@ -76,7 +78,7 @@ run_test_suite() {
     run_test "Mark obsolete bookmark with emoji" \
         "../bookmarks.sh -y obsolete 'Test with emoji 😀 🎉'"
     
-    if test_bookmark_property "Test with emoji 😀 🎉" "status" "obsolete"; then
+    if test_bookmark_property "Test with emoji 😀 🎉" "status" "obsolete" "$TEST_DIR/archive.json"; then
         echo -e "${GREEN}✓ Bookmark with emoji was marked obsolete${NC}"
         TESTS_PASSED=$((TESTS_PASSED + 1))
     else
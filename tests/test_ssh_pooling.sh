@@ -0,0 +1,132 @@
+#!/bin/bash
+
+# Test suite for ssh connection pooling
+# Covers ControlMaster injection, pre-warming the most frecent targets and
+# `masters` list/stop, using an ssh stand-in that emulates master sockets
+
+# Source the shared test framework
+SCRIPT_DIR="$(cd "$(dirname "${BASH_SOURCE[0]}")" && pwd)"
+source "$SCRIPT_DIR/test_framework.sh"
+
+# Install an ssh stand-in that logs its arguments. -f -N creates the control
+# socket (a plain file here), -O check/exit test and remove it (masters of
+# "stale" hosts are dead), and anything else runs the remote command locally
+install_ssh_double() {
+    mkdir -p "$TEST_DIR/bin"
+    cat > "$TEST_DIR/bin/ssh" << SSH
+#!/bin/bash
+echo "\$*" >> "$TEST_DIR/ssh.log"
+control="" op="" master=false user=me port=22
+args=()
+while [ \$# -gt 0 ]; do
+    case "\$1" in
+        -o) case "\$2" in ControlPath=*) control="\${2#ControlPath=}" ;; esac; shift 2 ;;
+        -O) op="\$2"; shift 2 ;;
+        -p) port="\$2"; shift 2 ;;
+        -f|-N) master=true; shift ;;
+        *) args+=("\$1"); shift ;;
+    esac
+done
+dest="\${args[0]}"
+case "\$dest" in *@*) user="\${dest%@*}"; dest="\${dest#*@}" ;; esac
+control="\${control//%r/\$user}"; control="\${control//%h/\$dest}"; control="\${control//%p/\$port}"
+case "\$op" in
+    check) [ -e "\$control" ] && [[ "\$control" != *stale* ]] && echo "Master running (pid=4242)" >&2 && exit 0; exit 255 ;;
+    exit) [ -e "\$control" ] && rm -f "\$control" && exit 0; exit 255 ;;
+esac
+if [ "\$master" = true ]; then
+    touch "\$control"
+    exit 0
+fi
+echo "\$(eval "\${args[@]:1}")"
+SSH
+    chmod +x "$TEST_DIR/bin/ssh"
+}
+
+# Run the test suite
+run_test_suite() {
+    echo -e "${BLUE}Starting ssh pooling test suite${NC}"
+
+    install_ssh_double
+    export PATH="$TEST_DIR/bin:$PATH"
+
+    ../bookmarks.sh add 'Web Shell' ssh 'ssh deploy@web-1 echo on web' > /dev/null
+    ../bookmarks.sh add 'DB Shell' ssh 'ssh -p 2222 db-1' > /dev/null
+    ../bookmarks.sh add 'Quoted Shell' ssh "ssh cache-1 'uptime; df'" > /dev/null
+    ../bookmarks.sh add 'Own Socket' ssh 'ssh -o ControlPath=/tmp/mine web-2 true' > /dev/null
+
+    # Test 1: ssh bookmarks are run through a master connection
+    run_test "Command output still comes through" \
+        "../bookmarks.sh 'Web Shell' 2>&1 | grep -q '^on web'"
+    run_test "Master options are injected" \
+        "tail -n 1 '$TEST_DIR/ssh.log' | grep -q -- '-o ControlMaster=auto -o ControlPath=$TEST_DIR/ssh/%r@%h:%p -o ControlPersist=600 deploy@web-1'"
+    run_test "Socket directory is private" \
+        "[ \"\$(stat -c %a '$TEST_DIR/ssh' 2>/dev/null || stat -f %Lp '$TEST_DIR/ssh')\" = 700 ]"
+    run_test "Commands with their own ControlPath are left alone" \
+        "../bookmarks.sh 'Own Socket' > /dev/null 2>&1 && ! tail -n 1 '$TEST_DIR/ssh.log' | grep -q ControlMaster"
+    run_test "SSH_CONTROL_PERSIST=0 turns pooling off" \
+        "SSH_CONTROL_PERSIST=0 ../bookmarks.sh 'Web Shell' > /dev/null 2>&1 && ! tail -n 1 '$TEST_DIR/ssh.log' | grep -q ControlMaster"
+
+    # Test 2: Pre-warming connects the most frecent targets when the picker opens
+    # DB Shell is the most frecent, then Quoted Shell, then Web Shell
+    local i
+    for i in 1 2 3 4; do
+        ../bookmarks.sh 'DB Shell' > /dev/null 2>&1
+    done
+    for i in 1 2 3; do
+        ../bookmarks.sh 'Quoted Shell' > /dev/null 2>&1
+    done
+    : > "$TEST_DIR/ssh.log"
+    ../bookmarks.sh masters warm 2 > "$TEST_DIR/out.txt" 2>&1
+    run_test "Only the top ssh bookmarks get a master" \
+        "[ -e '$TEST_DIR/ssh/me@db-1:2222' ] && [ ! -e '$TEST_DIR/ssh/deploy@web-1:22' ]"
+    run_test "Masters are opened without prompting and without the remote command" \
+        "grep -q -- '-f -N .*BatchMode=yes .*-p 2222 db-1$' '$TEST_DIR/ssh.log'"
+    run_test "Commands with quotes are not pre-warmed" \
+        "! grep -q 'cache-1' '$TEST_DIR/ssh.log'"
+    : > "$TEST_DIR/ssh.log"
+    ../bookmarks.sh masters warm 2 > /dev/null 2>&1
+    run_test "Live masters are not opened again" \
+        "! grep -q -- '-f -N' '$TEST_DIR/ssh.log'"
+    rm -f "$TEST_DIR"/ssh/*
+    SSH_PREWARM=1 FZF_STUB_SELECT=nothing-matches ../bookmarks.sh > /dev/null 2>&1
+    sleep 0.5
+    run_test "Opening the picker pre-warms with SSH_PREWARM" \
+        "[ -e '$TEST_DIR/ssh/me@db-1:2222' ]"
+
+    # Test 3: Listing and cleanup
+    ../bookmarks.sh masters warm 2 > /dev/null 2>&1
+    touch "$TEST_DIR/ssh/gone@stale:22"
+    run_test "masters lists live connections" \
+        "../bookmarks.sh masters | grep -q 'me@db-1:2222 .*pid=4242'"
+    run_test "Stale sockets are removed while listing" \
+        "[ ! -e '$TEST_DIR/ssh/gone@stale:22' ]"
+    run_test "masters stop closes a single target" \
+        "../bookmarks.sh masters stop me@db-1:2222 | grep -q 'Closed 1' && [ ! -e '$TEST_DIR/ssh/me@db-1:2222' ]"
+    ../bookmarks.sh masters warm 2 > /dev/null 2>&1
+    run_test "masters stop closes every connection" \
+        "../bookmarks.sh masters stop > /dev/null && [ -z \"\$(ls '$TEST_DIR/ssh')\" ]"
+
+    # Summary
+    echo ""
+    echo -e "${BLUE}Test summary:${NC}"
+    echo -e "  ${GREEN}Tests passed: $TESTS_PASSED${NC}"
+    echo -e "  ${RED}Tests failed: $TESTS_FAILED${NC}"
+    echo -e "  Total tests: $TOTAL_TESTS"
+
+    if [ "$TESTS_FAILED" -eq 0 ]; then
+        echo -e "${GREEN}All ssh pooling tests passed! 🎉${NC}"
+        return 0
+    else
+        echo -e "${RED}Some tests failed.${NC}"
+        return 1
+    fi
+}
+
+# Main execution
+setup_test_env
+run_test_suite
+TEST_RESULT=$?
+cleanup_test_env
+
+exit $TEST_RESULT
@@ -0,0 +1,150 @@
+#!/bin/bash
+
+# Test suite for bookmark store sync
+# Covers merging by ID, three-way field merges, summed access counts,
+# delete propagation, the no-op fast path and delta syncs of large stores
+
+# Source the shared test framework
+SCRIPT_DIR="$(cd "$(dirname "${BASH_SOURCE[0]}")" && pwd)"
+source "$SCRIPT_DIR/test_framework.sh"
+
+# Run a bookmarks command against the peer store
+# Args: bookmarks.sh arguments
+peer() {
+    BOOKMARKS_DIR="$PEER_DIR" ../bookmarks.sh "$@"
+}
+
+# Print a field of a bookmark in a store
+# Args: $1 - bookmarks file, $2 - description, $3 - field
+field_of() {
+    jq -r --arg desc "$2" --arg field "$3" '.bookmarks[] | select(.description == $desc) | .[$field]' "$1"
+}
+
+# Run the test suite
+run_test_suite() {
+    echo -e "${BLUE}Starting store sync test suite${NC}"
+
+    PEER_DIR="$TEST_DIR/peer"
+    mkdir -p "$PEER_DIR"
+    local peer_file="$PEER_DIR/bookmarks.json"
+
+    ../bookmarks.sh add 'Local Only' cmd 'echo local' 'mine' > /dev/null
+    ../bookmarks.sh add 'Shared' cmd 'echo shared' 'team' > /dev/null
+    peer add 'Peer Only' cmd 'echo peer' > /dev/null
+
+    # Test 1: First sync merges both stores in both directions
+    run_test "Initial sync succeeds" \
+        "../bookmarks.sh sync '$PEER_DIR' > /dev/null"
+    run_test "Peer records are copied here" \
+        "[ \"\$(field_of '$TEST_BOOKMARKS_FILE' 'Peer Only' command)\" = 'echo peer' ]"
+    run_test "Local records are copied to the peer" \
+        "[ \"\$(field_of '$peer_file' 'Shared' command)\" = 'echo shared' ]"
+
+    # Test 2: Nothing changed, nothing to do
+    run_test "Unchanged stores are a no-op" \
+        "../bookmarks.sh sync '$PEER_DIR' | grep -q 'Already in sync'"
+
+    # Test 3: Access counts from both sides are summed
+    ../bookmarks.sh 'Shared' > /dev/null
+    peer 'Shared' > /dev/null
+    peer 'Shared' > /dev/null
+    ../bookmarks.sh sync "$PEER_DIR" > /dev/null
+    run_test "Access counts are summed" \
+        "[ \"\$(field_of '$TEST_BOOKMARKS_FILE' 'Shared' access_count)\" = '3' ] && \
+         [ \"\$(field_of '$peer_file' 'Shared' access_count)\" = '3' ]"
+
+    # Test 4: Different fields edited on each side are both kept
+    ../bookmarks.sh update 'Shared' cmd 'echo shared v2' 'team' > /dev/null
+    peer update 'Shared' cmd 'echo shared' 'team,ops' > /dev/null
+    ../bookmarks.sh sync "$PEER_DIR" > /dev/null
+    run_test "Non-conflicting field edits are merged" \
+        "[ \"\$(field_of '$TEST_BOOKMARKS_FILE' 'Shared' command)\" = 'echo shared v2' ] && \
+         [ \"\$(field_of '$TEST_BOOKMARKS_FILE' 'Shared' tags)\" = 'team,ops' ]"
+
+    # Test 5: Conflicting edits resolve to the most recent modification
+    ../bookmarks.sh update 'Shared' cmd 'echo older' 'team,ops' > /dev/null
+    sleep 1
+    peer update 'Shared' cmd 'echo newer' 'team,ops' > /dev/null
+    ../bookmarks.sh sync "$PEER_DIR" > /dev/null
+    run_test "Last writer wins on conflicting fields" \
+        "[ \"\$(field_of '$TEST_BOOKMARKS_FILE' 'Shared' command)\" = 'echo newer' ] && \
+         [ \"\$(field_of '$peer_file' 'Shared' command)\" = 'echo newer' ]"
+
+    # Test 6: Deletes propagate to the other side
+    peer -y delete 'Local Only' > /dev/null
+    ../bookmarks.sh sync "$PEER_DIR" > /dev/null
+    run_test "Deletions propagate" \
+        "[ -z \"\$(field_of '$TEST_BOOKMARKS_FILE' 'Local Only' id)\" ]"
+
+    # Test 7: Only changed records are merged once a sync baseline exists
+    peer add 'Delta' cmd 'echo delta' > /dev/null
+    run_test "Incremental sync reports only the delta" \
+        "../bookmarks.sh sync '$PEER_DIR' | grep -q '1 updated here, 0 updated there'"
+
+    # Test 8: Access counts aged by a rescore reach the peer
+    FRECENCY_MAX_RANK=2 ../bookmarks.sh maintain > /dev/null 2>&1
+    ../bookmarks.sh sync "$PEER_DIR" > /dev/null
+    run_test "Aged access counts are synced" \
+        "[ \"\$(field_of '$TEST_BOOKMARKS_FILE' 'Shared' access_count)\" != '3' ] && \
+         [ \"\$(field_of '$peer_file' 'Shared' access_count)\" = \"\$(field_of '$TEST_BOOKMARKS_FILE' 'Shared' access_count)\" ]"
+
+    # Test 9: An incremental sync of a large store only reads the delta
+    local large_dir="$TEST_DIR/large" large_peer="$TEST_DIR/large-peer"
+    mkdir -p "$large_dir" "$large_peer"
+    jq -n '{bookmarks: [range(100000) | {id: "large_\(.)", description: "Large \(.)", type: "cmd",
+        command: "echo \(.)", tags: "", notes: "", created: "2025-01-01 00:00:00", status: "active",
+        access_count: 0, last_accessed: null, frecency_score: 0}]}' > "$large_dir/bookmarks.json"
+    cp "$large_dir/bookmarks.json" "$large_peer/bookmarks.json"
+    BOOKMARKS_DIR="$large_dir" ../bookmarks.sh add 'Large Local' cmd 'echo local' > /dev/null
+    BOOKMARKS_DIR="$large_dir" ../bookmarks.sh sync "$large_peer" > /dev/null
+    BOOKMARKS_DIR="$large_peer" ../bookmarks.sh add 'Large Delta' cmd 'echo delta' > /dev/null
+    local started="$EPOCHREALTIME"
+    BOOKMARKS_DIR="$large_dir" ../bookmarks.sh sync "$large_peer" > "$TEST_DIR/large-sync.out"
+    local elapsed
+    elapsed=$(awk -v a="$started" -v b="$EPOCHREALTIME" 'BEGIN { printf "%.2f", b - a }')
+    echo "  Incremental sync of 100000 records took ${elapsed}s"
+    run_test "Incremental sync of a large store merges only the delta" \
+        "grep -q '1 updated here, 0 updated there' '$TEST_DIR/large-sync.out' && \
+         [ \"\$(jq '.bookmarks | length' '$large_dir/bookmarks.json')\" = '100002' ]"
+    run_test "Both stores are kept one record per line" \
+        "for store in '$large_dir/bookmarks.json' '$large_peer/bookmarks.json'; do \
+             head -n 1 \"\$store\" | grep -q '\"bookmarks\":\[\$' && [ \$(wc -l < \"\$store\") -eq 100004 ] || exit 1; done"
+    run_test "Incremental sync of a large store finishes within ${SYNC_TIME_LIMIT:-1}s" \
+        "awk -v t='$elapsed' -v limit='${SYNC_TIME_LIMIT:-1}' 'BEGIN { exit !(t < limit) }'"
+
+    # Test 10: A plain JSON file works as a peer
+    local export_file="$TEST_DIR/export.json"
+    echo '{"bookmarks":[]}' > "$export_file"
+    run_test "Sync with a bookmarks file" \
+        "../bookmarks.sh sync '$export_file' > /dev/null && \
+         [ \"\$(jq '.bookmarks | length' '$export_file')\" = \"\$(jq '.bookmarks | length' '$TEST_BOOKMARKS_FILE')\" ]"
+
+    # Test 11: Invalid peers are rejected
+    run_test "Syncing a store with itself fails" \
+        "../bookmarks.sh sync '$TEST_DIR' > /dev/null 2>&1" 1
+    run_test "Missing peer fails" \
+        "../bookmarks.sh sync '$TEST_DIR/nowhere' > /dev/null 2>&1" 1
+
+    # Summary
+    echo ""
+    echo -e "${BLUE}Test summary:${NC}"
+    echo -e "  ${GREEN}Tests passed: $TESTS_PASSED${NC}"
+    echo -e "  ${RED}Tests failed: $TESTS_FAILED${NC}"
+    echo -e "  Total tests: $TOTAL_TESTS"
+
+    if [ "$TESTS_FAILED" -eq 0 ]; then
+        echo -e "${GREEN}All sync tests passed! 🎉${NC}"
+        return 0
+    else
+        echo -e "${RED}Some tests failed.${NC}"
+        return 1
+    fi
+}
+
+# Main execution
+setup_test_env
+run_test_suite
+TEST_RESULT=$?
+cleanup_test_env
+
+exit $TEST_RESULT
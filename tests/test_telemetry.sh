@@ -0,0 +1,102 @@
+#!/bin/bash
+
+# Test suite for execution telemetry
+# Covers run timing, exit status, the quantile sketch, `stats` and the preview
+
+# Source the shared test framework
+SCRIPT_DIR="$(cd "$(dirname "${BASH_SOURCE[0]}")" && pwd)"
+source "$SCRIPT_DIR/test_framework.sh"
+
+# Run the test suite
+run_test_suite() {
+    echo -e "${BLUE}Starting execution telemetry test suite${NC}"
+
+    ../bookmarks.sh add 'Quick Check' cmd "true" > /dev/null
+    ../bookmarks.sh add 'Slow Build' cmd "sleep 0.2" > /dev/null
+    ../bookmarks.sh add 'Broken Job' cmd "exit 3" > /dev/null
+    ../bookmarks.sh add 'Strict Steps' cmd "false; touch '$TEST_DIR/after_false'" > /dev/null
+
+    # Test 1: Successful runs are timed
+    ../bookmarks.sh 'Slow Build' > /dev/null 2>&1
+    ../bookmarks.sh 'Slow Build' > /dev/null 2>&1
+    run_test "Runs are counted with their duration" \
+        "jq -e '.bookmarks[] | select(.description == \"Slow Build\") | .runs
+                | .count == 2 and .failures == 0 and .last_status == 0 and .last_ms >= 200' \"$TEST_BOOKMARKS_FILE\" > /dev/null"
+
+    # Test 2: The access and the run of one execution share a single commit
+    local generation_before journal_before
+    generation_before=$(jq '.generation' "$TEST_BOOKMARKS_FILE")
+    journal_before=$(wc -l < "$TEST_DIR/journal.jsonl")
+    ../bookmarks.sh 'Quick Check' > /dev/null 2>&1
+    run_test "A run is recorded in one commit" \
+        "[ \$(jq '.generation' \"$TEST_BOOKMARKS_FILE\") -eq $((generation_before + 1)) ] && \
+         [ \$(wc -l < '$TEST_DIR/journal.jsonl') -eq $((journal_before + 1)) ] && \
+         tail -n 1 '$TEST_DIR/journal.jsonl' | jq -e '.op == \"access\" and .after[0].access_count == 1 and .after[0].runs.count == 1' > /dev/null"
+
+    # Test 3: Failures are recorded and the exit status is kept
+    run_test "Exit status of the command is returned" \
+        "../bookmarks.sh 'Broken Job' > /dev/null 2>&1" 3
+    run_test "Failed run is recorded" \
+        "jq -e '.bookmarks[] | select(.description == \"Broken Job\") | .runs
+                | .count == 1 and .failures == 1 and .last_status == 3' \"$TEST_BOOKMARKS_FILE\" > /dev/null"
+    run_test "Commands still stop at the first failing step" \
+        "../bookmarks.sh 'Strict Steps' > /dev/null 2>&1; [ ! -f '$TEST_DIR/after_false' ]"
+
+    # Test 4: Quantiles come from the sketch
+    # 90 runs in the 100 ms bucket and 10 in the 2 s bucket
+    jq '.bookmarks |= map(if .description == "Quick Check"
+        then .runs = {count: 100, failures: 0, last_status: 0, last_ms: 100, last_run: "2024-01-01 00:00:00",
+                      sketch: {"49": 90, "80": 10}} else . end)' \
+        "$TEST_BOOKMARKS_FILE" > "$TEST_DIR/b.json" && mv "$TEST_DIR/b.json" "$TEST_BOOKMARKS_FILE"
+    run_test "p50 and p95 are read from the sketch" \
+        "../bookmarks.sh stats 'Quick Check' | grep -q 'p50 102 ms, p95 2 s'"
+
+    # Test 5: The sketch stays bounded
+    jq '.bookmarks |= map(if .description == "Quick Check"
+        then .runs.sketch = ([range(100; 164) | {key: tostring, value: 1}] | from_entries) else . end)' \
+        "$TEST_BOOKMARKS_FILE" > "$TEST_DIR/b.json" && mv "$TEST_DIR/b.json" "$TEST_BOOKMARKS_FILE"
+    ../bookmarks.sh 'Quick Check' > /dev/null 2>&1
+    run_test "Sketch never grows past 64 buckets" \
+        "jq -e '.bookmarks[] | select(.description == \"Quick Check\") | .runs
+                | (.sketch | length) == 64 and .sketch[\"100\"] == 2' \"$TEST_BOOKMARKS_FILE\" > /dev/null"
+
+    # Test 6: stats lists failing bookmarks first
+    run_test "stats lists failing bookmarks first" \
+        "../bookmarks.sh stats | sed -n 2p | grep -q 'Broken Job'"
+    run_test "stats shows the failure rate" \
+        "../bookmarks.sh stats | grep 'Broken Job' | grep -q '100%'"
+
+    # Test 7: Only timed types record runs
+    ../bookmarks.sh add 'Some Note' note "/dev/null" > /dev/null
+    ../bookmarks.sh 'Some Note' > /dev/null 2>&1
+    run_test "Other types do not record runs" \
+        "jq -e '.bookmarks[] | select(.description == \"Some Note\") | .runs == null' \"$TEST_BOOKMARKS_FILE\" > /dev/null"
+
+    # Test 8: The preview pane shows the run statistics
+    run_test "Preview shows runs and durations" \
+        "out=\$(../bookmarks.sh _preview_details 'Slow Build') && echo \"\$out\" | grep -q 'Runs: *2 (0% failed' && \
+         echo \"\$out\" | grep -q 'Duration: *p50'"
+
+    # Summary
+    echo ""
+    echo -e "${BLUE}Test summary:${NC}"
+    echo -e "  ${GREEN}Tests passed: $TESTS_PASSED${NC}"
+    echo -e "  ${RED}Tests failed: $TESTS_FAILED${NC}"
+    echo -e "  Total tests: $TOTAL_TESTS"
+
+    if [ "$TESTS_FAILED" -eq 0 ]; then
+        echo -e "${GREEN}All execution telemetry tests passed! 🎉${NC}"
+        return 0
+    else
+        echo -e "${RED}Some tests failed.${NC}"
+        return 1
+    fi
+}
+
+# Main execution
+setup_test_env
+run_test_suite
+TEST_RESULT=$?
+cleanup_test_env
+
+exit $TEST_RESULT
@@ -91,7 +91,43 @@ run_test_suite() {
         TESTS_FAILED=$((TESTS_FAILED + 1))
     fi
     TOTAL_TESTS=$((TOTAL_TESTS + 1))
-    
+
+    # Test pluggable type handlers from $BOOKMARKS_DIR/types
+    echo -e "${BLUE}Testing type handler registry...${NC}"
+    mkdir -p "$TEST_DIR/types"
+    cat > "$TEST_DIR/types/greet.sh" << EOF
+type_exec() { echo "greet:\$1" > "$TEST_DIR/greet.out"; }
+type_preview() { echo "Greeting preview for \$2"; }
+type_validate() { [[ "\$1" != *bad* ]]; }
+EOF
+    cat > "$TEST_DIR/types/shout" << EOF
+#!/bin/bash
+case "\$1" in
+    exec) echo "\${2^^}" > "$TEST_DIR/shout.out" ;;
+    *) exit 127 ;;
+esac
+EOF
+    chmod +x "$TEST_DIR/types/shout"
+
+    run_test "Handler type is accepted without confirmation" \
+        "../bookmarks.sh add 'Handler Greet' greet 'hello' < /dev/null"
+
+    run_test "Handler validate rejects commands" \
+        "../bookmarks.sh add 'Handler Bad' greet 'bad command' < /dev/null" 1
+
+    run_test "Sourced handler exec entry point runs" \
+        "../bookmarks.sh 'Handler Greet' > /dev/null && grep -q 'greet:hello' '$TEST_DIR/greet.out'"
+
+    run_test "Handler preview is shown in details" \
+        "../bookmarks.sh _preview_details 'Handler Greet' | grep -q 'Greeting preview for Handler Greet'"
+
+    run_test "Native executable handler runs" \
+        "../bookmarks.sh add 'Handler Shout' shout 'quiet' < /dev/null && \
+         ../bookmarks.sh 'Handler Shout' > /dev/null && grep -q 'QUIET' '$TEST_DIR/shout.out'"
+
+    run_test "Handlers are recorded in the capability cache" \
+        "grep -q '^type_greet=sh' '$TEST_DIR/.capabilities' && grep -q '^type_shout=exe' '$TEST_DIR/.capabilities'"
+
     # Summary
     echo -e "${BLUE}Test summary:${NC}"
     echo -e "  ${GREEN}Tests passed: $TESTS_PASSED${NC}"
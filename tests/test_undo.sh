@@ -0,0 +1,120 @@
+#!/bin/bash
+
+# Test suite for the mutation journal, undo and point-in-time restore
+# Covers journal entries, multi-level undo, restore --at, backup replay and
+# rewinding aged access counts
+
+# Source the shared test framework
+SCRIPT_DIR="$(cd "$(dirname "${BASH_SOURCE[0]}")" && pwd)"
+source "$SCRIPT_DIR/test_framework.sh"
+
+# Print a field of the bookmark with the given description
+# Args: $1 - description, $2 - field
+field_of() {
+    jq -r --arg d "$1" --arg f "$2" '.bookmarks[] | select(.description == $d) | .[$f]' "$TEST_BOOKMARKS_FILE"
+}
+
+# Run the test suite
+run_test_suite() {
+    echo -e "${BLUE}Starting undo and point-in-time restore test suite${NC}"
+
+    local journal="$TEST_DIR/journal.jsonl"
+
+    ../bookmarks.sh add 'Undo One' cmd 'echo one' > /dev/null
+    ../bookmarks.sh add 'Undo Two' cmd 'echo two' > /dev/null
+    ../bookmarks.sh update 'Undo One' cmd 'echo one changed' > /dev/null
+
+    # Test 1: Each commit writes one journal line with before/after records
+    run_test "Journal has one entry per generation" \
+        "[ \$(wc -l < '$journal') -eq 3 ] && jq -e -s 'map(.generation) == [1, 2, 3]' '$journal' > /dev/null"
+    run_test "Journal records before and after" \
+        "tail -n 1 '$journal' | jq -e '.op == \"update\" and .before[0].command == \"echo one\" and .after[0].command == \"echo one changed\"' > /dev/null"
+
+    # Test 2: undo reverts the last edit
+    run_test "Undo reverts the last edit" \
+        "../bookmarks.sh undo | grep -q 'update (generation 3): Undo One' && [ \"\$(field_of 'Undo One' command)\" = 'echo one' ]"
+
+    # Test 3: A second undo goes further back instead of redoing
+    run_test "Repeated undo goes further back" \
+        "../bookmarks.sh undo > /dev/null && [ -z \"\$(field_of 'Undo Two' id)\" ] && [ -n \"\$(field_of 'Undo One' id)\" ]"
+
+    # Test 4: Undoing a delete brings the record back and keeps later access counts
+    ../bookmarks.sh add 'Undo Three' cmd 'echo three' > /dev/null
+    ../bookmarks.sh -y delete 'Undo Three' > /dev/null
+    ../bookmarks.sh 'Undo One' > /dev/null 2>&1
+    run_test "Undo restores a deleted bookmark" \
+        "../bookmarks.sh undo > /dev/null && [ \"\$(field_of 'Undo Three' command)\" = 'echo three' ]"
+    run_test "Access is not counted as an operation to undo" \
+        "[ \"\$(field_of 'Undo One' access_count)\" = '1' ]"
+
+    # Test 5: restore --at rebuilds an earlier generation
+    run_test "Restore --at rewinds to a generation" \
+        "../bookmarks.sh -y restore --at 2 > /dev/null && \
+         [ \"\$(field_of 'Undo Two' command)\" = 'echo two' ] && [ \"\$(field_of 'Undo One' command)\" = 'echo one' ] && \
+         [ -z \"\$(field_of 'Undo Three' id)\" ]"
+    run_test "Restore --at commits a new generation" \
+        "tail -n 1 '$journal' | jq -e '.op == \"restore\" and .snapshots.before != null' > /dev/null"
+
+    # Test 6: A restore can itself be undone
+    run_test "Undo reverts a restore" \
+        "../bookmarks.sh undo > /dev/null && [ \"\$(field_of 'Undo Three' command)\" = 'echo three' ] && [ -z \"\$(field_of 'Undo Two' id)\" ]"
+
+    # Test 7: Restore to a point in time
+    local before_time
+    before_time=$(jq -r 'select(.generation == 2) | .timestamp' "$journal")
+    run_test "Restore --at accepts a time" \
+        "../bookmarks.sh -y restore --at @$before_time | grep -q 'restored to generation' && \
+         [ \"\$(field_of 'Undo Two' command)\" = 'echo two' ]"
+
+    # Test 8: A trimmed journal falls back to a backup and replays forward
+    ../bookmarks.sh backup > /dev/null
+    local backup_gen
+    backup_gen=$(jq '.generation' "$TEST_BOOKMARKS_FILE")
+    ../bookmarks.sh update 'Undo Two' cmd 'echo two v2' > /dev/null
+    ../bookmarks.sh update 'Undo Two' cmd 'echo two v3' > /dev/null
+    tail -n 2 "$journal" > "$journal.tmp" && mv "$journal.tmp" "$journal"
+    run_test "Restore --at replays from a backup when the journal is trimmed" \
+        "../bookmarks.sh -y restore --at $((backup_gen + 1)) > /dev/null && [ \"\$(field_of 'Undo Two' command)\" = 'echo two v2' ]"
+
+    # Test 9: Restoring beyond the recorded history fails cleanly
+    run_test "Restore --at before the history is refused" \
+        "../bookmarks.sh -y restore --at 1 > /dev/null 2>&1" 1
+
+    # Test 10: Aging access counts during a rescore can be rewound
+    ../bookmarks.sh add 'Aged Often' cmd 'true' > /dev/null
+    local i
+    for i in 1 2 3 4 5 6; do
+        ../bookmarks.sh 'Aged Often' > /dev/null 2>&1
+    done
+    local pre_aging_gen
+    pre_aging_gen=$(jq '.generation' "$TEST_BOOKMARKS_FILE")
+    FRECENCY_MAX_RANK=4 ../bookmarks.sh maintain > /dev/null 2>&1
+    run_test "Aging rescore is journaled with snapshots" \
+        "[ \"\$(field_of 'Aged Often' access_count)\" != '6' ] && \
+         jq -e -s 'any(.[]; .op == \"age\" and .snapshots.before != null)' '$journal' > /dev/null"
+    run_test "Restore --at rewinds aged access counts" \
+        "../bookmarks.sh -y restore --at $pre_aging_gen > /dev/null && [ \"\$(field_of 'Aged Often' access_count)\" = '6' ]"
+
+    # Summary
+    echo ""
+    echo -e "${BLUE}Test summary:${NC}"
+    echo -e "  ${GREEN}Tests passed: $TESTS_PASSED${NC}"
+    echo -e "  ${RED}Tests failed: $TESTS_FAILED${NC}"
+    echo -e "  Total tests: $TOTAL_TESTS"
+
+    if [ "$TESTS_FAILED" -eq 0 ]; then
+        echo -e "${GREEN}All undo tests passed! 🎉${NC}"
+        return 0
+    else
+        echo -e "${RED}Some tests failed.${NC}"
+        return 1
+    fi
+}
+
+# Main execution
+setup_test_env
+run_test_suite
+TEST_RESULT=$?
+cleanup_test_env
+
+exit $TEST_RESULT
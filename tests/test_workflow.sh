@@ -0,0 +1,112 @@
+#!/bin/bash
+
+# Test suite for workflow bookmarks
+# Covers step validation, dependency order, parallel stages, on_failure and recorded runs
+
+# Source the shared test framework
+SCRIPT_DIR="$(cd "$(dirname "${BASH_SOURCE[0]}")" && pwd)"
+source "$SCRIPT_DIR/test_framework.sh"
+
+# ID of a bookmark by description
+# Args: $1 - description
+bookmark_id() {
+    jq -r --arg d "$1" '.bookmarks[] | select(.description == $d) | .id' "$TEST_BOOKMARKS_FILE"
+}
+
+# Run the test suite
+run_test_suite() {
+    echo -e "${BLUE}Starting workflow test suite${NC}"
+
+    mkdir -p "$TEST_DIR/running"
+    # Each step logs when it starts and ends, and how many steps were running when it started
+    local name
+    for name in Status LogsA LogsB Board; do
+        ../bookmarks.sh add "Step $name" cmd "echo start $name >> '$TEST_DIR/order'; touch '$TEST_DIR/running/$name'; \
+ls '$TEST_DIR/running' | wc -l >> '$TEST_DIR/concurrency'; sleep 0.3; rm -f '$TEST_DIR/running/$name'; echo end $name >> '$TEST_DIR/order'; echo $name done" > /dev/null
+    done
+    ../bookmarks.sh add 'Step Broken' cmd "echo broken; exit 5" > /dev/null
+    local status logs_a logs_b board broken
+    status=$(bookmark_id 'Step Status')
+    logs_a=$(bookmark_id 'Step LogsA')
+    logs_b=$(bookmark_id 'Step LogsB')
+    board=$(bookmark_id 'Step Board')
+    broken=$(bookmark_id 'Step Broken')
+
+    # Test 1: Invalid workflows are rejected when added
+    run_test "Unknown step IDs are rejected" \
+        "../bookmarks.sh add 'Bad Flow' workflow '$status; 1_missing after $status'" 1
+    run_test "Dependencies must be steps" \
+        "../bookmarks.sh add 'Bad Flow' workflow '$logs_a after $status'" 1
+    run_test "Circular dependencies are rejected" \
+        "../bookmarks.sh add 'Bad Flow' workflow '$logs_a after $logs_b; $logs_b after $logs_a'" 1
+
+    # Test 2: Independent steps run concurrently, dependent steps wait
+    ../bookmarks.sh add 'Incident Flow' workflow \
+        "$status; $logs_a after $status; $logs_b after $status; $board after $logs_a,$logs_b" > /dev/null
+    run_test "Workflows cannot be steps of other workflows" \
+        "../bookmarks.sh add 'Outer Flow' workflow '$(bookmark_id 'Incident Flow')'" 1
+    local generation_before
+    generation_before=$(jq '.generation' "$TEST_BOOKMARKS_FILE")
+    ../bookmarks.sh 'Incident Flow' > "$TEST_DIR/out.txt" 2>&1
+    run_test "Steps start after the steps they wait for" \
+        "[ \"\$(head -n 2 '$TEST_DIR/order' | tr '\\n' ' ')\" = 'start Status end Status ' ] && \
+         [ \"\$(tail -n 2 '$TEST_DIR/order' | tr '\\n' ' ')\" = 'start Board end Board ' ]"
+    run_test "Independent steps run in parallel" \
+        "[ \$(sort -n '$TEST_DIR/concurrency' | tail -n 1) -eq 2 ]"
+    run_test "Summary shows the time of each step" \
+        "grep -q 'ok .* ms  Step LogsA' '$TEST_DIR/out.txt'"
+
+    # Test 3: The step runs share one commit, the workflow's access and run another
+    run_test "Step runs are recorded in a single commit" \
+        "[ \$(jq '.generation' \"$TEST_BOOKMARKS_FILE\") -eq $((generation_before + 2)) ] && \
+         jq -e '[.bookmarks[] | select(.description | startswith(\"Step \") and (. != \"Step Broken\"))]
+                | length == 4 and all(.access_count == 1 and .runs.count == 1)' \"$TEST_BOOKMARKS_FILE\" > /dev/null && \
+         jq -e '.bookmarks[] | select(.description == \"Incident Flow\") | .runs.count == 1 and .runs.last_ms >= 900' \"$TEST_BOOKMARKS_FILE\" > /dev/null"
+
+    # Test 4: By default a failure stops the workflow
+    ../bookmarks.sh add 'Failing Flow' workflow "$broken; $logs_a; $board after $broken; $logs_b after $logs_a" > /dev/null
+    : > "$TEST_DIR/order"
+    run_test "A failed step fails the workflow" \
+        "RUN_JOBS=1 ../bookmarks.sh 'Failing Flow' > '$TEST_DIR/out.txt' 2>&1" 1
+    run_test "No steps start after a failure" \
+        "grep -q 'exit 5 .*Step Broken' '$TEST_DIR/out.txt' && grep -q 'not started.*Step LogsA' '$TEST_DIR/out.txt' && \
+         [ ! -s '$TEST_DIR/order' ]"
+
+    # Test 5: on_failure continue runs what does not depend on the failure
+    run_test "set rejects unknown on_failure values" \
+        "../bookmarks.sh set 'Failing Flow' on_failure retry" 1
+    ../bookmarks.sh set 'Failing Flow' on_failure continue > /dev/null
+    RUN_JOBS=1 ../bookmarks.sh 'Failing Flow' > "$TEST_DIR/out.txt" 2>&1
+    run_test "Independent steps still run with on_failure continue" \
+        "grep -q 'ok .*Step LogsB' '$TEST_DIR/out.txt' && grep -q 'skipped .*Step Board' '$TEST_DIR/out.txt'"
+
+    # Test 6: Steps are found by ID, whatever their description
+    ../bookmarks.sh update 'Step Status' cmd "echo renamed > '$TEST_DIR/renamed'" > /dev/null
+    jq --arg id "$status" '.bookmarks |= map(if .id == $id then .description = "Cluster Status" else . end)' \
+        "$TEST_BOOKMARKS_FILE" > "$TEST_DIR/b.json" && mv "$TEST_DIR/b.json" "$TEST_BOOKMARKS_FILE"
+    run_test "Renamed steps are still run" \
+        "../bookmarks.sh 'Incident Flow' > /dev/null 2>&1 && [ -f '$TEST_DIR/renamed' ]"
+
+    # Summary
+    echo ""
+    echo -e "${BLUE}Test summary:${NC}"
+    echo -e "  ${GREEN}Tests passed: $TESTS_PASSED${NC}"
+    echo -e "  ${RED}Tests failed: $TESTS_FAILED${NC}"
+    echo -e "  Total tests: $TOTAL_TESTS"
+
+    if [ "$TESTS_FAILED" -eq 0 ]; then
+        echo -e "${GREEN}All workflow tests passed! 🎉${NC}"
+        return 0
+    else
+        echo -e "${RED}Some tests failed.${NC}"
+        return 1
+    fi
+}
+
+# Main execution
+setup_test_env
+run_test_suite
+TEST_RESULT=$?
+cleanup_test_env
+
+exit $TEST_RESULT